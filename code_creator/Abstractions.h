@@ -1,12 +1,70 @@
 #ifndef ABSTRACTIONS_H
 #define ABSTRACTIONS_H
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <memory>
 #include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include "Sink.h"
+#include "MappedFile.h"
+#include "SymbolTable.h"
+#include "ThreadPool.h"
+#include "ConcurrentList.h"
+#include "Instrumentation.h"
 
 using namespace std;
 
+class UnitArena;
+class MethodUnit;
+class PrintOperatorUnit;
+
+//Таблица отступов: один статический буфер из табуляций, собранный на этапе компиляции
+//Отступ уровня level - это начало буфера длиной level, поэтому строка отступа никогда не создаётся
+struct ShiftTable
+{
+    static constexpr unsigned int SIZE = 64;
+    char tabs[ SIZE ];
+    constexpr ShiftTable(): tabs()
+    {
+        for( unsigned int i = 0; i < SIZE; ++i )
+        {
+            tabs[ i ] = '\t';
+        }
+    }
+};
+inline constexpr ShiftTable SHIFT_TABLE{};
+
+//shiftSlice(...) - отступ уровня level (не больше ShiftTable::SIZE) в виде ссылки на таблицу
+inline std::string_view shiftSlice( unsigned int level )
+{
+    return std::string_view( SHIFT_TABLE.tabs, std::min( level, ShiftTable::SIZE ) );
+}
+
+//writeShift(...) - дописывает отступ нужной длины прямо в приёмник, не создавая строку
+//Вынесена из Unit, чтобы ею пользовались и правила синтаксиса языков, которые не являются узлами дерева
+//Out - любой приёмник с функцией write(data, size): Sink или, например, StringWriter
+template< class Out >
+inline void writeShift( Out& sink, unsigned int level )
+{
+    //Для очень глубоких уровней у потока есть свой буфер табуляций, который только растёт,
+    //поэтому отступ любой длины всё равно пишется одним вызовом
+    if( level > ShiftTable::SIZE )
+    {
+        thread_local std::string deepShift;
+        if( deepShift.size() < level )
+        {
+            deepShift.assign( level, '\t' );
+        }
+        sink.write( deepShift.data(), level );
+        return;
+    }
+    std::string_view shift = shiftSlice( level );
+    sink.write( shift.data(), shift.size() );
+}
+
 //В этом классе содержатся те функции, который нужны при наследовании
 class Unit
 {
@@ -14,34 +72,387 @@ public:
     //keyword using необходимо для того, чтобы зарезервировать слово для использования типа данных unsigned int
     //в свою очередь, это необходимо для сокращения количества слов для удобства и быстроты написания кода
     using Flags = unsigned int;
+    Unit(): m_cache( nullptr ), m_parent( nullptr ), m_arena( nullptr ), m_detached( false ), m_sealed( false ) {}
     //Деструктор, который нужен наследникам, чтобы они могли определить собственный декструктор
     //Только так обеспечивается корректное разрушение объекта производного класса через указатель на соответствующий базовый класс
-    virtual ~Unit() = default;
+    virtual ~Unit()
+    {
+        delete m_cache.load();
+    }
     //add(...) - виртуальная функция, предназначена для добавления вложенных элементов
-    //Передача происходит через умный указатель shared_ptr
-    virtual void add( const std::shared_ptr< Unit >& , Flags )
+    //Передача происходит через умный указатель shared_ptr; он принимается по значению и перемещается в родителя,
+    //поэтому временный указатель (или std::move(...)) добавляется без изменения счётчика ссылок
+    virtual void add( std::shared_ptr< Unit > , Flags )
     {
         throw std::runtime_error( "Not supported" );
     }
-    //compile(...) - чисто виртуальная функция
-    //Эта функция генерирует код на том или ином языке
-    //Возвращает результат в виде строки std::string
+    //compileTo(...) - чисто виртуальная функция
+    //Эта функция генерирует код на том или ином языке и дописывает его в приёмник sink
+    //Вложенные узлы пишут в тот же самый приёмник, поэтому промежуточные строки не создаются
     //level - параметр, который указывает уровень вложенности узла дерева
     //Этот параметр необходим для корректной расстановки отступов в начале строк генерируемого кода
-    virtual std::string compile( unsigned int level = 0 ) const = 0;
-protected:
-    //generateShift(...) - возвращает строку, состоящую из нужного числа пробелов
-    //принимает параметр level, от которого зависит число пробелов (уровень вложенности)
-    virtual std::string generateShift( unsigned int level ) const
+    virtual void compileTo( Sink& sink, unsigned int level = 0 ) const = 0;
+    //measure(...) - точный размер в байтах кода, который compileTo(...) запишет для уровня level
+    //Считается отдельным обходом по тем же правилам синтаксиса, но без копирования текста
+    //Наследники переопределяют её; реализация по умолчанию просто генерирует код в приёмник без хранения
+    virtual size_t measure( unsigned int level = 0 ) const
+    {
+        NullSink sink;
+        compileTo( sink, level );
+        return sink.written();
+    }
+    //compile(...) - обёртка над compileTo(...) для тех, кому удобнее получить результат в виде строки std::string
+    //Размер результата известен заранее (measure(...)), поэтому строка выделяется один раз
+    //Узел с запоминанием текста считает размер сам, когда генерирует текст (compileCached(...)),
+    //а в результат готовый текст копируется одним куском - второй обход ради reserve(...) не нужен
+    std::string compile( unsigned int level = 0 ) const
     {
-        static const auto DEFAULT_SHIFT = '\t';
         std::string result;
-        for( unsigned int i = 0; i < level; ++i )
+        if( !cachesOutput() )
         {
-            result += DEFAULT_SHIFT;
+            result.reserve( measure( level ) );
         }
+        StringSink sink( result );
+        compileTo( sink, level );
         return result;
     }
+    //compileToFile(...) - записывает код прямо в файл path, отображённый в память
+    //Файл сразу создаётся нужного размера, промежуточных буферов нет
+    void compileToFile( const std::string& path, unsigned int level = 0 ) const
+    {
+        const size_t size = measure( level );
+        MappedFile file( path, MappedFile::WRITE, size );
+        MemorySink sink( file.data(), size );
+        //Посчитанный размер отдаётся compileCached(...), чтобы он не обходил дерево ещё раз
+        MeasuredSize& measured = measuredSize();
+        measured = MeasuredSize{ this, level, size };
+        try
+        {
+            compileTo( sink, level );
+        }
+        catch( ... )
+        {
+            measured = MeasuredSize();
+            throw;
+        }
+        measured = MeasuredSize();
+        if( sink.used() != size )
+        {
+            throw std::runtime_error( "Measured size does not match generated code" );
+        }
+    }
+    //setOutputCaching(...) - включает запоминание сгенерированного текста классов, методов и операторов вывода
+    //Узел хранит свой текст для каждого уровня вложенности, на котором его компилировали
+    //(язык у узла Unit один - он определяется его типом). Пока узел не изменён, повторная
+    //компиляция просто копирует готовый текст, а не генерирует его заново
+    static void setOutputCaching( bool enabled )
+    {
+        outputCaching().store( enabled );
+    }
+    //invalidate() - сбрасывает запомненный текст узла и всех узлов, в которые он вложен
+    //Вызывается автоматически из add(...); вызывать вручную нужно только после других изменений узла
+    //Текст родителя запоминается только вместе с текстом его детей, а сброс всегда идёт вверх до конца,
+    //поэтому у узла без запомненного текста его нет и у всех предков: на таком узле обход останавливается,
+    //и add(...) при выключенном запоминании не поднимается по дереву. Обход идёт по явному стеку,
+    //чтобы очень глубокие деревья не переполняли стек вызовов
+    void invalidate()
+    {
+        std::vector< Unit* > pending;
+        Unit* node = this;
+        while( true )
+        {
+            if( node->clearCache() )
+            {
+                if( node->m_parent != nullptr )
+                {
+                    pending.push_back( node->m_parent );
+                }
+                pending.insert( pending.end(), node->m_extraParents.begin(), node->m_extraParents.end() );
+            }
+            if( pending.empty() )
+            {
+                return;
+            }
+            node = pending.back();
+            pending.pop_back();
+        }
+    }
+    //dirty() - true, если у узла нет запомненного текста и его придётся генерировать заново
+    bool dirty() const
+    {
+        RenderCache* cache = m_cache.load();
+        if( cache == nullptr )
+        {
+            return true;
+        }
+        std::lock_guard< std::mutex > lock( cache->mutex );
+        return cache->entries.empty();
+    }
+    //seal() - делает узел неизменяемым: add(...) больше не принимает новые узлы
+    //Неизменяемый узел можно безопасно вкладывать в несколько родителей (см. Interning.h),
+    //а его текст запоминается для каждого уровня независимо от setOutputCaching(...)
+    //Узлы внутри него тоже не должны меняться: родители неизменяемого узла о таких изменениях не узнают
+    void seal()
+    {
+        m_sealed = true;
+    }
+    bool sealed() const
+    {
+        return m_sealed;
+    }
+    //detachLinks() - забывает о родителях узла, а дети забывают о нём
+    //Нужна арене, которая разрушает узлы в произвольном порядке: после вызова у всех узлов
+    //деструкторы не обращаются к соседям, которые, возможно, уже разрушены,
+    //а ребёнок из кучи, переживший узел арены, не ссылается на разрушенного родителя
+    void detachLinks()
+    {
+        releaseChildren();
+        m_parent = nullptr;
+        m_extraParents.clear();
+        m_detached = true;
+    }
+    //arena() - арена, в которой размещён узел (nullptr, если узел владеет собой сам)
+    //Узлы, создаваемые функциями emplace...(...), размещаются там же, где их родитель
+    UnitArena* arena() const
+    {
+        return m_arena;
+    }
+protected:
+    friend class UnitArena;
+    friend class IterativeCompiler;
+    //Нерекурсивная генерация (IterativeCompiler.h) разбивает compileTo(...) узла на шаги:
+    //stepOpen(...) пишет начало узла и возвращает число детей (STEP_DONE - узел уже записан целиком),
+    //stepChild(...) пишет то, что стоит перед ребёнком index, и возвращает этого ребёнка,
+    //stepClose(...) пишет конец узла. Дети пишутся на уровне level + 1
+    //Узел, который не разбит на шаги, записывается целиком обычным compileTo(...)
+    static const size_t STEP_DONE = SIZE_MAX;
+    virtual size_t stepOpen( Sink& sink, unsigned int level ) const
+    {
+        compileTo( sink, level );
+        return STEP_DONE;
+    }
+    virtual const Unit* stepChild( Sink& /* sink */, unsigned int /* level */, size_t /* index */ ) const
+    {
+        return nullptr;
+    }
+    virtual void stepClose( Sink& /* sink */, unsigned int /* level */ ) const {}
+    //writeCached(...) - если для уровня level запомнен готовый текст, пишет его в приёмник и возвращает true
+    bool writeCached( Sink& sink, unsigned int level ) const
+    {
+        std::shared_ptr< const std::string > text = findCached( level );
+        if( text == nullptr )
+        {
+            return false;
+        }
+        sink << *text;
+        return true;
+    }
+    //checkMutable() - бросает исключение, если узел неизменяемый (см. seal())
+    void checkMutable() const
+    {
+        if( m_sealed )
+        {
+            throw std::runtime_error( "Sealed unit can not be changed" );
+        }
+    }
+    //adopt(...) - запоминает, что этот узел - родитель child, и сбрасывает свой запомненный текст
+    void adopt( Unit& child )
+    {
+        //Неизменяемый узел никогда не сбрасывает текст родителей, поэтому ссылки на них ему не нужны
+        //(у общего узла из Interning.h родителей могут быть миллионы)
+        if( child.m_sealed )
+        {
+            invalidate();
+            return;
+        }
+        if( child.m_parent == nullptr )
+        {
+            child.m_parent = this;
+        }
+        else
+        {
+            child.m_extraParents.push_back( this );
+        }
+        invalidate();
+    }
+    //releaseChildren() - release(...) для всех детей узла; переопределяют наследники, у которых есть дети
+    virtual void releaseChildren() {}
+    //release(...) - обратное действие к adopt(...), вызывается из деструктора родителя
+    void release( Unit& child )
+    {
+        if( m_detached )
+        {
+            return;
+        }
+        if( child.m_parent == this )
+        {
+            child.m_parent = nullptr;
+            return;
+        }
+        auto it = std::find( child.m_extraParents.begin(), child.m_extraParents.end(), this );
+        if( it != child.m_extraParents.end() )
+        {
+            child.m_extraParents.erase( it );
+        }
+    }
+    //compileCached(...) - если запоминание включено, берёт готовый текст для уровня level,
+    //а при его отсутствии генерирует текст функцией render и запоминает его
+    template< class Render >
+    void compileCached( Sink& sink, unsigned int level, Render render ) const
+    {
+        if( !cachesOutput() )
+        {
+            render( sink );
+            return;
+        }
+        RenderCache& cache = renderCache();
+        std::shared_ptr< const std::string > text;
+        {
+            std::lock_guard< std::mutex > lock( cache.mutex );
+            for( const auto& entry : cache.entries )
+            {
+                if( entry.first == level )
+                {
+                    text = entry.second;
+                    break;
+                }
+            }
+        }
+        if( text == nullptr )
+        {
+            std::shared_ptr< std::string > rendered = std::make_shared< std::string >();
+            //Размер считается только для внешнего из вложенных генерируемых узлов: он уже учитывает всё поддерево,
+            //а measure(...) на каждом уровне вложенности обходила бы поддерево заново (время - узлы * глубина)
+            unsigned int& depth = renderDepth();
+            if( depth == 0 )
+            {
+                const MeasuredSize& measured = measuredSize();
+                rendered->reserve( measured.unit == this && measured.level == level ? measured.size : measure( level ) );
+            }
+            StringSink renderedSink( *rendered );
+            ++depth;
+            try
+            {
+                render( renderedSink );
+            }
+            catch( ... )
+            {
+                --depth;
+                throw;
+            }
+            --depth;
+            text = rendered;
+            std::lock_guard< std::mutex > lock( cache.mutex );
+            cache.entries.emplace_back( level, text );
+        }
+        sink << *text;
+    }
+    //measureCached(...) - если для уровня level запомнен готовый текст, возвращает его длину,
+    //иначе считает размер функцией count
+    template< class Count >
+    size_t measureCached( unsigned int level, Count count ) const
+    {
+        std::shared_ptr< const std::string > text = findCached( level );
+        return text != nullptr ? text->size() : count();
+    }
+private:
+    //Запомненный текст узла: пары (уровень вложенности, текст)
+    struct RenderCache
+    {
+        std::mutex mutex;
+        std::vector< std::pair< unsigned int, std::shared_ptr< const std::string > > > entries;
+    };
+    //findCached(...) - запомненный текст для уровня level, если запоминание действует и текст есть
+    std::shared_ptr< const std::string > findCached( unsigned int level ) const
+    {
+        RenderCache* cache = cachesOutput() ? m_cache.load() : nullptr;
+        if( cache != nullptr )
+        {
+            std::lock_guard< std::mutex > lock( cache->mutex );
+            for( const auto& entry : cache->entries )
+            {
+                if( entry.first == level )
+                {
+                    return entry.second;
+                }
+            }
+        }
+        return nullptr;
+    }
+    //clearCache() - забывает запомненный текст; false, если его и не было
+    bool clearCache()
+    {
+        RenderCache* cache = m_cache.load();
+        if( cache == nullptr )
+        {
+            return false;
+        }
+        std::lock_guard< std::mutex > lock( cache->mutex );
+        if( cache->entries.empty() )
+        {
+            return false;
+        }
+        cache->entries.clear();
+        return true;
+    }
+    //renderCache() - создаёт хранилище текста при первом обращении (в том числе из нескольких потоков)
+    RenderCache& renderCache() const
+    {
+        RenderCache* cache = m_cache.load();
+        if( cache == nullptr )
+        {
+            RenderCache* created = new RenderCache;
+            if( m_cache.compare_exchange_strong( cache, created ) )
+            {
+                cache = created;
+            }
+            else
+            {
+                delete created;
+            }
+        }
+        return *cache;
+    }
+    static std::atomic< bool >& outputCaching()
+    {
+        static std::atomic< bool > enabled( false );
+        return enabled;
+    }
+    //cachesOutput() - запоминается ли текст этого узла
+    bool cachesOutput() const
+    {
+        return m_sealed || outputCaching().load();
+    }
+    //Размер текста узла unit на уровне level, уже посчитанный вызывающим (см. compileToFile(...))
+    struct MeasuredSize
+    {
+        const Unit* unit = nullptr;
+        unsigned int level = 0;
+        size_t size = 0;
+    };
+    static MeasuredSize& measuredSize()
+    {
+        static thread_local MeasuredSize measured;
+        return measured;
+    }
+    //renderDepth() - сколько узлов этого потока сейчас генерируют текст для запоминания (см. compileCached(...))
+    static unsigned int& renderDepth()
+    {
+        static thread_local unsigned int depth = 0;
+        return depth;
+    }
+    //хранилище текста; создаётся только у узлов, которые компилировались с включённым запоминанием
+    mutable std::atomic< RenderCache* > m_cache;
+    //узлы, в которые вложен этот узел: обычно родитель один и хранится прямо в узле,
+    //а остальные (если узел добавлен в несколько мест) - в отдельном списке
+    Unit* m_parent;
+    std::vector< Unit* > m_extraParents;
+    //арена, в которой размещён узел
+    UnitArena* m_arena;
+    //узел отвязан от соседей (см. detachLinks())
+    bool m_detached;
+    //узел неизменяемый (см. seal())
+    bool m_sealed;
 };
 
 //Абстрактный класс, производящий генерацию класса, наследник класса Unit
@@ -63,25 +474,316 @@ public:
     //Ключевое слово explicit - неявный конструктор
     //то есть мы не можем создать объект класса как MyClass a = 10
     //MyClass a(10); - только так
-    explicit ClassUnit( const std::string& name ): m_name(name)
+    explicit ClassUnit( std::string_view name ): m_name(name)
     {
         m_fields.resize( ACCESS_MODIFIERS.size() );
     }
+    //Имя класса
+    Symbol name() const
+    {
+        return m_name;
+    }
     //Чисто виртуальная функция добавления
     //Поскольку данный класс наследуется от Unit, содержащего виртуальную функцию add(...), она не может не быть реализована в классе - наследнике
-    virtual void add(const std::shared_ptr< Unit >& unit, Flags flags) override = 0;
+    virtual void add(std::shared_ptr< Unit > unit, Flags flags) override = 0;
     //Чисто виртуальная функция генерации кода
     //Здесь ситуация, аналогичная чисто виртуальной функции add(...)
-    virtual std::string compile( unsigned int level = 0 ) const override = 0;
+    virtual void compileTo( Sink& sink, unsigned int level = 0 ) const override = 0;
     //виртуальный деструктор
-    virtual ~ClassUnit() = default;
+    virtual ~ClassUnit()
+    {
+        ClassUnit::releaseChildren();
+    }
+    //Порог по умолчанию: группы, где методов меньше, всегда компилируются последовательно
+    static const size_t DEFAULT_PARALLEL_THRESHOLD = 256;
+    //setParallelCompilation(...) - разрешает компилировать большие группы методов на пуле потоков
+    //Группа из threshold и более методов делится на части, каждая часть пишется в собственный буфер,
+    //а затем буферы склеиваются в исходном порядке, поэтому результат совпадает с последовательным побайтно
+    //pool == nullptr отключает параллельную компиляцию
+    static void setParallelCompilation( ThreadPool* pool, size_t threshold = DEFAULT_PARALLEL_THRESHOLD )
+    {
+        parallelThreshold().store( threshold );
+        parallelPool().store( pool );
+    }
+    //emplaceMethod(...) - создаёт метод того же языка прямо в группе access и возвращает ссылку на него
+    //Метод размещается там же, где класс (в его арене или в куче); промежуточных копий указателя нет,
+    //поэтому дерево можно строить цепочкой: cls.emplaceMethod( access, name, type, flags ).emplacePrint( text )
+    MethodUnit& emplaceMethod( Flags access, std::string_view name, std::string_view returnType, Flags flags = 0 );
+    //emplaceClass(...) - то же самое для вложенного класса
+    ClassUnit& emplaceClass( Flags access, std::string_view name, Flags classAccess = PUBLIC, Flags classModifier = 0 )
+    {
+        std::shared_ptr< ClassUnit > nested = newClass( name, classAccess, classModifier );
+        ClassUnit& result = *nested;
+        add( std::move( nested ), access );
+        return result;
+    }
+    //beginConcurrent() - включает режим параллельного построения
+    //До вызова freeze() add(...) можно вызывать из нескольких потоков одновременно: узлы складываются
+    //в списки без блокировок (ConcurrentList.h) по группам доступа и попадают в класс только в freeze()
+    //Вызывается до того, как потоки начнут добавлять узлы
+    void beginConcurrent()
+    {
+        checkMutable();
+        if( m_pending == nullptr )
+        {
+            m_pending.reset( new PendingList[ m_fields.size() ] );
+        }
+    }
+    //freeze() - переносит накопленные узлы в группы доступа; после неё класс - обычное дерево, которое можно компилировать
+    //Вызывается после того, как все добавлявшие потоки закончили работу
+    //Узлы одной группы идут в том порядке, в котором потоки их добавили
+    void freeze()
+    {
+        if( m_pending == nullptr )
+        {
+            return;
+        }
+        std::unique_ptr< PendingList[] > pending = std::move( m_pending );
+        for( size_t i = 0; i < m_fields.size(); ++i )
+        {
+            m_fields[ i ].reserve( m_fields[ i ].size() + pending[ i ].size() );
+            for( size_t j = 0; j < pending[ i ].size(); ++j )
+            {
+                m_fields[ i ].push_back( pending[ i ][ j ] );
+                adopt( *pending[ i ][ j ] );
+            }
+        }
+    }
+    //concurrent() - класс в режиме параллельного построения (freeze() ещё не вызвана)
+    bool concurrent() const
+    {
+        return m_pending != nullptr;
+    }
 protected:
-    //строка с названием класса
-    std::string m_name;
+    //Класс перестаёт быть родителем своих полей
+    void releaseChildren() override
+    {
+        for( const auto& fields : m_fields )
+        {
+            for( const auto& f : fields )
+            {
+                release( *f );
+            }
+        }
+    }
+    //compileClass(...) - общий для всех языков обход класса
+    //Отличия языков (ключевые слова, метки типов доступа) задаются правилами синтаксиса Syntax
+    //Если включено запоминание текста (Unit::setOutputCaching), неизменённый класс не генерируется заново
+    template< class Syntax >
+    void compileClass( Sink& sink, unsigned int level, Flags classAccess, Flags classModifier ) const
+    {
+        INSTRUMENT_SCOPE( Syntax::LANGUAGE_INDEX, Instrumentation::CLASS_NODE, Instrumentation::COMPILE, &sink );
+        checkFrozen();
+        compileCached( sink, level, [ this, level, classAccess, classModifier ]( Sink& out )
+        {
+            renderClass< Syntax >( out, level, classAccess, classModifier );
+        } );
+    }
+    //measureClass(...) - размер кода класса; тот же обход, что в renderClass(...), но со счётчиком вместо приёмника
+    template< class Syntax >
+    size_t measureClass( unsigned int level, Flags classAccess, Flags classModifier ) const
+    {
+        checkFrozen();
+        return measureCached( level, [ this, level, classAccess, classModifier ]
+        {
+            SizeCounter counter;
+            Syntax::classOpen( counter, level, m_name, classAccess, classModifier );
+            for( size_t i = 0; i < m_fields.size(); ++i )
+            {
+                if( m_fields[ i ].empty() )
+                {
+                    continue;
+                }
+                Syntax::sectionOpen( counter, level, i );
+                counter.add( measureMembers< Syntax >( level, i, 0, m_fields[ i ].size() ) );
+                Syntax::sectionClose( counter, level );
+            }
+            Syntax::classClose( counter, level );
+            return counter.size();
+        } );
+    }
+    //measureMembers(...) - размер кода методов группы access с номерами [begin, end)
+    template< class Syntax >
+    size_t measureMembers( unsigned int level, size_t access, size_t begin, size_t end ) const
+    {
+        SizeCounter counter;
+        for( size_t j = begin; j < end; ++j )
+        {
+            Syntax::memberPrefix( counter, level + 1, access );
+            counter.add( m_fields[ access ][ j ]->measure( level + 1 ) );
+        }
+        return counter.size();
+    }
+    //newMethod(...), newClass(...) - создают узлы того же языка для emplace...(...); наследники переопределяют их
+    virtual std::shared_ptr< MethodUnit > newMethod( std::string_view /* name */, std::string_view /* returnType */, Flags /* flags */ ) const
+    {
+        throw std::runtime_error( "Not supported" );
+    }
+    virtual std::shared_ptr< ClassUnit > newClass( std::string_view /* name */, Flags /* classAccess */, Flags /* classModifier */ ) const
+    {
+        throw std::runtime_error( "Not supported" );
+    }
+    //addField(...) - добавляет вложенный узел в группу access; вызывается из add(...) наследников
+    template< class Syntax >
+    void addField( std::shared_ptr< Unit > unit, Flags access )
+    {
+        INSTRUMENT_SCOPE( Syntax::LANGUAGE_INDEX, Instrumentation::CLASS_NODE, Instrumentation::ADD, nullptr );
+        checkMutable();
+        if( m_pending != nullptr )
+        {
+            m_pending[ access ].push( std::move( unit ) );
+            return;
+        }
+        m_fields[ access ].push_back( std::move( unit ) );
+        adopt( *m_fields[ access ].back() );
+    }
+    //renderClass(...) - генерация класса без запоминания
+    template< class Syntax >
+    void renderClass( Sink& sink, unsigned int level, Flags classAccess, Flags classModifier ) const
+    {
+        Syntax::classOpen( sink, level, m_name, classAccess, classModifier );
+        //Здесь происходит сборка методов с одинаковыми типами доступа
+        for( size_t i = 0; i < m_fields.size(); ++i )
+        {
+            //группа методов может быть пустой, тогда её пропускаем
+            if( m_fields[ i ].empty() )
+            {
+                continue;
+            }
+            Syntax::sectionOpen( sink, level, i );
+            ThreadPool* pool = parallelPool().load();
+            if( pool != nullptr && m_fields[ i ].size() >= parallelThreshold().load() )
+            {
+                compileMembersParallel< Syntax >( sink, level, i, *pool );
+            }
+            else
+            {
+                compileMembers< Syntax >( sink, level, i, 0, m_fields[ i ].size() );
+            }
+            Syntax::sectionClose( sink, level );
+        }
+        Syntax::classClose( sink, level );
+    }
+    //stepOpenClass(...), stepChildClass(...), stepCloseClass(...) - renderClass(...), разбитая на шаги (см. Unit::stepOpen)
+    //Дети всех групп доступа нумеруются подряд; метка группы пишется перед её первым ребёнком
+    template< class Syntax >
+    size_t stepOpenClass( Sink& sink, unsigned int level, Flags classAccess, Flags classModifier ) const
+    {
+        checkFrozen();
+        if( writeCached( sink, level ) )
+        {
+            return STEP_DONE;
+        }
+        Syntax::classOpen( sink, level, m_name, classAccess, classModifier );
+        return memberCount();
+    }
+    template< class Syntax >
+    const Unit* stepChildClass( Sink& sink, unsigned int level, size_t index ) const
+    {
+        const bool first = index == 0;
+        size_t access = 0;
+        while( index >= m_fields[ access ].size() )
+        {
+            index -= m_fields[ access ].size();
+            ++access;
+        }
+        if( index == 0 )
+        {
+            if( !first )
+            {
+                Syntax::sectionClose( sink, level );
+            }
+            Syntax::sectionOpen( sink, level, access );
+        }
+        Syntax::memberPrefix( sink, level + 1, access );
+        return m_fields[ access ][ index ].get();
+    }
+    template< class Syntax >
+    void stepCloseClass( Sink& sink, unsigned int level ) const
+    {
+        if( memberCount() != 0 )
+        {
+            Syntax::sectionClose( sink, level );
+        }
+        Syntax::classClose( sink, level );
+    }
+    size_t memberCount() const
+    {
+        size_t count = 0;
+        for( const auto& fields : m_fields )
+        {
+            count += fields.size();
+        }
+        return count;
+    }
+    //compileMembers(...) - компилирует методы группы access с номерами [begin, end)
+    template< class Syntax >
+    void compileMembers( Sink& sink, unsigned int level, size_t access, size_t begin, size_t end ) const
+    {
+        for( size_t j = begin; j < end; ++j )
+        {
+            Syntax::memberPrefix( sink, level + 1, access );
+            m_fields[ access ][ j ]->compileTo( sink, level + 1 );
+        }
+    }
+    //compileMembersParallel(...) - то же самое, но части группы компилируются разными потоками
+    template< class Syntax >
+    void compileMembersParallel( Sink& sink, unsigned int level, size_t access, ThreadPool& pool ) const
+    {
+        const size_t count = m_fields[ access ].size();
+        //Несколько частей на поток, чтобы потоки могли перехватывать работу друг у друга
+        size_t chunks = pool.size() * 4;
+        size_t chunkSize = ( count + chunks - 1 ) / chunks;
+        chunks = ( count + chunkSize - 1 ) / chunkSize;
+        std::vector< std::string > buffers( chunks );
+        TaskGroup group( pool );
+        for( size_t c = 0; c < chunks; ++c )
+        {
+            size_t begin = c * chunkSize;
+            size_t end = begin + chunkSize < count ? begin + chunkSize : count;
+            std::string* buffer = &buffers[ c ];
+            group.run( [ this, buffer, level, access, begin, end ]
+            {
+                buffer->reserve( measureMembers< Syntax >( level, access, begin, end ) );
+                StringSink chunkSink( *buffer );
+                compileMembers< Syntax >( chunkSink, level, access, begin, end );
+            } );
+        }
+        group.wait();
+        //Склеиваем части в исходном порядке
+        for( const auto& b : buffers )
+        {
+            sink << b;
+        }
+    }
+    //Настройки параллельной компиляции, общие для всех классов
+    static std::atomic< ThreadPool* >& parallelPool()
+    {
+        static std::atomic< ThreadPool* > pool( nullptr );
+        return pool;
+    }
+    static std::atomic< size_t >& parallelThreshold()
+    {
+        static std::atomic< size_t > threshold( DEFAULT_PARALLEL_THRESHOLD );
+        return threshold;
+    }
+    //название класса (символ общей таблицы SymbolTable)
+    Symbol m_name;
     //Аналогично Flags, Fields используется для сокращения типа данных
     using Fields = std::vector< std::shared_ptr< Unit > >;
     //Вектор списка функций, которые распределены по типам доступа
     std::vector< Fields > m_fields;
+private:
+    using PendingList = ConcurrentAppendList< std::shared_ptr< Unit > >;
+    void checkFrozen() const
+    {
+        if( m_pending != nullptr )
+        {
+            throw std::runtime_error( "Class " + m_name.str() + " is being built concurrently, call freeze() first" );
+        }
+    }
+    //узлы, добавленные в режиме параллельного построения, по группам доступа
+    std::unique_ptr< PendingList[] > m_pending;
 };
 //Статическое поле определяется вне класса
 const std::vector<std::string> ClassUnit::ACCESS_MODIFIERS = {"public", "protected", "private", "internal", "protected internal", "private protected"};
@@ -99,22 +801,226 @@ public:
     //Перечисления опеределены в виде битовых флагов
     enum Modifier { STATIC = 1, CONST = 1 << 1, VIRTUAL = 1 << 2, ABSTRACT = 1 << 3, ASYNC = 1 << 4, UNSAVE = 1 << 5, FINAL = 1 << 6, SYNCHRONIZED = 1 << 7};
     //конструктор класса
-    explicit MethodUnit( const std::string& name, const std::string& returnType, Flags flags ):
+    explicit MethodUnit( std::string_view name, std::string_view returnType, Flags flags ):
         m_name( name ), m_returnType( returnType ), m_flags( flags ) {}
-    virtual void add( const std::shared_ptr< Unit >& unit, Flags /* flags */ = 0 ) override = 0;
-    virtual std::string compile( unsigned int level = 0 ) const override = 0;
+    virtual void add( std::shared_ptr< Unit > unit, Flags /* flags */ = 0 ) override = 0;
+    virtual void compileTo( Sink& sink, unsigned int level = 0 ) const override = 0;
     //виртуальный деструктор
-    virtual ~MethodUnit() = default;
+    virtual ~MethodUnit()
+    {
+        MethodUnit::releaseChildren();
+    }
+    //Доступ к содержимому метода только для чтения
+    Symbol name() const
+    {
+        return m_name;
+    }
+    Symbol returnType() const
+    {
+        return m_returnType;
+    }
+    Flags flags() const
+    {
+        return m_flags;
+    }
+    const std::vector< std::shared_ptr< Unit > >& body() const
+    {
+        return m_body;
+    }
+    //emplacePrint(...) - создаёт оператор вывода того же языка прямо в теле метода; возвращает сам метод,
+    //чтобы вызовы можно было продолжать цепочкой
+    //Текст принимается по значению: переданная через std::move(...) строка не копируется
+    MethodUnit& emplacePrint( std::string text );
+    //emplaceClass(...) - создаёт класс того же языка в теле метода и возвращает ссылку на него
+    ClassUnit& emplaceClass( std::string_view name, Flags classAccess = ClassUnit::PUBLIC, Flags classModifier = 0 )
+    {
+        std::shared_ptr< ClassUnit > nested = newClass( name, classAccess, classModifier );
+        ClassUnit& result = *nested;
+        add( std::move( nested ) );
+        return result;
+    }
+    //beginConcurrent(), freeze(), concurrent() - режим параллельного построения тела, как у ClassUnit
+    void beginConcurrent()
+    {
+        checkMutable();
+        if( m_pending == nullptr )
+        {
+            m_pending.reset( new PendingList );
+        }
+    }
+    void freeze()
+    {
+        if( m_pending == nullptr )
+        {
+            return;
+        }
+        std::unique_ptr< PendingList > pending = std::move( m_pending );
+        m_body.reserve( m_body.size() + pending->size() );
+        for( size_t i = 0; i < pending->size(); ++i )
+        {
+            m_body.push_back( ( *pending )[ i ] );
+            adopt( *( *pending )[ i ] );
+        }
+    }
+    bool concurrent() const
+    {
+        return m_pending != nullptr;
+    }
 
 protected:
-    //строка с названием метода
-    std::string m_name;
-    //тип, возвращаемый методом
-    std::string m_returnType;
+    //Метод перестаёт быть родителем узлов своего тела
+    void releaseChildren() override
+    {
+        for( const auto& b : m_body )
+        {
+            release( *b );
+        }
+    }
+    //compileMethod(...) - общий для всех языков обход метода: объявление, тело, закрывающая скобка
+    //Если включено запоминание текста (Unit::setOutputCaching), неизменённый метод не генерируется заново
+    template< class Syntax >
+    void compileMethod( Sink& sink, unsigned int level ) const
+    {
+        INSTRUMENT_SCOPE( Syntax::LANGUAGE_INDEX, Instrumentation::METHOD_NODE, Instrumentation::COMPILE, &sink );
+        checkFrozen();
+        compileCached( sink, level, [ this, level ]( Sink& out )
+        {
+            renderMethod< Syntax >( out, level );
+        } );
+    }
+    //measureMethod(...) - размер кода метода вместе с телом
+    template< class Syntax >
+    size_t measureMethod( unsigned int level ) const
+    {
+        checkFrozen();
+        return measureCached( level, [ this, level ]
+        {
+            SizeCounter counter;
+            Syntax::methodOpen( counter, level, m_name, m_returnType, m_flags );
+            for( const auto& b : m_body )
+            {
+                counter.add( b->measure( level + 1 ) );
+            }
+            Syntax::methodClose( counter, level );
+            return counter.size();
+        } );
+    }
+    //newPrint(...), newClass(...) - создают узлы того же языка для emplace...(...); наследники переопределяют их
+    virtual std::shared_ptr< PrintOperatorUnit > newPrint( std::string /* text */ ) const
+    {
+        throw std::runtime_error( "Not supported" );
+    }
+    virtual std::shared_ptr< ClassUnit > newClass( std::string_view /* name */, Flags /* classAccess */, Flags /* classModifier */ ) const
+    {
+        throw std::runtime_error( "Not supported" );
+    }
+    //addBody(...) - добавляет узел в тело метода; вызывается из add(...) наследников
+    template< class Syntax >
+    void addBody( std::shared_ptr< Unit > unit )
+    {
+        INSTRUMENT_SCOPE( Syntax::LANGUAGE_INDEX, Instrumentation::METHOD_NODE, Instrumentation::ADD, nullptr );
+        checkMutable();
+        if( m_pending != nullptr )
+        {
+            m_pending->push( std::move( unit ) );
+            return;
+        }
+        m_body.push_back( std::move( unit ) );
+        adopt( *m_body.back() );
+    }
+    //renderMethod(...) - генерация метода без запоминания
+    template< class Syntax >
+    void renderMethod( Sink& sink, unsigned int level ) const
+    {
+        Syntax::methodOpen( sink, level, m_name, m_returnType, m_flags );
+        //Собираем тело метода
+        for( const auto& b : m_body )
+        {
+            b->compileTo( sink, level + 1 );
+        }
+        Syntax::methodClose( sink, level );
+    }
+    //stepOpenMethod(...), stepChild(...), stepCloseMethod(...) - renderMethod(...), разбитая на шаги (см. Unit::stepOpen)
+    template< class Syntax >
+    size_t stepOpenMethod( Sink& sink, unsigned int level ) const
+    {
+        checkFrozen();
+        if( writeCached( sink, level ) )
+        {
+            return STEP_DONE;
+        }
+        Syntax::methodOpen( sink, level, m_name, m_returnType, m_flags );
+        return m_body.size();
+    }
+    const Unit* stepChild( Sink& /* sink */, unsigned int /* level */, size_t index ) const override
+    {
+        return m_body[ index ].get();
+    }
+    template< class Syntax >
+    void stepCloseMethod( Sink& sink, unsigned int level ) const
+    {
+        Syntax::methodClose( sink, level );
+    }
+    //название метода и возвращаемый тип - символы общей таблицы SymbolTable:
+    //одинаковые имена и типы у миллионов методов хранятся один раз
+    Symbol m_name;
+    Symbol m_returnType;
     //сами модификаторы
     Flags m_flags;
     //содержимое метода (тело метода)
     std::vector< std::shared_ptr< Unit > > m_body;
+private:
+    using PendingList = ConcurrentAppendList< std::shared_ptr< Unit > >;
+    void checkFrozen() const
+    {
+        if( m_pending != nullptr )
+        {
+            throw std::runtime_error( "Method " + m_name.str() + " is being built concurrently, call freeze() first" );
+        }
+    }
+    //узлы тела, добавленные в режиме параллельного построения
+    std::unique_ptr< PendingList > m_pending;
+};
+
+inline MethodUnit& ClassUnit::emplaceMethod( Flags access, std::string_view name, std::string_view returnType, Flags flags )
+{
+    std::shared_ptr< MethodUnit > method = newMethod( name, returnType, flags );
+    MethodUnit& result = *method;
+    add( std::move( method ), access );
+    return result;
+}
+
+//Таблица префиксов модификаторов метода для одного языка
+//Комбинаций флагов MethodUnit::Modifier всего 256, поэтому строка модификаторов для каждой из них
+//строится один раз (функцией build) и дальше берётся из таблицы без ветвлений и сложения строк
+class ModifierTable
+{
+public:
+    static const size_t SIZE = 256;
+    template< class Build >
+    explicit ModifierTable( Build build )
+    {
+        for( size_t flags = 0; flags < SIZE; ++flags )
+        {
+            std::string prefix = build( static_cast< Unit::Flags >( flags ) );
+            m_entries[ flags ] = Entry{ m_text.size(), prefix.size() };
+            m_text += prefix;
+        }
+    }
+    std::string_view operator[]( Unit::Flags flags ) const
+    {
+        const Entry& entry = m_entries[ flags & ( SIZE - 1 ) ];
+        return std::string_view( m_text.data() + entry.offset, entry.size );
+    }
+private:
+    struct Entry
+    {
+        size_t offset;
+        size_t size;
+    };
+    //все префиксы подряд в одной строке
+    std::string m_text;
+    Entry m_entries[ SIZE ];
 };
 
 //Класс, который имитирует операцию вывода
@@ -122,13 +1028,47 @@ class PrintOperatorUnit : public Unit
 {
 public:
     //конструктор класса
-    explicit PrintOperatorUnit( const std::string& text ): m_text( text ) { }
-    virtual std::string compile( unsigned int level = 0 ) const override = 0;
+    //Текст принимается по значению и перемещается в узел
+    explicit PrintOperatorUnit( std::string text ): m_text( std::move( text ) ) { }
+    virtual void compileTo( Sink& sink, unsigned int level = 0 ) const override = 0;
     //виртуальный деструктор
     virtual ~PrintOperatorUnit() = default;
+    const std::string& text() const
+    {
+        return m_text;
+    }
 protected:
+    //compilePrint(...) - оператор вывода по правилам языка Syntax
+    //Текст запоминается так же, как у классов и методов: общий неизменяемый оператор (Interning.h)
+    //экранируется один раз для каждого уровня, дальше готовый текст только копируется
+    template< class Syntax >
+    void compilePrint( Sink& sink, unsigned int level ) const
+    {
+        INSTRUMENT_SCOPE( Syntax::LANGUAGE_INDEX, Instrumentation::PRINT_NODE, Instrumentation::COMPILE, &sink );
+        compileCached( sink, level, [ this, level ]( Sink& out )
+        {
+            Syntax::print( out, level, m_text );
+        } );
+    }
+    //measurePrint(...) - размер оператора вывода
+    template< class Syntax >
+    size_t measurePrint( unsigned int level ) const
+    {
+        return measureCached( level, [ this, level ]
+        {
+            SizeCounter counter;
+            Syntax::print( counter, level, m_text );
+            return counter.size();
+        } );
+    }
     //Текст, который будет выводиться
     std::string m_text;
 };
 
+inline MethodUnit& MethodUnit::emplacePrint( std::string text )
+{
+    add( newPrint( std::move( text ) ) );
+    return *this;
+}
+
 #endif // ABSTRACTIONS_H
@@ -0,0 +1,393 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+#include <thread>
+#include <unordered_set>
+#include "DiffWriter.h"
+#include "MappedFile.h"
+#include "Pipeline.h"
+#ifdef CODE_CREATOR_ZLIB
+#include <zlib.h>
+#endif
+
+//Архив сгенерированного кода: все файлы всех языков в одном файле с оглавлением
+//Сотни тысяч маленьких файлов на сетевой файловой системе стоят дороже, чем их генерация:
+//архив открывается, пишется и закрывается один раз
+//
+//Раскладка (числа в порядке байт машины, записавшей архив, как в CompactImage.h):
+//  заголовок   magic[ 8 ] "CCARCH\r\n", uint32_t version, uint32_t byteOrder
+//  данные      содержимое записей подряд, каждая сжата отдельно (или хранится как есть)
+//  оглавление  для каждой записи ArchiveEntryHeader и имя длиной nameSize байт
+//  окончание   ArchiveFooter: смещение оглавления, число записей, magic[ 8 ] "CCINDEX\n"
+//Каждая запись сжимается независимо, поэтому чтение одной записи не требует распаковки остальных
+//Сжатие (zlib, deflate) доступно, если задан макрос CODE_CREATOR_ZLIB (qmake CONFIG+=zlib)
+
+struct ArchiveEntryHeader
+{
+    uint64_t offset;
+    //размер в архиве и исходный размер
+    uint64_t storedSize;
+    uint64_t size;
+    //DiffWriter::hash(...) исходного содержимого: проверяется при извлечении
+    uint64_t hash;
+    uint32_t method;
+    uint32_t nameSize;
+};
+
+struct ArchiveFooter
+{
+    uint64_t indexOffset;
+    uint64_t entryCount;
+    char magic[ 8 ];
+};
+
+struct ArchiveFormat
+{
+    enum Method : uint32_t { STORED = 0, DEFLATE = 1 };
+    static constexpr char MAGIC[ 8 ] = { 'C', 'C', 'A', 'R', 'C', 'H', '\r', '\n' };
+    static constexpr char INDEX_MAGIC[ 8 ] = { 'C', 'C', 'I', 'N', 'D', 'E', 'X', '\n' };
+    static const uint32_t VERSION = 1;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    static const size_t HEADER_SIZE = 16;
+
+    static_assert( sizeof( ArchiveEntryHeader ) == 40 && sizeof( ArchiveFooter ) == 24, "Index records are stored as is" );
+
+    //compressionAvailable() - собрана ли поддержка сжатия
+    static bool compressionAvailable()
+    {
+#ifdef CODE_CREATOR_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    }
+};
+
+//Запись архива
+//Сжатие и запись идут в отдельном потоке: add(...) только ставит файл в ограниченную очередь (BoundedQueue),
+//поэтому генерация следующих классов идёт одновременно со сжатием и записью предыдущих
+//Архив пишется во временный файл рядом и переименовывается в finish(), поэтому недописанный архив никто не увидит;
+//без finish() временный файл удаляется
+//add(...) и finish() вызываются из одного потока; ошибка фонового потока выбрасывается из следующего add(...) или finish()
+class ArchiveWriter
+{
+public:
+    //level - уровень сжатия zlib от 1 до 9, 0 - без сжатия
+    explicit ArchiveWriter( std::string path, int level = 0, size_t queueCapacity = 64 ):
+        m_path( std::move( path ) ), m_temporary( m_path + ".tmp" + std::to_string( ::getpid() ) ), m_level( level ),
+        m_queue( queueCapacity )
+    {
+        if( level < 0 || level > 9 )
+        {
+            throw std::runtime_error( "Compression level must be between 0 and 9" );
+        }
+        if( level > 0 && !ArchiveFormat::compressionAvailable() )
+        {
+            throw std::runtime_error( "Compression is not available: build with CONFIG+=zlib" );
+        }
+        m_fd = ::open( m_temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( m_fd < 0 )
+        {
+            throw std::runtime_error( "Can not create " + m_temporary + ": " + std::strerror( errno ) );
+        }
+        m_sink = std::make_unique< FdSink >( m_fd );
+        char header[ ArchiveFormat::HEADER_SIZE ];
+        std::memcpy( header, ArchiveFormat::MAGIC, 8 );
+        std::memcpy( header + 8, &ArchiveFormat::VERSION, 4 );
+        std::memcpy( header + 12, &ArchiveFormat::BYTE_ORDER_MARK, 4 );
+        m_sink->write( header, sizeof( header ) );
+        m_thread = std::thread( &ArchiveWriter::writeLoop, this );
+    }
+    ~ArchiveWriter()
+    {
+        if( m_thread.joinable() )
+        {
+            m_queue.close();
+            m_thread.join();
+        }
+        if( m_fd >= 0 )
+        {
+            m_sink.reset();
+            ::close( m_fd );
+            ::unlink( m_temporary.c_str() );
+        }
+    }
+    ArchiveWriter( const ArchiveWriter& ) = delete;
+    ArchiveWriter& operator=( const ArchiveWriter& ) = delete;
+
+    //add(...) - добавляет файл name с содержимым content
+    void add( std::string name, std::string content )
+    {
+        rethrow();
+        if( name.empty() || !m_names.insert( name ).second )
+        {
+            throw std::runtime_error( "Bad or repeated archive entry name '" + name + "'" );
+        }
+        m_queue.push( Item{ std::move( name ), std::move( content ) } );
+    }
+    //finish() - дописывает оглавление и заменяет архив path
+    void finish()
+    {
+        if( m_fd < 0 )
+        {
+            throw std::runtime_error( "Archive " + m_path + " is already finished" );
+        }
+        m_queue.close();
+        m_thread.join();
+        rethrow();
+        const uint64_t indexOffset = m_sink->written();
+        for( const auto& entry : m_index )
+        {
+            m_sink->write( reinterpret_cast< const char* >( &entry.header ), sizeof( entry.header ) );
+            *m_sink << entry.name;
+        }
+        ArchiveFooter footer{ indexOffset, m_index.size(), {} };
+        std::memcpy( footer.magic, ArchiveFormat::INDEX_MAGIC, sizeof( footer.magic ) );
+        m_sink->write( reinterpret_cast< const char* >( &footer ), sizeof( footer ) );
+        m_sink->flush();
+        m_sink.reset();
+        const int fd = m_fd;
+        m_fd = -1;
+        if( ::close( fd ) != 0 || ::rename( m_temporary.c_str(), m_path.c_str() ) != 0 )
+        {
+            const int error = errno;
+            ::unlink( m_temporary.c_str() );
+            throw std::runtime_error( "Can not replace " + m_path + ": " + std::strerror( error ) );
+        }
+    }
+
+    size_t entries() const
+    {
+        return m_names.size();
+    }
+    //bytesIn(), bytesStored() - исходный объём и объём в архиве; читать после finish()
+    uint64_t bytesIn() const
+    {
+        return m_bytesIn;
+    }
+    uint64_t bytesStored() const
+    {
+        return m_bytesStored;
+    }
+
+private:
+    struct Item
+    {
+        std::string name;
+        std::string content;
+    };
+    struct Entry
+    {
+        ArchiveEntryHeader header;
+        std::string name;
+    };
+
+    void rethrow()
+    {
+        if( m_failed.load() )
+        {
+            std::rethrow_exception( m_error );
+        }
+    }
+
+    //writeLoop() - фоновый поток: сжимает и пишет записи в порядке add(...)
+    void writeLoop()
+    {
+        Item item;
+        std::string compressed;
+        while( m_queue.pop( item ) )
+        {
+            //После ошибки очередь только опустошается, чтобы add(...) не ждал места вечно
+            if( m_failed.load() )
+            {
+                continue;
+            }
+            try
+            {
+                Entry entry{ ArchiveEntryHeader{ m_sink->written(), 0, item.content.size(), DiffWriter::hash( item.content ),
+                                                 ArchiveFormat::STORED, static_cast< uint32_t >( item.name.size() ) },
+                             std::move( item.name ) };
+                std::string_view stored = item.content;
+                if( m_level > 0 && compress( item.content, compressed ) )
+                {
+                    stored = compressed;
+                    entry.header.method = ArchiveFormat::DEFLATE;
+                }
+                entry.header.storedSize = stored.size();
+                *m_sink << stored;
+                m_bytesIn += item.content.size();
+                m_bytesStored += stored.size();
+                m_index.push_back( std::move( entry ) );
+            }
+            catch( ... )
+            {
+                m_error = std::current_exception();
+                m_failed.store( true );
+            }
+        }
+    }
+
+    //compress(...) - false, если сжатие не уменьшило размер (тогда запись хранится как есть)
+    bool compress( const std::string& content, std::string& result ) const
+    {
+#ifdef CODE_CREATOR_ZLIB
+        uLongf size = compressBound( static_cast< uLong >( content.size() ) );
+        result.resize( size );
+        const int status = compress2( reinterpret_cast< Bytef* >( &result[ 0 ] ), &size,
+                                      reinterpret_cast< const Bytef* >( content.data() ), static_cast< uLong >( content.size() ), m_level );
+        if( status != Z_OK )
+        {
+            throw std::runtime_error( "zlib compression failed" );
+        }
+        result.resize( size );
+        return size < content.size();
+#else
+        ( void )content;
+        ( void )result;
+        return false;
+#endif
+    }
+
+    const std::string m_path;
+    const std::string m_temporary;
+    const int m_level;
+    int m_fd = -1;
+    std::unique_ptr< FdSink > m_sink;
+    std::unordered_set< std::string > m_names;
+    BoundedQueue< Item > m_queue;
+    std::thread m_thread;
+    //Поля ниже меняет только фоновый поток; вызывающий поток читает их после join()
+    std::vector< Entry > m_index;
+    uint64_t m_bytesIn = 0;
+    uint64_t m_bytesStored = 0;
+    std::atomic< bool > m_failed{ false };
+    std::exception_ptr m_error;
+};
+
+//Чтение архива: файл отображается в память, разбирается только оглавление
+//extract(...) читает и распаковывает одну запись, не трогая остальных
+class ArchiveReader
+{
+public:
+    struct Entry
+    {
+        std::string name;
+        ArchiveEntryHeader header;
+    };
+
+    explicit ArchiveReader( const std::string& path ): m_file( path, MappedFile::READ )
+    {
+        const char* data = m_file.data();
+        const uint64_t size = m_file.size();
+        uint32_t version, byteOrder;
+        if( size < ArchiveFormat::HEADER_SIZE + sizeof( ArchiveFooter ) || std::memcmp( data, ArchiveFormat::MAGIC, 8 ) != 0 )
+        {
+            fail( "wrong signature" );
+        }
+        std::memcpy( &version, data + 8, 4 );
+        std::memcpy( &byteOrder, data + 12, 4 );
+        if( byteOrder != ArchiveFormat::BYTE_ORDER_MARK )
+        {
+            fail( "file was written with a different byte order" );
+        }
+        if( version != ArchiveFormat::VERSION )
+        {
+            fail( "unsupported version " + std::to_string( version ) );
+        }
+        ArchiveFooter footer;
+        std::memcpy( &footer, data + size - sizeof( footer ), sizeof( footer ) );
+        const uint64_t indexEnd = size - sizeof( footer );
+        if( std::memcmp( footer.magic, ArchiveFormat::INDEX_MAGIC, 8 ) != 0 || footer.indexOffset < ArchiveFormat::HEADER_SIZE ||
+            footer.indexOffset > indexEnd )
+        {
+            fail( "index is damaged or missing" );
+        }
+        uint64_t position = footer.indexOffset;
+        for( uint64_t i = 0; i < footer.entryCount; ++i )
+        {
+            Entry entry;
+            if( indexEnd - position < sizeof( ArchiveEntryHeader ) )
+            {
+                fail( "index is truncated" );
+            }
+            std::memcpy( &entry.header, data + position, sizeof( entry.header ) );
+            position += sizeof( entry.header );
+            const ArchiveEntryHeader& h = entry.header;
+            if( indexEnd - position < h.nameSize || h.offset < ArchiveFormat::HEADER_SIZE || h.offset > footer.indexOffset ||
+                h.storedSize > footer.indexOffset - h.offset || h.method > ArchiveFormat::DEFLATE )
+            {
+                fail( "entry " + std::to_string( i ) + " is damaged" );
+            }
+            entry.name.assign( data + position, h.nameSize );
+            position += h.nameSize;
+            m_index.emplace( entry.name, m_entries.size() );
+            m_entries.push_back( std::move( entry ) );
+        }
+    }
+
+    //entries() - записи в порядке добавления
+    const std::vector< Entry >& entries() const
+    {
+        return m_entries;
+    }
+    bool contains( const std::string& name ) const
+    {
+        return m_index.count( name ) != 0;
+    }
+    //extract(...) - содержимое записи name; std::runtime_error, если её нет или она повреждена
+    std::string extract( const std::string& name ) const
+    {
+        auto found = m_index.find( name );
+        if( found == m_index.end() )
+        {
+            throw std::runtime_error( "No entry '" + name + "' in the archive" );
+        }
+        const ArchiveEntryHeader& h = m_entries[ found->second ].header;
+        const char* stored = m_file.data() + h.offset;
+        std::string result;
+        if( h.method == ArchiveFormat::STORED )
+        {
+            result.assign( stored, h.storedSize );
+        }
+        else
+        {
+            result = inflate( stored, h.storedSize, h.size );
+        }
+        if( result.size() != h.size || DiffWriter::hash( result ) != h.hash )
+        {
+            fail( "entry '" + name + "' is damaged" );
+        }
+        return result;
+    }
+
+private:
+    [[ noreturn ]] static void fail( const std::string& message )
+    {
+        throw std::runtime_error( "Bad archive: " + message );
+    }
+
+    static std::string inflate( const char* data, uint64_t storedSize, uint64_t size )
+    {
+#ifdef CODE_CREATOR_ZLIB
+        std::string result( size, '\0' );
+        uLongf length = static_cast< uLongf >( size );
+        if( uncompress( reinterpret_cast< Bytef* >( &result[ 0 ] ), &length, reinterpret_cast< const Bytef* >( data ),
+                        static_cast< uLong >( storedSize ) ) != Z_OK )
+        {
+            fail( "can not decompress entry" );
+        }
+        result.resize( length );
+        return result;
+#else
+        ( void )data;
+        ( void )storedSize;
+        ( void )size;
+        throw std::runtime_error( "Archive entry is compressed, but compression is not available: build with CONFIG+=zlib" );
+#endif
+    }
+
+    MappedFile m_file;
+    std::vector< Entry > m_entries;
+    std::unordered_map< std::string, size_t > m_index;
+};
+
+#endif // ARCHIVE_H
@@ -0,0 +1,247 @@
+#ifndef BACKENDS_H
+#define BACKENDS_H
+#include "Model.h"
+#include "Pluses.h"
+#include "CSharp.h"
+#include "Java.h"
+
+//Генерация кода из модели (Model.h)
+//Backend - язык, в который переводится модель. Правила каждого языка берутся из тех же структур
+//PlussesSyntax, CSharpSyntax и JavaSyntax, которыми пользуются узлы Unit, поэтому результат совпадает
+class Backend
+{
+public:
+    using Flags = Unit::Flags;
+    virtual ~Backend() = default;
+    //название языка
+    virtual const char* name() const = 0;
+    //checkClass(...) - проверяет, что класс модели можно записать на этом языке
+    //Вызывается до того, как в приёмник попадёт хоть один байт класса
+    virtual void checkClass( const ModelClass& modelClass ) const = 0;
+    //checkMethod(...) - проверяет, что сочетание модификаторов метода допустимо в этом языке
+    virtual void checkMethod( const ModelMethod& method ) const = 0;
+    virtual void classOpen( Sink& sink, unsigned int level, const ModelClass& modelClass ) const = 0;
+    virtual void sectionOpen( Sink& sink, unsigned int level, size_t access ) const = 0;
+    virtual void memberPrefix( Sink& sink, unsigned int level, size_t access ) const = 0;
+    virtual void sectionClose( Sink& sink, unsigned int level ) const = 0;
+    virtual void classClose( Sink& sink, unsigned int level ) const = 0;
+    virtual void methodOpen( Sink& sink, unsigned int level, const ModelMethod& method ) const = 0;
+    virtual void methodClose( Sink& sink, unsigned int level ) const = 0;
+    virtual void print( Sink& sink, unsigned int level, const ModelPrint& print ) const = 0;
+};
+
+//Реализация Backend поверх правил синтаксиса конкретного языка
+template< class Syntax >
+class SyntaxBackend: public Backend
+{
+public:
+    const char* name() const override
+    {
+        return Syntax::name();
+    }
+    void checkClass( const ModelClass& modelClass ) const override
+    {
+        Syntax::checkClass( classAccess( modelClass ), modelClass.modifier() );
+        const auto& fields = modelClass.fields();
+        for( size_t i = 0; i < fields.size(); ++i )
+        {
+            if( !fields[ i ].empty() )
+            {
+                Syntax::checkAccess( static_cast< Flags >( i ) );
+            }
+        }
+    }
+    void checkMethod( const ModelMethod& method ) const override
+    {
+        Syntax::checkMethod( method.flags() );
+    }
+    void classOpen( Sink& sink, unsigned int level, const ModelClass& modelClass ) const override
+    {
+        Syntax::classOpen( sink, level, modelClass.name(), classAccess( modelClass ), modelClass.modifier() );
+    }
+    void sectionOpen( Sink& sink, unsigned int level, size_t access ) const override
+    {
+        Syntax::sectionOpen( sink, level, access );
+    }
+    void memberPrefix( Sink& sink, unsigned int level, size_t access ) const override
+    {
+        Syntax::memberPrefix( sink, level, access );
+    }
+    void sectionClose( Sink& sink, unsigned int level ) const override
+    {
+        Syntax::sectionClose( sink, level );
+    }
+    void classClose( Sink& sink, unsigned int level ) const override
+    {
+        Syntax::classClose( sink, level );
+    }
+    void methodOpen( Sink& sink, unsigned int level, const ModelMethod& method ) const override
+    {
+        Syntax::methodOpen( sink, level, method.name(), method.returnType(), method.flags() );
+    }
+    void methodClose( Sink& sink, unsigned int level ) const override
+    {
+        Syntax::methodClose( sink, level );
+    }
+    void print( Sink& sink, unsigned int level, const ModelPrint& print ) const override
+    {
+        Syntax::print( sink, level, print.text() );
+    }
+private:
+    //Если у класса модели тип доступа не задан, используется принятый в языке по умолчанию
+    static Flags classAccess( const ModelClass& modelClass )
+    {
+        return modelClass.accessOr( Syntax::DEFAULT_CLASS_ACCESS );
+    }
+};
+
+using PlussesBackend = SyntaxBackend< PlussesSyntax >;
+using CSharpBackend = SyntaxBackend< CSharpSyntax >;
+using JavaBackend = SyntaxBackend< JavaSyntax >;
+
+//Генератор, который за один обход модели пишет код сразу для нескольких языков
+//Каждому языку соответствует свой приёмник; узлы модели при этом не копируются и не изменяются
+class ModelEmitter
+{
+public:
+    //addTarget(...) - добавляет язык и приёмник, в который пойдёт код на этом языке
+    void addTarget( const Backend& backend, Sink& sink )
+    {
+        m_targets.push_back( Target{ &backend, &sink } );
+    }
+    //emit(...) - обходит узел модели один раз и генерирует код для всех добавленных языков
+    //Всё поддерево проверяется во всех языках до первой записи, поэтому при ошибке в приёмники ничего не попадает
+    void emit( const ModelNode& node, unsigned int level = 0 ) const
+    {
+        check( node );
+        write( node, level );
+    }
+private:
+    struct Target
+    {
+        const Backend* backend;
+        Sink* sink;
+    };
+
+    //check(...) - проверяет узел и всех его потомков во всех языках, ничего не записывая
+    void check( const ModelNode& node ) const
+    {
+        switch( node.kind() )
+        {
+        case ModelNode::CLASS:
+        {
+            const ModelClass& modelClass = static_cast< const ModelClass& >( node );
+            for( const auto& t : m_targets )
+            {
+                t.backend->checkClass( modelClass );
+            }
+            for( const auto& section : modelClass.fields() )
+            {
+                for( const auto& f : section )
+                {
+                    check( *f );
+                }
+            }
+            break;
+        }
+        case ModelNode::METHOD:
+        {
+            const ModelMethod& method = static_cast< const ModelMethod& >( node );
+            for( const auto& t : m_targets )
+            {
+                t.backend->checkMethod( method );
+            }
+            for( const auto& b : method.body() )
+            {
+                check( *b );
+            }
+            break;
+        }
+        case ModelNode::PRINT:
+            break;
+        default:
+            throw std::runtime_error( "Unknown model node" );
+        }
+    }
+
+    //write(...) - генерирует код уже проверенного узла
+    void write( const ModelNode& node, unsigned int level ) const
+    {
+        switch( node.kind() )
+        {
+        case ModelNode::CLASS:
+            emitClass( static_cast< const ModelClass& >( node ), level );
+            break;
+        case ModelNode::METHOD:
+            emitMethod( static_cast< const ModelMethod& >( node ), level );
+            break;
+        default:
+            emitPrint( static_cast< const ModelPrint& >( node ), level );
+            break;
+        }
+    }
+
+    void emitClass( const ModelClass& modelClass, unsigned int level ) const
+    {
+        for( const auto& t : m_targets )
+        {
+            t.backend->classOpen( *t.sink, level, modelClass );
+        }
+        const auto& fields = modelClass.fields();
+        for( size_t i = 0; i < fields.size(); ++i )
+        {
+            if( fields[ i ].empty() )
+            {
+                continue;
+            }
+            for( const auto& t : m_targets )
+            {
+                t.backend->sectionOpen( *t.sink, level, i );
+            }
+            for( const auto& f : fields[ i ] )
+            {
+                for( const auto& t : m_targets )
+                {
+                    t.backend->memberPrefix( *t.sink, level + 1, i );
+                }
+                write( *f, level + 1 );
+            }
+            for( const auto& t : m_targets )
+            {
+                t.backend->sectionClose( *t.sink, level );
+            }
+        }
+        for( const auto& t : m_targets )
+        {
+            t.backend->classClose( *t.sink, level );
+        }
+    }
+
+    void emitMethod( const ModelMethod& method, unsigned int level ) const
+    {
+        for( const auto& t : m_targets )
+        {
+            t.backend->methodOpen( *t.sink, level, method );
+        }
+        for( const auto& b : method.body() )
+        {
+            write( *b, level + 1 );
+        }
+        for( const auto& t : m_targets )
+        {
+            t.backend->methodClose( *t.sink, level );
+        }
+    }
+
+    void emitPrint( const ModelPrint& print, unsigned int level ) const
+    {
+        for( const auto& t : m_targets )
+        {
+            t.backend->print( *t.sink, level, print );
+        }
+    }
+
+    std::vector< Target > m_targets;
+};
+
+#endif // BACKENDS_H
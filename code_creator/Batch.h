@@ -0,0 +1,124 @@
+#ifndef BATCH_H
+#define BATCH_H
+#include "Backends.h"
+#include "Factories.h"
+#include "ThreadPool.h"
+
+//Пакетная генерация множества независимых классов на пуле потоков
+//Генерация готового дерева только читает его, поэтому классы компилируются параллельно без блокировок
+//Порядок результатов всегда совпадает с порядком входных классов, сколько бы потоков ни было
+class BatchGenerator
+{
+public:
+    //threads - размер пула; 0 означает "по числу ядер"
+    explicit BatchGenerator( size_t threads = 0 ): m_pool( threads ) {}
+
+    size_t threads() const
+    {
+        return m_pool.size();
+    }
+
+    ThreadPool& pool()
+    {
+        return m_pool;
+    }
+
+    //compile(...) - компилирует готовые деревья Unit (построенные любыми фабриками)
+    //result[ i ] - код дерева trees[ i ]
+    std::vector< std::string > compile( const std::vector< std::shared_ptr< Unit > >& trees )
+    {
+        std::vector< std::string > result( trees.size() );
+        TaskGroup group( m_pool );
+        for( size_t i = 0; i < trees.size(); ++i )
+        {
+            if( trees[ i ] == nullptr )
+            {
+                continue;
+            }
+            const Unit* tree = trees[ i ].get();
+            std::string* output = &result[ i ];
+            group.run( [ tree, output ]
+            {
+                StringSink sink( *output );
+                tree->compileTo( sink );
+            } );
+        }
+        group.wait();
+        return result;
+    }
+
+    //Построитель дерева класса: получает фабрику нужного языка и возвращает готовое дерево
+    using Builder = std::function< std::shared_ptr< Unit >( const AbstractFactory& ) >;
+
+    //compile(...) - строит и компилирует каждый класс каждой фабрикой
+    //Построение тоже идёт параллельно; result[ i ][ f ] - класс builders[ i ] на языке фабрики factories[ f ]
+    //Фабрики вызываются из нескольких потоков сразу, поэтому они не должны размещать узлы в арене:
+    //UnitArena не потокобезопасна, и для фабрики с ареной бросается std::runtime_error
+    std::vector< std::vector< std::string > > compile( const std::vector< Builder >& builders, const std::vector< const AbstractFactory* >& factories )
+    {
+        for( const AbstractFactory* factory : factories )
+        {
+            if( factory->arena() != nullptr )
+            {
+                throw std::runtime_error( "BatchGenerator::compile: factory must not allocate in an arena" );
+            }
+        }
+        std::vector< std::vector< std::string > > result( builders.size(), std::vector< std::string >( factories.size() ) );
+        TaskGroup group( m_pool );
+        for( size_t i = 0; i < builders.size(); ++i )
+        {
+            for( size_t f = 0; f < factories.size(); ++f )
+            {
+                const Builder* builder = &builders[ i ];
+                const AbstractFactory* factory = factories[ f ];
+                std::string* output = &result[ i ][ f ];
+                group.run( [ builder, factory, output ]
+                {
+                    std::shared_ptr< Unit > tree = ( *builder )( *factory );
+                    if( tree != nullptr )
+                    {
+                        StringSink sink( *output );
+                        tree->compileTo( sink );
+                    }
+                } );
+            }
+        }
+        group.wait();
+        return result;
+    }
+
+    //compile(...) - генерирует код моделей сразу для нескольких языков
+    //Каждая модель обходится один раз для всех языков; result[ i ][ t ] - код модели models[ i ] на языке backends[ t ]
+    std::vector< std::vector< std::string > > compile( const std::vector< ModelNode::Ptr >& models, const std::vector< const Backend* >& backends )
+    {
+        std::vector< std::vector< std::string > > result( models.size(), std::vector< std::string >( backends.size() ) );
+        TaskGroup group( m_pool );
+        for( size_t i = 0; i < models.size(); ++i )
+        {
+            if( models[ i ] == nullptr )
+            {
+                continue;
+            }
+            const ModelNode* model = models[ i ].get();
+            std::vector< std::string >* outputs = &result[ i ];
+            group.run( [ model, outputs, &backends ]
+            {
+                std::vector< std::unique_ptr< StringSink > > sinks;
+                ModelEmitter emitter;
+                for( size_t t = 0; t < backends.size(); ++t )
+                {
+                    sinks.emplace_back( new StringSink( ( *outputs )[ t ] ) );
+                    emitter.addTarget( *backends[ t ], *sinks.back() );
+                }
+                emitter.emit( *model );
+            } );
+        }
+        group.wait();
+        return result;
+    }
+
+private:
+    ThreadPool m_pool;
+};
+
+#endif // BATCH_H
@@ -1,6 +1,138 @@
 #ifndef CSHARP_H
 #define CSHARP_H
 #include "Abstractions.h"
+#include "UnitArena.h"
+#include "Escape.h"
+
+//Правила синтаксиса языка C#
+struct CSharpSyntax
+{
+    static const char* name()
+    {
+        return "C#";
+    }
+    //У C# имеется 6 типов доступа
+    //Номер языка в таблицах (счётчики Instrumentation и т.п.)
+    static const size_t LANGUAGE_INDEX = 1;
+    //Ключевые слова и синтаксис оператора вывода - константы времени компиляции
+    static constexpr const char* CLASS_KEYWORD = "class ";
+    static constexpr const char* CLASS_CLOSE = "};\n";
+    static constexpr const char* PRINT_OPEN = "System.Console.WriteLine( \"";
+    static constexpr const char* PRINT_CLOSE = "\" );\n";
+    static const size_t ACCESS_COUNT = 6;
+    //Тип доступа класса по умолчанию (как в CSharpClassUnit)
+    static const Unit::Flags DEFAULT_CLASS_ACCESS = ClassUnit::PRIVATE;
+    //Если пользователь ввёл не тот символ, программа выдаст соответствующее сообщение об этом
+    static void checkAccess( Unit::Flags flags )
+    {
+        if( flags >= ACCESS_COUNT )
+        {
+            throw std::runtime_error("In C# there is no accessModifire like this");
+        }
+    }
+    //Также у C# есть тип доступа самого класса, где также имеется 6 вариантов
+    static void checkClass( Unit::Flags classAccess, Unit::Flags /* classModifier */ )
+    {
+        checkAccess( classAccess );
+    }
+    template< class Out >
+    static void classOpen( Out& sink, unsigned int level, std::string_view name, Unit::Flags classAccess, Unit::Flags /* classModifier */ )
+    {
+        //Сначала объявляем тип доступа класса
+        writeShift( sink, level );
+        if( classAccess != ClassUnit::PRIVATE )
+        {
+            sink << ClassUnit::ACCESS_MODIFIERS[ classAccess ] << ' ';
+        }
+        //После того, как определили тип доступа класса, переходим к непосредственному объявлению класса
+        sink << CLASS_KEYWORD << name << " {\n";
+    }
+    template< class Out >
+    static void sectionOpen( Out& sink, unsigned int /* level */, size_t access )
+    {
+        sink << ClassUnit::ACCESS_MODIFIERS[ access ] << ":\n";
+    }
+    //Поскольку у функций также много различных типов доступа, необходимо их добавить перед каждым методом
+    template< class Out >
+    static void memberPrefix( Out& sink, unsigned int level, size_t access )
+    {
+        writeShift( sink, level );
+        sink << ClassUnit::ACCESS_MODIFIERS[ access ] << ' ';
+    }
+    template< class Out >
+    static void sectionClose( Out& sink, unsigned int /* level */ )
+    {
+        sink << "\n";
+    }
+    template< class Out >
+    static void classClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << CLASS_CLOSE;
+    }
+    //Проверка модификаторов метода: virtual, static и abstract взаимно исключают друг друга
+    static void checkMethod( Unit::Flags flags )
+    {
+        const Unit::Flags exclusive = flags & ( MethodUnit::VIRTUAL | MethodUnit::STATIC | MethodUnit::ABSTRACT );
+        if( exclusive & ( exclusive - 1 ) )
+        {
+            throw std::runtime_error( "In C# method can be only one of virtual, static and abstract" );
+        }
+    }
+    //Модификаторы перед типом метода для набора флагов flags (берутся из таблицы)
+    static std::string_view methodPrefix( Unit::Flags flags )
+    {
+        static const ModifierTable table( []( Unit::Flags f )
+        {
+            std::string prefix;
+            if( f & MethodUnit::VIRTUAL )
+            {
+                prefix += "virtual ";
+            }
+            else
+            {
+                if( f & MethodUnit::STATIC )
+                {
+                    prefix += "static ";
+                }
+                if( f & MethodUnit::ABSTRACT )
+                {
+                    prefix += "abstract ";
+                }
+            }
+            if( f & MethodUnit::ASYNC )
+            {
+                prefix += "async ";
+            }
+            if( f & MethodUnit::UNSAVE )
+            {
+                prefix += "unsave ";
+            }
+            return prefix;
+        } );
+        return table[ flags ];
+    }
+    //Объявление метода; отступ уже поставлен вместе с типом доступа в memberPrefix(...)
+    template< class Out >
+    static void methodOpen( Out& sink, unsigned int /* level */, std::string_view name, std::string_view returnType, Unit::Flags flags )
+    {
+        sink << methodPrefix( flags ) << returnType << ' ' << name << "() {\n";
+    }
+    template< class Out >
+    static void methodClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << "}\n";
+    }
+    template< class Out >
+    static void print( Out& sink, unsigned int level, std::string_view text )
+    {
+        writeShift( sink, level );
+        sink << PRINT_OPEN;
+        Escape::csharp( sink, text );
+        sink << PRINT_CLOSE;
+    }
+};
 
 class CSharpClassUnit: public ClassUnit
 {
@@ -8,24 +140,18 @@ private:
     //Тип доступа для класса
     Flags accessesModifier_class;
 public:
-    explicit CSharpClassUnit( const std::string& name, Flags flag = PRIVATE ): ClassUnit(name)
+    //правила языка, по которым генерируется узел
+    using Syntax = CSharpSyntax;
+    explicit CSharpClassUnit( std::string_view name, Flags flag = PRIVATE ): ClassUnit(name)
     {
         //У C# имеется 6 типов доступа, поэтому изменяем размер на 6
-        m_fields.resize(6);
+        m_fields.resize(CSharpSyntax::ACCESS_COUNT);
         //Также у C# есть тип доступа самого класса, где также имеется 6 вариантов
-        //Если пользователь ввёл не тот символ, программа выдаст соответствующее сообщение об этом
-        if(flag >= 6)
-        {
-            throw std::runtime_error("In C# there is no accessModifire like this");
-        }
-        else
-        {
-            accessesModifier_class = flag;
-        }
-
+        CSharpSyntax::checkClass(flag, 0);
+        accessesModifier_class = flag;
     }
 
-    void add(const std::shared_ptr< Unit >& unit, Flags flags) override
+    void add(std::shared_ptr< Unit > unit, Flags flags) override
     {
         //Проверка, существует ли объект
         if(unit == nullptr)
@@ -33,106 +159,80 @@ public:
             return;
         }
         //Определение типа доступа
-        int accessModifier = PRIVATE;
-        if(flags < 6)
-        {
-            accessModifier = flags;
-        }
         //В случае некорректного ввода, программа выдаст соответствующее сообщение
-        else
-        {
-            throw std::runtime_error("In C# there is no accessModifire like this");
-        }
+        CSharpSyntax::checkAccess(flags);
         //Добавление метода и его типа доступа
-        m_fields[accessModifier].push_back(unit);
+        addField< Syntax >(std::move(unit), flags);
     }
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        //Сначала объявляем тип доступа класса
-        std::string classAccess = "";
-        if(accessesModifier_class != PRIVATE)
-        {
-            classAccess = ACCESS_MODIFIERS[accessesModifier_class] + ' ';
-        }
-        //После того, как определили тип доступа класса, переходим к непосредственному объявлению класса
-        std::string result = generateShift(level) + classAccess + "class " + m_name + " {\n";
-        //Аналогично С++, определяем методы и их тела
-        for( size_t i = 0; i < m_fields.size(); ++i )
-        {
-            if( m_fields[ i ].empty() )
-            {
-                continue;
-            }
-            result += ACCESS_MODIFIERS[ i ] + ":\n";
-
-            //Поскольку у функций также много различных типов доступа, необходимо их добавить
-            for( const auto& f : m_fields[ i ] )
-            {
-                result += generateShift( level + 1 ) + ACCESS_MODIFIERS[i] + ' ' + f->compile(level+1);
-            }
-            result += "\n";
-        }
-        result += generateShift( level ) + "};\n";
-        return result;
+        compileClass< Syntax >( sink, level, accessesModifier_class, 0 );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureClass< Syntax >( level, accessesModifier_class, 0 );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenClass< Syntax >( sink, level, accessesModifier_class, 0 );
+    }
+    const Unit* stepChild( Sink& sink, unsigned int level, size_t index ) const override
+    {
+        return stepChildClass< Syntax >( sink, level, index );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseClass< Syntax >( sink, level );
+    }
+    std::shared_ptr< MethodUnit > newMethod( std::string_view name, std::string_view returnType, Flags flags ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags classAccess, Flags /* classModifier */ ) const override
+    {
+        return makeUnit< CSharpClassUnit >( arena(), name, classAccess );
     }
 };
 
 class CSharpMethodUnit: public MethodUnit
 {
 public:
-    CSharpMethodUnit( const std::string& name, const std::string& returnType, Flags flags ): MethodUnit(name, returnType, flags){}
+    //правила языка, по которым генерируется узел
+    using Syntax = CSharpSyntax;
+    CSharpMethodUnit( std::string_view name, std::string_view returnType, Flags flags ): MethodUnit(name, returnType, flags)
+    {
+        //Недопустимое сочетание модификаторов отклоняем сразу, а не при генерации
+        Syntax::checkMethod( flags );
+    }
 
-    void add( const std::shared_ptr< Unit >& unit, Flags /* flags */ = 0 ) override
+    void add( std::shared_ptr< Unit > unit, Flags /* flags */ = 0 ) override
     {
         //Допускаем, что тело функции может быть пустым
         if(unit != nullptr){
-            m_body.push_back( unit );
+            addBody< Syntax >( std::move( unit ) );
         }
     }
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        //Модификаторы
-        std::string result = "";
-
-        if( m_flags & VIRTUAL) {
-            result += "virtual ";
-        }
-        // при объявлении метода не могут стоять одновременно virtual и static/abstract
-        else
-        {
-            if(m_flags & STATIC)
-            {
-                result += "static ";
-            }
-            if(m_flags & ABSTRACT)
-            {
-                result += "abstract ";
-            }
-        }
-
-        if( m_flags & ASYNC )
-        {
-            result += "async ";
-        }
-
-        if( m_flags & UNSAVE )
-        {
-            result += "unsave ";
-        }
-        //Инициализация метода
-        result += m_returnType + " ";
-        result += m_name + "()";
-
-        result += " {\n";
-        //Соборка тела метода
-        for( const auto& b : m_body )
-        {
-            result += b->compile( level + 1 );
-        }
-        result += generateShift( level ) + "}\n";
-        return result;
+        compileMethod< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureMethod< Syntax >( level );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenMethod< Syntax >( sink, level );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseMethod< Syntax >( sink, level );
+    }
+    std::shared_ptr< PrintOperatorUnit > newPrint( std::string text ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags classAccess, Flags /* classModifier */ ) const override
+    {
+        return makeUnit< CSharpClassUnit >( arena(), name, classAccess );
     }
 };
 
@@ -140,12 +240,28 @@ public:
 class CSharpPrintOperatorUnit: public PrintOperatorUnit
 {
 public:
-    explicit CSharpPrintOperatorUnit( const std::string& text ): PrintOperatorUnit(text){}
-    std::string compile( unsigned int level = 0 ) const override
+    //правила языка, по которым генерируется узел
+    using Syntax = CSharpSyntax;
+    explicit CSharpPrintOperatorUnit( std::string text ): PrintOperatorUnit(std::move(text)){}
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
+    {
+        compilePrint< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
     {
-        return generateShift( level ) + "System.Console.WriteLine( \"" + m_text + "\" );\n";
+        return measurePrint< Syntax >( level );
     }
 };
 
 
+//Узлы, которые создаются функциями emplace...(...), определены ниже своих родителей
+inline std::shared_ptr< MethodUnit > CSharpClassUnit::newMethod( std::string_view name, std::string_view returnType, Flags flags ) const
+{
+    return makeUnit< CSharpMethodUnit >( arena(), name, returnType, flags );
+}
+inline std::shared_ptr< PrintOperatorUnit > CSharpMethodUnit::newPrint( std::string text ) const
+{
+    return makeUnit< CSharpPrintOperatorUnit >( arena(), std::move( text ) );
+}
+
 #endif // CSHARP_H
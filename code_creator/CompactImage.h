@@ -0,0 +1,251 @@
+#ifndef COMPACTIMAGE_H
+#define COMPACTIMAGE_H
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <type_traits>
+#include "CompactTree.h"
+#include "MappedFile.h"
+
+//Двоичный образ компактного дерева (CompactTree.h) на диске
+//Массивы дерева записываются в файл как есть, поэтому загрузка - это отображение файла в память и проверка заголовка:
+//CompactView указывает прямо в отображённые страницы, и CompactGenerator генерирует код по ним без разбора и копирования
+//
+//Раскладка файла (все числа в порядке байт машины, записавшей файл; каждый раздел выровнен на 8 байт):
+//  заголовок CompactImageHeader
+//  words       - uint32_t[ nodeCount ]       слово узла (вид, типы доступа, модификаторы)
+//  firstChild  - uint32_t[ nodeCount ]       номер первого ребёнка
+//  childCount  - uint32_t[ nodeCount ]       количество детей
+//  names       - CompactString[ nodeCount ]  имя класса или метода, текст вывода
+//  types       - CompactString[ nodeCount ]  возвращаемый тип метода
+//  pool        - char[ poolSize ]            общий буфер строк
+//При несовместимом изменении раскладки увеличивается VERSION
+
+struct CompactImageHeader
+{
+    char magic[ 8 ];
+    uint32_t version;
+    //BYTE_ORDER_MARK, записанный машиной-автором: по нему отличается файл с другим порядком байт
+    uint32_t byteOrder;
+    uint32_t nodeCount;
+    uint32_t rootCount;
+    uint64_t poolSize;
+    uint64_t wordsOffset;
+    uint64_t firstChildOffset;
+    uint64_t childCountOffset;
+    uint64_t namesOffset;
+    uint64_t typesOffset;
+    uint64_t poolOffset;
+    uint64_t fileSize;
+};
+
+class CompactImage
+{
+public:
+    using Index = CompactView::Index;
+    static constexpr char MAGIC[ 8 ] = { 'C', 'C', 'T', 'R', 'E', 'E', '\r', '\n' };
+    static const uint32_t VERSION = 1;
+    static const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    static_assert( std::is_trivially_copyable< CompactString >::value && sizeof( CompactString ) == 8, "CompactString is stored as is" );
+    static_assert( sizeof( CompactImageHeader ) % 8 == 0, "Sections after the header must stay aligned" );
+
+    //Загружает образ из файла path; бросает std::runtime_error, если файл не является образом этой версии
+    //Проверяется только заголовок, поэтому время загрузки не зависит от размера дерева
+    explicit CompactImage( const std::string& path ): m_file( path, MappedFile::READ )
+    {
+        m_view = attach( m_file.data(), m_file.size() );
+    }
+
+    const CompactView& view() const
+    {
+        return m_view;
+    }
+    Index size() const
+    {
+        return m_view.nodeCount;
+    }
+    Index rootCount() const
+    {
+        return m_view.rootCount;
+    }
+
+    //save(...) - записывает дерево в файл path, заменяя его содержимое; возвращает размер файла
+    //Образ пишется во временный файл рядом и переименовывается поверх path, поэтому читатель, отобразивший
+    //старый образ, не увидит обрезанный файл, а при ошибке записи на месте path остаётся прежний образ
+    static size_t save( const CompactView& tree, const std::string& path )
+    {
+        const uint64_t poolSize = poolUsage( tree );
+        CompactImageHeader header = {};
+        std::memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+        header.version = VERSION;
+        header.byteOrder = BYTE_ORDER_MARK;
+        header.nodeCount = tree.nodeCount;
+        header.rootCount = tree.rootCount;
+        header.poolSize = poolSize;
+        uint64_t offset = sizeof( CompactImageHeader );
+        header.wordsOffset = section( offset, tree.nodeCount * sizeof( uint32_t ) );
+        header.firstChildOffset = section( offset, tree.nodeCount * sizeof( Index ) );
+        header.childCountOffset = section( offset, tree.nodeCount * sizeof( Index ) );
+        header.namesOffset = section( offset, tree.nodeCount * sizeof( CompactString ) );
+        header.typesOffset = section( offset, tree.nodeCount * sizeof( CompactString ) );
+        header.poolOffset = section( offset, poolSize );
+        header.fileSize = offset;
+
+        const std::string temporary = path + ".tmp" + std::to_string( ::getpid() );
+        try
+        {
+            MappedFile file( temporary, MappedFile::WRITE, static_cast< size_t >( header.fileSize ) );
+            char* data = file.data();
+            std::memcpy( data, &header, sizeof( header ) );
+            copy( data + header.wordsOffset, tree.words, tree.nodeCount * sizeof( uint32_t ) );
+            copy( data + header.firstChildOffset, tree.firstChild, tree.nodeCount * sizeof( Index ) );
+            copy( data + header.childCountOffset, tree.childCount, tree.nodeCount * sizeof( Index ) );
+            copy( data + header.namesOffset, tree.names, tree.nodeCount * sizeof( CompactString ) );
+            copy( data + header.typesOffset, tree.types, tree.nodeCount * sizeof( CompactString ) );
+            copy( data + header.poolOffset, tree.pool, poolSize );
+        }
+        catch( ... )
+        {
+            ::unlink( temporary.c_str() );
+            throw;
+        }
+        if( ::rename( temporary.c_str(), path.c_str() ) != 0 )
+        {
+            const int error = errno;
+            ::unlink( temporary.c_str() );
+            throw std::runtime_error( "Can not replace " + path + ": " + std::strerror( error ) );
+        }
+        return static_cast< size_t >( header.fileSize );
+    }
+    static size_t save( const CompactTree& tree, const std::string& path )
+    {
+        return save( tree.view(), path );
+    }
+
+    //verify() - полная проверка ссылок между узлами и на строки за один проход по массивам
+    //Нужна для файлов из недоверенных источников: без неё повреждённый образ может привести к выходу за границы при генерации
+    void verify() const
+    {
+        const CompactView& v = m_view;
+        const uint64_t poolSize = m_header->poolSize;
+        for( Index node = 0; node < v.nodeCount; ++node )
+        {
+            const uint64_t first = v.firstChild[ node ];
+            const uint64_t count = v.childCount[ node ];
+            //Дети в раскладке обхода в ширину всегда лежат после родителя, поэтому циклов быть не может
+            if( count != 0 && ( first <= node || first + count > v.nodeCount ) )
+            {
+                fail( "child range of node " + std::to_string( node ) + " is out of bounds" );
+            }
+            if( ( v.words[ node ] >> CompactView::KIND_SHIFT ) > CompactView::PRINT || ( v.kind( node ) == CompactView::PRINT && count != 0 ) )
+            {
+                fail( "node " + std::to_string( node ) + " is damaged" );
+            }
+            if( uint64_t( v.names[ node ].offset ) + v.names[ node ].size > poolSize ||
+                uint64_t( v.types[ node ].offset ) + v.types[ node ].size > poolSize )
+            {
+                fail( "string of node " + std::to_string( node ) + " is out of bounds" );
+            }
+        }
+    }
+
+private:
+    static const uint64_t ALIGNMENT = 8;
+
+    //section(...) - отводит место под раздел размером size и возвращает его смещение
+    static uint64_t section( uint64_t& offset, uint64_t size )
+    {
+        const uint64_t result = offset;
+        offset = ( offset + size + ALIGNMENT - 1 ) & ~( ALIGNMENT - 1 );
+        return result;
+    }
+    static void copy( char* destination, const void* source, size_t size )
+    {
+        if( size != 0 )
+        {
+            std::memcpy( destination, source, size );
+        }
+    }
+    //poolUsage(...) - длина используемой части буфера строк: CompactView не хранит её явно
+    static uint64_t poolUsage( const CompactView& tree )
+    {
+        uint64_t result = 0;
+        for( Index node = 0; node < tree.nodeCount; ++node )
+        {
+            result = std::max( result, uint64_t( tree.names[ node ].offset ) + tree.names[ node ].size );
+            result = std::max( result, uint64_t( tree.types[ node ].offset ) + tree.types[ node ].size );
+        }
+        return result;
+    }
+    static void fail( const std::string& message )
+    {
+        throw std::runtime_error( "Bad compact image: " + message );
+    }
+    //checkSection(...) - раздел лежит внутри файла и выровнен
+    static void checkSection( const CompactImageHeader& header, uint64_t offset, uint64_t size, const char* name )
+    {
+        if( offset % ALIGNMENT != 0 || offset < sizeof( CompactImageHeader ) || offset > header.fileSize || size > header.fileSize - offset )
+        {
+            fail( std::string( name ) + " section is out of bounds" );
+        }
+    }
+
+    CompactView attach( const char* data, size_t size )
+    {
+        if( size < sizeof( CompactImageHeader ) )
+        {
+            fail( "file is too small" );
+        }
+        m_header = reinterpret_cast< const CompactImageHeader* >( data );
+        const CompactImageHeader& header = *m_header;
+        if( std::memcmp( header.magic, MAGIC, sizeof( MAGIC ) ) != 0 )
+        {
+            fail( "wrong signature" );
+        }
+        if( header.byteOrder != BYTE_ORDER_MARK )
+        {
+            fail( "file was written with a different byte order" );
+        }
+        if( header.version != VERSION )
+        {
+            fail( "unsupported version " + std::to_string( header.version ) );
+        }
+        if( header.fileSize != size )
+        {
+            fail( "file size does not match the header" );
+        }
+        if( header.rootCount > header.nodeCount )
+        {
+            fail( "too many roots" );
+        }
+        const uint64_t nodes = header.nodeCount;
+        checkSection( header, header.wordsOffset, nodes * sizeof( uint32_t ), "words" );
+        checkSection( header, header.firstChildOffset, nodes * sizeof( Index ), "firstChild" );
+        checkSection( header, header.childCountOffset, nodes * sizeof( Index ), "childCount" );
+        checkSection( header, header.namesOffset, nodes * sizeof( CompactString ), "names" );
+        checkSection( header, header.typesOffset, nodes * sizeof( CompactString ), "types" );
+        checkSection( header, header.poolOffset, header.poolSize, "pool" );
+
+        CompactView v;
+        v.words = reinterpret_cast< const uint32_t* >( data + header.wordsOffset );
+        v.firstChild = reinterpret_cast< const Index* >( data + header.firstChildOffset );
+        v.childCount = reinterpret_cast< const Index* >( data + header.childCountOffset );
+        v.names = reinterpret_cast< const CompactString* >( data + header.namesOffset );
+        v.types = reinterpret_cast< const CompactString* >( data + header.typesOffset );
+        v.pool = data + header.poolOffset;
+        v.nodeCount = header.nodeCount;
+        v.rootCount = header.rootCount;
+        return v;
+    }
+
+    MappedFile m_file;
+    const CompactImageHeader* m_header = nullptr;
+    CompactView m_view;
+};
+
+#endif // COMPACTIMAGE_H
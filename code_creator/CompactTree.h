@@ -0,0 +1,427 @@
+#ifndef COMPACTTREE_H
+#define COMPACTTREE_H
+#include <cstdint>
+#include <string_view>
+#include "Generator.h"
+
+//Компактное дерево программы
+//Вместо отдельных объектов в куче (ClassUnit с вектором векторов shared_ptr, строки в каждом узле)
+//все узлы лежат в нескольких непрерывных массивах и ссылаются друг на друга номерами:
+// - вид узла, тип доступа в родителе, тип доступа класса и модификаторы упакованы в одно 32-битное слово;
+// - дети узла лежат подряд, поэтому у узла есть только номер первого ребёнка и их количество;
+// - все строки (имена, типы, текст вывода) хранятся в одном общем буфере.
+//Дети класса при построении упорядочиваются по типу доступа, поэтому группы доступа тоже идут подряд
+//Дерево строится через CompactTreeBuilder и после построения не меняется
+
+//Ссылка на строку в общем буфере
+struct CompactString
+{
+    uint32_t offset;
+    uint32_t size;
+};
+
+//Невладеющий взгляд на массивы компактного дерева
+//По нему идёт генерация кода; массивы могут принадлежать CompactTree или лежать в другой памяти
+struct CompactView
+{
+    using Index = uint32_t;
+    using Flags = Unit::Flags;
+    enum Kind { CLASS, METHOD, PRINT };
+    //Номер "нет узла" (у корней нет родителя)
+    static const Index NONE = ~0u;
+    //Тип доступа класса "как принято в языке по умолчанию" (см. ModelClass::DEFAULT_ACCESS)
+    static const Flags DEFAULT_ACCESS = 0xF;
+
+    //Раскладка слова узла: биты 0-7 - модификаторы (MethodUnit::Modifier или модификатор класса),
+    //8-11 - тип доступа узла в родительском классе, 12-15 - тип доступа самого класса, 16-17 - вид узла
+    static const uint32_t FLAGS_MASK = 0xFF;
+    static const uint32_t MEMBER_ACCESS_SHIFT = 8;
+    static const uint32_t CLASS_ACCESS_SHIFT = 12;
+    static const uint32_t KIND_SHIFT = 16;
+
+    static uint32_t pack( Kind kind, Flags memberAccess, Flags classAccess, Flags flags )
+    {
+        return ( static_cast< uint32_t >( kind ) << KIND_SHIFT ) | ( ( classAccess & 0xF ) << CLASS_ACCESS_SHIFT ) |
+               ( ( memberAccess & 0xF ) << MEMBER_ACCESS_SHIFT ) | ( flags & FLAGS_MASK );
+    }
+
+    const uint32_t* words = nullptr;
+    const Index* firstChild = nullptr;
+    const Index* childCount = nullptr;
+    //имя класса или метода, текст оператора вывода
+    const CompactString* names = nullptr;
+    //возвращаемый тип метода
+    const CompactString* types = nullptr;
+    const char* pool = nullptr;
+    Index nodeCount = 0;
+    //корни занимают номера [0, rootCount)
+    Index rootCount = 0;
+
+    Kind kind( Index node ) const
+    {
+        return static_cast< Kind >( ( words[ node ] >> KIND_SHIFT ) & 0x3 );
+    }
+    Flags flags( Index node ) const
+    {
+        return words[ node ] & FLAGS_MASK;
+    }
+    Flags memberAccess( Index node ) const
+    {
+        return ( words[ node ] >> MEMBER_ACCESS_SHIFT ) & 0xF;
+    }
+    //classAccess(...) - тип доступа класса или fallback, если он не задан
+    Flags classAccessOr( Index node, Flags fallback ) const
+    {
+        Flags access = ( words[ node ] >> CLASS_ACCESS_SHIFT ) & 0xF;
+        return access == DEFAULT_ACCESS ? fallback : access;
+    }
+    std::string_view name( Index node ) const
+    {
+        return string( names[ node ] );
+    }
+    std::string_view returnType( Index node ) const
+    {
+        return string( types[ node ] );
+    }
+    std::string_view text( Index node ) const
+    {
+        return string( names[ node ] );
+    }
+    std::string_view string( const CompactString& s ) const
+    {
+        return std::string_view( pool + s.offset, s.size );
+    }
+};
+
+//Компактное дерево, владеющее своими массивами
+class CompactTree
+{
+public:
+    using Index = CompactView::Index;
+
+    CompactView view() const
+    {
+        CompactView v;
+        v.words = m_words.data();
+        v.firstChild = m_firstChild.data();
+        v.childCount = m_childCount.data();
+        v.names = m_names.data();
+        v.types = m_types.data();
+        v.pool = m_pool.data();
+        v.nodeCount = static_cast< Index >( m_words.size() );
+        v.rootCount = m_rootCount;
+        return v;
+    }
+    Index size() const
+    {
+        return static_cast< Index >( m_words.size() );
+    }
+    Index rootCount() const
+    {
+        return m_rootCount;
+    }
+    //memoryUsage() - сколько байт занимают массивы дерева вместе со строками
+    size_t memoryUsage() const
+    {
+        return m_words.capacity() * sizeof( uint32_t ) + ( m_firstChild.capacity() + m_childCount.capacity() ) * sizeof( Index ) +
+               ( m_names.capacity() + m_types.capacity() ) * sizeof( CompactString ) + m_pool.capacity();
+    }
+
+private:
+    friend class CompactTreeBuilder;
+    std::vector< uint32_t > m_words;
+    std::vector< Index > m_firstChild;
+    std::vector< Index > m_childCount;
+    std::vector< CompactString > m_names;
+    std::vector< CompactString > m_types;
+    std::string m_pool;
+    Index m_rootCount = 0;
+};
+
+//Построитель компактного дерева
+//Узлы можно добавлять в любом порядке, указывая номер родителя; build() раскладывает их так,
+//чтобы дети каждого узла лежали подряд (обход в ширину)
+class CompactTreeBuilder
+{
+public:
+    using Index = CompactView::Index;
+    using Flags = Unit::Flags;
+    static const Index NONE = CompactView::NONE;
+
+    //addClass(...) - добавляет класс; parent == NONE - класс верхнего уровня
+    //memberAccess - тип доступа класса внутри родительского класса
+    Index addClass( Index parent, Flags memberAccess, std::string_view name, Flags access = CompactView::DEFAULT_ACCESS, Flags modifier = 0 )
+    {
+        if( access > CompactView::DEFAULT_ACCESS )
+        {
+            throw std::runtime_error( "There is no accessModifire for classes like this" );
+        }
+        return addNode( parent, CompactView::pack( CompactView::CLASS, checkMember( memberAccess ), access, modifier ), name, std::string_view() );
+    }
+    Index addClass( std::string_view name, Flags access = CompactView::DEFAULT_ACCESS, Flags modifier = 0 )
+    {
+        return addClass( NONE, 0, name, access, modifier );
+    }
+    //addMethod(...) - добавляет метод в класс parent с типом доступа memberAccess
+    Index addMethod( Index parent, Flags memberAccess, std::string_view name, std::string_view returnType, Flags flags )
+    {
+        return addNode( parent, CompactView::pack( CompactView::METHOD, checkMember( memberAccess ), 0, flags ), name, returnType );
+    }
+    //addPrint(...) - добавляет оператор вывода; в теле метода memberAccess не используется
+    Index addPrint( Index parent, std::string_view text, Flags memberAccess = 0 )
+    {
+        return addNode( parent, CompactView::pack( CompactView::PRINT, checkMember( memberAccess ), 0, 0 ), text, std::string_view() );
+    }
+    //addModel(...) - переносит в дерево узел модели (Model.h) со всеми детьми
+    Index addModel( Index parent, Flags memberAccess, const ModelNode& node )
+    {
+        switch( node.kind() )
+        {
+        case ModelNode::CLASS:
+        {
+            const auto& modelClass = static_cast< const ModelClass& >( node );
+            Flags access = modelClass.access() == ModelClass::DEFAULT_ACCESS ? CompactView::DEFAULT_ACCESS : modelClass.access();
+            Index index = addClass( parent, memberAccess, modelClass.name(), access, modelClass.modifier() );
+            const auto& fields = modelClass.fields();
+            for( size_t i = 0; i < fields.size(); ++i )
+            {
+                for( const auto& f : fields[ i ] )
+                {
+                    addModel( index, static_cast< Flags >( i ), *f );
+                }
+            }
+            return index;
+        }
+        case ModelNode::METHOD:
+        {
+            const auto& method = static_cast< const ModelMethod& >( node );
+            Index index = addMethod( parent, memberAccess, method.name(), method.returnType(), method.flags() );
+            for( const auto& b : method.body() )
+            {
+                addModel( index, 0, *b );
+            }
+            return index;
+        }
+        case ModelNode::PRINT:
+            return addPrint( parent, static_cast< const ModelPrint& >( node ).text(), memberAccess );
+        default:
+            throw std::runtime_error( "Unknown model node" );
+        }
+    }
+    Index addModel( const ModelNode& node )
+    {
+        return addModel( NONE, 0, node );
+    }
+
+    //build() - раскладывает узлы и возвращает готовое дерево; построитель после этого пуст
+    //Корни получают номера [0, rootCount) в порядке добавления
+    CompactTree build()
+    {
+        const Index count = static_cast< Index >( m_words.size() );
+        //Дети каждого узла в порядке добавления (счётная сортировка по родителю)
+        std::vector< Index > start( count + 1, 0 );
+        std::vector< Index > roots;
+        for( Index i = 0; i < count; ++i )
+        {
+            if( m_parents[ i ] == NONE )
+            {
+                roots.push_back( i );
+            }
+            else
+            {
+                ++start[ m_parents[ i ] + 1 ];
+            }
+        }
+        for( Index i = 0; i < count; ++i )
+        {
+            start[ i + 1 ] += start[ i ];
+        }
+        std::vector< Index > children( start[ count ] );
+        std::vector< Index > filled( start.begin(), start.end() - 1 );
+        for( Index i = 0; i < count; ++i )
+        {
+            if( m_parents[ i ] != NONE )
+            {
+                children[ filled[ m_parents[ i ] ]++ ] = i;
+            }
+        }
+        //У класса дети группируются по типу доступа с сохранением порядка внутри группы
+        for( Index i = 0; i < count; ++i )
+        {
+            if( ( ( m_words[ i ] >> CompactView::KIND_SHIFT ) & 0x3 ) == CompactView::CLASS )
+            {
+                std::stable_sort( children.begin() + start[ i ], children.begin() + start[ i + 1 ], [ this ]( Index a, Index b )
+                {
+                    return memberAccess( a ) < memberAccess( b );
+                } );
+            }
+        }
+        //Обход в ширину: order[ новый номер ] = старый номер
+        std::vector< Index > order( roots );
+        order.reserve( count );
+        CompactTree tree;
+        tree.m_rootCount = static_cast< Index >( roots.size() );
+        tree.m_words.resize( count );
+        tree.m_firstChild.resize( count );
+        tree.m_childCount.resize( count );
+        tree.m_names.resize( count );
+        tree.m_types.resize( count );
+        for( Index next = 0; next < order.size(); ++next )
+        {
+            Index old = order[ next ];
+            tree.m_words[ next ] = m_words[ old ];
+            tree.m_names[ next ] = m_names[ old ];
+            tree.m_types[ next ] = m_types[ old ];
+            tree.m_firstChild[ next ] = static_cast< Index >( order.size() );
+            tree.m_childCount[ next ] = start[ old + 1 ] - start[ old ];
+            order.insert( order.end(), children.begin() + start[ old ], children.begin() + start[ old + 1 ] );
+        }
+        tree.m_pool = std::move( m_pool );
+        tree.m_pool.shrink_to_fit();
+        *this = CompactTreeBuilder();
+        return tree;
+    }
+
+private:
+    static Flags checkMember( Flags memberAccess )
+    {
+        if( memberAccess >= ClassUnit::ACCESS_MODIFIERS.size() )
+        {
+            throw std::runtime_error( "There is no accessModifire like this" );
+        }
+        return memberAccess;
+    }
+    Flags memberAccess( Index node ) const
+    {
+        return ( m_words[ node ] >> CompactView::MEMBER_ACCESS_SHIFT ) & 0xF;
+    }
+    CompactString intern( std::string_view text )
+    {
+        if( m_pool.size() + text.size() > UINT32_MAX )
+        {
+            throw std::runtime_error( "Compact tree string pool is full" );
+        }
+        CompactString result{ static_cast< uint32_t >( m_pool.size() ), static_cast< uint32_t >( text.size() ) };
+        m_pool.append( text.data(), text.size() );
+        return result;
+    }
+    Index addNode( Index parent, uint32_t word, std::string_view name, std::string_view type )
+    {
+        if( parent != NONE )
+        {
+            if( parent >= m_words.size() )
+            {
+                throw std::runtime_error( "There is no parent node like this" );
+            }
+            if( ( ( m_words[ parent ] >> CompactView::KIND_SHIFT ) & 0x3 ) == CompactView::PRINT )
+            {
+                throw std::runtime_error( "Print operator can not have children" );
+            }
+        }
+        m_words.push_back( word );
+        m_parents.push_back( parent );
+        m_names.push_back( intern( name ) );
+        m_types.push_back( intern( type ) );
+        return static_cast< Index >( m_words.size() - 1 );
+    }
+
+    std::vector< uint32_t > m_words;
+    std::vector< Index > m_parents;
+    std::vector< CompactString > m_names;
+    std::vector< CompactString > m_types;
+    std::string m_pool;
+};
+
+//Генерация кода по компактному дереву
+//Как и Generator, язык (Traits) и приёмник (Out) выбираются на этапе компиляции;
+//используются те же правила синтаксиса, поэтому результат совпадает с compile() узлов Unit
+template< class Traits, class Out = StringWriter >
+class CompactGenerator
+{
+public:
+    using Index = CompactView::Index;
+
+    //emit(...) - генерирует код узла node в приёмник out
+    static void emit( Out& out, const CompactView& tree, Index node, unsigned int level = 0 )
+    {
+        switch( tree.kind( node ) )
+        {
+        case CompactView::CLASS:
+            emitClass( out, tree, node, level );
+            break;
+        case CompactView::METHOD:
+            Traits::checkMethod( tree.flags( node ) );
+            Traits::methodOpen( out, level, tree.name( node ), tree.returnType( node ), tree.flags( node ) );
+            emitChildren( out, tree, node, level + 1 );
+            Traits::methodClose( out, level );
+            break;
+        case CompactView::PRINT:
+            Traits::print( out, level, tree.text( node ) );
+            break;
+        default:
+            throw std::runtime_error( "Unknown compact tree node" );
+        }
+    }
+    //emitAll(...) - генерирует все корни дерева подряд
+    static void emitAll( Out& out, const CompactView& tree )
+    {
+        for( Index root = 0; root < tree.rootCount; ++root )
+        {
+            emit( out, tree, root );
+        }
+    }
+    //generate(...) - то же самое, но результат возвращается строкой
+    static std::string generate( const CompactView& tree, Index node, unsigned int level = 0 )
+    {
+        std::string result;
+        StringWriter out( result );
+        CompactGenerator< Traits, StringWriter >::emit( out, tree, node, level );
+        return result;
+    }
+
+private:
+    static void emitChildren( Out& out, const CompactView& tree, Index node, unsigned int level )
+    {
+        const Index end = tree.firstChild[ node ] + tree.childCount[ node ];
+        for( Index child = tree.firstChild[ node ]; child < end; ++child )
+        {
+            emit( out, tree, child, level );
+        }
+    }
+
+    static void emitClass( Out& out, const CompactView& tree, Index node, unsigned int level )
+    {
+        const Unit::Flags classAccess = tree.classAccessOr( node, Traits::DEFAULT_CLASS_ACCESS );
+        const Index begin = tree.firstChild[ node ];
+        const Index end = begin + tree.childCount[ node ];
+        //Проверяем класс до того, как что-либо записать
+        Traits::checkClass( classAccess, tree.flags( node ) );
+        for( Index child = begin; child < end; ++child )
+        {
+            Traits::checkAccess( tree.memberAccess( child ) );
+        }
+        Traits::classOpen( out, level, tree.name( node ), classAccess, tree.flags( node ) );
+        //Дети уже упорядочены по типу доступа: новая группа начинается там, где тип доступа меняется
+        for( Index child = begin; child < end; ++child )
+        {
+            const size_t access = tree.memberAccess( child );
+            if( child == begin || access != tree.memberAccess( child - 1 ) )
+            {
+                if( child != begin )
+                {
+                    Traits::sectionClose( out, level );
+                }
+                Traits::sectionOpen( out, level, access );
+            }
+            Traits::memberPrefix( out, level + 1, access );
+            emit( out, tree, child, level + 1 );
+        }
+        if( begin != end )
+        {
+            Traits::sectionClose( out, level );
+        }
+        Traits::classClose( out, level );
+    }
+};
+
+#endif // COMPACTTREE_H
@@ -0,0 +1,99 @@
+#ifndef CONCURRENTLIST_H
+#define CONCURRENTLIST_H
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+
+//Список, в который несколько потоков могут одновременно добавлять элементы без блокировок
+//Элементы лежат в кусках, размер которых удваивается: кусок k вмещает BASE << k элементов,
+//поэтому место элемента вычисляется по его номеру, а уже выделенные куски никогда не перемещаются
+//push(...) занимает номер атомарным счётчиком; кусок, которого ещё нет, выделяет первый пришедший поток,
+//а проигравший в compare_exchange свой кусок удаляет
+//Порядок элементов - порядок, в котором потоки получили номера: добавленное одним потоком идёт в порядке добавления
+//Читать список (size(), operator[]) можно только после того, как все добавляющие потоки закончили работу
+template< class T >
+class ConcurrentAppendList
+{
+public:
+    ConcurrentAppendList(): m_size( 0 )
+    {
+        for( auto& chunk : m_chunks )
+        {
+            chunk.store( nullptr, std::memory_order_relaxed );
+        }
+    }
+    ~ConcurrentAppendList()
+    {
+        for( auto& chunk : m_chunks )
+        {
+            delete[] chunk.load( std::memory_order_relaxed );
+        }
+    }
+    ConcurrentAppendList( const ConcurrentAppendList& ) = delete;
+    ConcurrentAppendList& operator=( const ConcurrentAppendList& ) = delete;
+
+    //push(...) - добавляет элемент; безопасна при вызове из нескольких потоков
+    void push( T value )
+    {
+        const size_t index = m_size.fetch_add( 1, std::memory_order_relaxed );
+        size_t chunk, offset;
+        locate( index, chunk, offset );
+        if( chunk >= CHUNK_COUNT )
+        {
+            throw std::length_error( "Concurrent append list is full" );
+        }
+        T* items = m_chunks[ chunk ].load( std::memory_order_acquire );
+        if( items == nullptr )
+        {
+            T* created = new T[ BASE << chunk ];
+            if( m_chunks[ chunk ].compare_exchange_strong( items, created, std::memory_order_acq_rel ) )
+            {
+                items = created;
+            }
+            else
+            {
+                delete[] created;
+            }
+        }
+        items[ offset ] = std::move( value );
+    }
+    size_t size() const
+    {
+        return m_size.load( std::memory_order_acquire );
+    }
+    const T& operator[]( size_t index ) const
+    {
+        size_t chunk, offset;
+        locate( index, chunk, offset );
+        return m_chunks[ chunk ].load( std::memory_order_acquire )[ offset ];
+    }
+    //clear() - удаляет все элементы; нельзя вызывать одновременно с push(...)
+    void clear()
+    {
+        for( auto& chunk : m_chunks )
+        {
+            delete[] chunk.exchange( nullptr, std::memory_order_relaxed );
+        }
+        m_size.store( 0, std::memory_order_release );
+    }
+
+private:
+    static const size_t BASE = 64;
+    //Куски 0..CHUNK_COUNT-1 вмещают BASE * ( 2^CHUNK_COUNT - 1 ) элементов
+    static const size_t CHUNK_COUNT = 40;
+
+    //locate(...) - кусок и место в нём для элемента с номером index
+    static void locate( size_t index, size_t& chunk, size_t& offset )
+    {
+        //Кусок k начинается с номера BASE * ( 2^k - 1 ), поэтому k - номер старшего бита index / BASE + 1
+        const size_t position = index / BASE + 1;
+        chunk = sizeof( unsigned long long ) * 8 - 1 - static_cast< size_t >( __builtin_clzll( position ) );
+        offset = index - BASE * ( ( size_t( 1 ) << chunk ) - 1 );
+    }
+
+    std::atomic< size_t > m_size;
+    std::atomic< T* > m_chunks[ CHUNK_COUNT ];
+};
+
+#endif // CONCURRENTLIST_H
@@ -0,0 +1,334 @@
+#ifndef DIFFWRITER_H
+#define DIFFWRITER_H
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <cstdint>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//Запись сгенерированных файлов только тогда, когда их содержимое изменилось
+//Файл, совпадающий с уже лежащим на диске, не переписывается: его время изменения остаётся прежним,
+//и сборка, которая зависит от этого файла, не запускается заново
+//Новое содержимое сравнивается:
+// - с записью в манифесте прошлого запуска (хеш, размер и время изменения), если файл на диске с тех пор не менялся;
+// - иначе с самим файлом на диске, побайтно.
+//Изменившиеся файлы пишутся во временный файл рядом и переименовываются поверх старого,
+//поэтому читатель никогда не увидит наполовину записанный файл
+//Манифест (хеш, размер, время изменения, производитель и имя каждого файла) сохраняется функцией commit() тем же способом
+//Производитель (owner) - кто отвечает за файл, например язык: в один каталог могут писать несколько запусков
+//с разными языками, и запуск удаляет устаревшие файлы только своих производителей (см. claim(...) и commit(...))
+//Объект не потокобезопасен
+class DiffWriter
+{
+public:
+    enum Status { UNCHANGED, WRITTEN };
+    static constexpr const char* MANIFEST = ".code_creator.manifest";
+
+    //directory - каталог для файлов (создаётся, если его нет); манифест прошлого запуска читается сразу
+    explicit DiffWriter( std::string directory ): m_directory( std::move( directory ) )
+    {
+        if( ::mkdir( m_directory.c_str(), 0755 ) != 0 && errno != EEXIST )
+        {
+            fail( "Can not create " + m_directory );
+        }
+        loadManifest();
+    }
+
+    //claim(...) - этот запуск отвечает за все файлы производителя owner, даже если не запишет ни одного
+    //write(...) объявляет своего производителя сам
+    void claim( const std::string& owner )
+    {
+        checkOwner( owner );
+        m_claimed.insert( owner );
+    }
+
+    //write(...) - записывает content в файл name внутри каталога, если содержимое изменилось
+    //owner - производитель файла (без пробелов); файлы без производителя относятся к производителю ""
+    Status write( const std::string& name, std::string_view content, const std::string& owner = std::string() )
+    {
+        checkName( name );
+        claim( owner );
+        Entry entry{ hash( content ), content.size(), 0, owner };
+        const std::string path = m_directory + "/" + name;
+        if( m_current.count( name ) != 0 )
+        {
+            throw std::runtime_error( "File " + name + " is written twice" );
+        }
+        if( sameAsBefore( name, path, entry, content ) )
+        {
+            m_current[ name ] = entry;
+            ++m_unchanged;
+            m_bytesSkipped += content.size();
+            return UNCHANGED;
+        }
+        writeAtomically( path, content );
+        entry.modified = modified( path );
+        m_current[ name ] = entry;
+        ++m_written;
+        m_bytesWritten += content.size();
+        return WRITTEN;
+    }
+
+    //commit(...) - сохраняет манифест этого запуска
+    //Записи прошлого манифеста о файлах чужих производителей переносятся в новый манифест без изменений
+    //removeStale - удалить файлы, которые в прошлом манифесте принадлежали производителям этого запуска,
+    //но в этот раз не записывались; файлы других производителей не трогаются
+    void commit( bool removeStale = false )
+    {
+        if( removeStale )
+        {
+            for( const auto& name : stale() )
+            {
+                std::remove( ( m_directory + "/" + name ).c_str() );
+            }
+        }
+        std::string text;
+        for( const auto& file : m_current )
+        {
+            appendManifestLine( text, file.first, file.second );
+        }
+        for( const auto& file : m_previous )
+        {
+            if( m_current.count( file.first ) == 0 && m_claimed.count( file.second.owner ) == 0 )
+            {
+                appendManifestLine( text, file.first, file.second );
+            }
+        }
+        writeAtomically( m_directory + "/" + MANIFEST, text );
+    }
+
+    //stale() - файлы прошлого запуска производителей этого запуска, которые в этот раз не записывались
+    std::vector< std::string > stale() const
+    {
+        std::vector< std::string > result;
+        for( const auto& file : m_previous )
+        {
+            if( m_current.count( file.first ) == 0 && m_claimed.count( file.second.owner ) != 0 )
+            {
+                result.push_back( file.first );
+            }
+        }
+        return result;
+    }
+
+    size_t written() const
+    {
+        return m_written;
+    }
+    size_t unchanged() const
+    {
+        return m_unchanged;
+    }
+    size_t bytesWritten() const
+    {
+        return m_bytesWritten;
+    }
+    size_t bytesSkipped() const
+    {
+        return m_bytesSkipped;
+    }
+
+    //hash(...) - 64-битный FNV-1a; не зависит от платформы, поэтому манифест переносим
+    static uint64_t hash( std::string_view content )
+    {
+        uint64_t result = 14695981039346656037ull;
+        for( unsigned char c : content )
+        {
+            result = ( result ^ c ) * 1099511628211ull;
+        }
+        return result;
+    }
+
+private:
+    struct Entry
+    {
+        uint64_t hash;
+        size_t size;
+        //время изменения файла в наносекундах
+        int64_t modified;
+        std::string owner;
+    };
+
+    //В манифесте производитель "" записывается как "-", чтобы поля строки не сливались
+    static constexpr const char* NO_OWNER = "-";
+
+    static void fail( const std::string& message )
+    {
+        throw std::runtime_error( message + ": " + std::strerror( errno ) );
+    }
+    //Имя файла не должно выводить за пределы каталога
+    static bool validName( const std::string& name )
+    {
+        return !name.empty() && name[ 0 ] != '.' && name.find( '/' ) == std::string::npos;
+    }
+    static void checkName( const std::string& name )
+    {
+        if( !validName( name ) )
+        {
+            throw std::runtime_error( "Bad output file name '" + name + "'" );
+        }
+    }
+    //Производитель - одно поле строки манифеста
+    static bool validOwner( const std::string& owner )
+    {
+        return owner != NO_OWNER && owner.find_first_of( " \t\r\n" ) == std::string::npos;
+    }
+    static void checkOwner( const std::string& owner )
+    {
+        if( !validOwner( owner ) )
+        {
+            throw std::runtime_error( "Bad output file owner '" + owner + "'" );
+        }
+    }
+
+    //Строка манифеста: хеш, размер, время изменения, производитель и имя
+    static void appendManifestLine( std::string& text, const std::string& name, const Entry& entry )
+    {
+        char line[ 96 ];
+        std::snprintf( line, sizeof( line ), "%016llx %llu %lld ", static_cast< unsigned long long >( entry.hash ),
+                       static_cast< unsigned long long >( entry.size ), static_cast< long long >( entry.modified ) );
+        text += line;
+        text += entry.owner.empty() ? NO_OWNER : entry.owner;
+        text += ' ';
+        text += name;
+        text += '\n';
+    }
+
+    void loadManifest()
+    {
+        std::ifstream in( m_directory + "/" + MANIFEST );
+        std::string line;
+        while( std::getline( in, line ) )
+        {
+            std::istringstream fields( line );
+            std::string hashText, owner, name;
+            size_t size;
+            long long modified;
+            if( !( fields >> hashText >> size >> modified >> owner ) || fields.get() != ' ' || !std::getline( fields, name ) || name.empty() )
+            {
+                //Повреждённый манифест просто не используется: файлы будут сравниваться с диском
+                m_previous.clear();
+                return;
+            }
+            //Имя из манифеста проверяется так же, как имя из write(...): иначе commit( true ) удалил бы файл вне каталога
+            if( !validName( name ) )
+            {
+                continue;
+            }
+            //Хеш разбирается без исключений: испорченный хеш, как и любая другая порча, отключает манифест
+            errno = 0;
+            char* end = nullptr;
+            const unsigned long long hash = std::strtoull( hashText.c_str(), &end, 16 );
+            if( hashText.find_first_not_of( "0123456789abcdefABCDEF" ) != std::string::npos || errno != 0 || *end != '\0' )
+            {
+                m_previous.clear();
+                return;
+            }
+            m_previous[ name ] = Entry{ hash, size, modified, owner == NO_OWNER ? std::string() : owner };
+        }
+    }
+
+    static int64_t modified( const struct stat& info )
+    {
+        return static_cast< int64_t >( info.st_mtim.tv_sec ) * 1000000000 + info.st_mtim.tv_nsec;
+    }
+    static int64_t modified( const std::string& path )
+    {
+        struct stat info;
+        return ::stat( path.c_str(), &info ) == 0 ? modified( info ) : 0;
+    }
+
+    //sameAsBefore(...) - совпадает ли content с файлом на диске; заполняет entry.modified временем изменения этого файла
+    bool sameAsBefore( const std::string& name, const std::string& path, Entry& entry, std::string_view content ) const
+    {
+        struct stat info;
+        if( ::stat( path.c_str(), &info ) != 0 || static_cast< size_t >( info.st_size ) != entry.size )
+        {
+            return false;
+        }
+        entry.modified = modified( info );
+        auto previous = m_previous.find( name );
+        //Файл не трогали после прошлого запуска: достаточно сравнить хеши, читать его не нужно
+        if( previous != m_previous.end() && previous->second.modified == entry.modified && previous->second.size == entry.size )
+        {
+            return previous->second.hash == entry.hash;
+        }
+        return sameAsFile( path, content );
+    }
+    static bool sameAsFile( const std::string& path, std::string_view content )
+    {
+        std::ifstream in( path, std::ios::binary );
+        char buffer[ 64 * 1024 ];
+        size_t pos = 0;
+        while( in )
+        {
+            in.read( buffer, sizeof( buffer ) );
+            const size_t count = static_cast< size_t >( in.gcount() );
+            if( count > content.size() - pos || std::memcmp( buffer, content.data() + pos, count ) != 0 )
+            {
+                return false;
+            }
+            pos += count;
+        }
+        return pos == content.size();
+    }
+
+    //writeAtomically(...) - пишет во временный файл и переименовывает его в path
+    static void writeAtomically( const std::string& path, std::string_view content )
+    {
+        const std::string temporary = path + ".tmp" + std::to_string( ::getpid() );
+        int fd = ::open( temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        if( fd < 0 )
+        {
+            fail( "Can not create " + temporary );
+        }
+        size_t done = 0;
+        while( done < content.size() )
+        {
+            ssize_t result = ::write( fd, content.data() + done, content.size() - done );
+            if( result < 0 && errno == EINTR )
+            {
+                continue;
+            }
+            if( result <= 0 )
+            {
+                const int error = errno;
+                ::close( fd );
+                ::unlink( temporary.c_str() );
+                errno = error;
+                fail( "Can not write " + temporary );
+            }
+            done += static_cast< size_t >( result );
+        }
+        if( ::close( fd ) != 0 || ::rename( temporary.c_str(), path.c_str() ) != 0 )
+        {
+            const int error = errno;
+            ::unlink( temporary.c_str() );
+            errno = error;
+            fail( "Can not replace " + path );
+        }
+    }
+
+    std::string m_directory;
+    std::unordered_map< std::string, Entry > m_previous;
+    std::unordered_map< std::string, Entry > m_current;
+    //производители этого запуска
+    std::unordered_set< std::string > m_claimed;
+    size_t m_written = 0;
+    size_t m_unchanged = 0;
+    size_t m_bytesWritten = 0;
+    size_t m_bytesSkipped = 0;
+};
+
+#endif // DIFFWRITER_H
@@ -0,0 +1,304 @@
+#ifndef ESCAPE_H
+#define ESCAPE_H
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+#if defined( __SSE2__ ) && defined( __GNUC__ )
+#include <immintrin.h>
+#define ESCAPE_SIMD 1
+#endif
+
+//Экранирование текста оператора вывода в строковый литерал конкретного языка
+//Текст считается последовательностью байт в UTF-8:
+// - C++: кавычка, обратная косая черта и управляющие символы экранируются, '%' удваивается (текст - формат printf),
+//   все байты вне ASCII записываются как \xNN; если после \xNN идёт шестнадцатеричная цифра, литерал разрывается ("")
+// - C#: символы вне ASCII записываются как \uNNNN (за пределами BMP - суррогатной парой)
+// - Java: то же, что C#, но управляющие символы без короткой записи пишутся восьмеричными \NNN,
+//   потому что \uNNNN в Java заменяется ещё до разбора литерала и \u000a сломал бы строку
+//Некорректные последовательности UTF-8 в C# и Java записываются побайтно как \u00NN
+//Поиск символов, которые нужно экранировать, идёт блоками по 16 (SSE2) или 32 (AVX2) байта,
+//а участки без таких символов копируются в приёмник целиком
+class Escape
+{
+public:
+    //cpp(...), csharp(...), java(...) - дописывают в приёмник out экранированный текст (без кавычек)
+    //Out - любой приёмник с функцией write(data, size)
+    template< class Out >
+    static void cpp( Out& out, std::string_view text )
+    {
+        const char* data = text.data();
+        const size_t size = text.size();
+        size_t pos = 0;
+        //только что записан \xNN: следующая шестнадцатеричная цифра продолжила бы его
+        bool afterHex = false;
+        while( pos < size )
+        {
+            size_t clean = pos + scan( data + pos, size - pos, '%' );
+            if( clean > pos )
+            {
+                if( afterHex && isHexDigit( data[ pos ] ) )
+                {
+                    out.write( "\"\"", 2 );
+                }
+                out.write( data + pos, clean - pos );
+                afterHex = false;
+                pos = clean;
+                if( pos == size )
+                {
+                    break;
+                }
+            }
+            const unsigned char symbol = static_cast< unsigned char >( data[ pos++ ] );
+            afterHex = false;
+            if( !writeShort( out, symbol ) )
+            {
+                if( symbol == '%' )
+                {
+                    out.write( "%%", 2 );
+                }
+                else
+                {
+                    char escaped[ 4 ] = { '\\', 'x', HEX[ symbol >> 4 ], HEX[ symbol & 0xF ] };
+                    out.write( escaped, 4 );
+                    afterHex = true;
+                }
+            }
+        }
+    }
+    template< class Out >
+    static void csharp( Out& out, std::string_view text )
+    {
+        unicode( out, text, false );
+    }
+    template< class Out >
+    static void java( Out& out, std::string_view text )
+    {
+        unicode( out, text, true );
+    }
+
+    //scan(...) - номер первого байта, который нужно экранировать (или size, если таких нет)
+    //Такими считаются управляющие символы, байты вне ASCII, кавычка, обратная косая черта и extra
+    static size_t scan( const char* data, size_t size, char extra )
+    {
+#ifdef ESCAPE_SIMD
+        static const bool avx2 = __builtin_cpu_supports( "avx2" );
+        return avx2 ? scanAvx2( data, size, extra ) : scanSse2( data, size, extra );
+#else
+        return scanScalar( data, size, extra );
+#endif
+    }
+
+private:
+    static constexpr const char* HEX = "0123456789ABCDEF";
+
+    static bool isHexDigit( char symbol )
+    {
+        return ( symbol >= '0' && symbol <= '9' ) || ( symbol >= 'a' && symbol <= 'f' ) || ( symbol >= 'A' && symbol <= 'F' );
+    }
+    static bool special( unsigned char symbol, char extra )
+    {
+        return symbol < 0x20 || symbol >= 0x80 || symbol == '"' || symbol == '\\' || symbol == static_cast< unsigned char >( extra );
+    }
+    static size_t scanScalar( const char* data, size_t size, char extra )
+    {
+        for( size_t i = 0; i < size; ++i )
+        {
+            if( special( static_cast< unsigned char >( data[ i ] ), extra ) )
+            {
+                return i;
+            }
+        }
+        return size;
+    }
+#ifdef ESCAPE_SIMD
+    //Байты сравниваются как знаковые, поэтому "меньше 0x20" ловит сразу и управляющие символы, и байты вне ASCII
+    static size_t scanSse2( const char* data, size_t size, char extra )
+    {
+        const __m128i limit = _mm_set1_epi8( 0x20 );
+        const __m128i quote = _mm_set1_epi8( '"' );
+        const __m128i backslash = _mm_set1_epi8( '\\' );
+        const __m128i other = _mm_set1_epi8( extra );
+        size_t i = 0;
+        for( ; i + 16 <= size; i += 16 )
+        {
+            const __m128i block = _mm_loadu_si128( reinterpret_cast< const __m128i* >( data + i ) );
+            const __m128i found = _mm_or_si128( _mm_or_si128( _mm_cmplt_epi8( block, limit ), _mm_cmpeq_epi8( block, quote ) ),
+                                                _mm_or_si128( _mm_cmpeq_epi8( block, backslash ), _mm_cmpeq_epi8( block, other ) ) );
+            const unsigned int mask = static_cast< unsigned int >( _mm_movemask_epi8( found ) );
+            if( mask != 0 )
+            {
+                return i + static_cast< size_t >( __builtin_ctz( mask ) );
+            }
+        }
+        return i + scanScalar( data + i, size - i, extra );
+    }
+    __attribute__(( target( "avx2" ) ))
+    static size_t scanAvx2( const char* data, size_t size, char extra )
+    {
+        const __m256i limit = _mm256_set1_epi8( 0x20 );
+        const __m256i quote = _mm256_set1_epi8( '"' );
+        const __m256i backslash = _mm256_set1_epi8( '\\' );
+        const __m256i other = _mm256_set1_epi8( extra );
+        size_t i = 0;
+        for( ; i + 32 <= size; i += 32 )
+        {
+            const __m256i block = _mm256_loadu_si256( reinterpret_cast< const __m256i* >( data + i ) );
+            const __m256i found = _mm256_or_si256( _mm256_or_si256( _mm256_cmpgt_epi8( limit, block ), _mm256_cmpeq_epi8( block, quote ) ),
+                                                   _mm256_or_si256( _mm256_cmpeq_epi8( block, backslash ), _mm256_cmpeq_epi8( block, other ) ) );
+            const unsigned int mask = static_cast< unsigned int >( _mm256_movemask_epi8( found ) );
+            if( mask != 0 )
+            {
+                return i + static_cast< size_t >( __builtin_ctz( mask ) );
+            }
+        }
+        return i + scanSse2( data + i, size - i, extra );
+    }
+#endif
+
+    //writeShort(...) - короткие escape-последовательности, общие для всех трёх языков
+    template< class Out >
+    static bool writeShort( Out& out, unsigned char symbol )
+    {
+        switch( symbol )
+        {
+        case '"':
+            out.write( "\\\"", 2 );
+            return true;
+        case '\\':
+            out.write( "\\\\", 2 );
+            return true;
+        case '\n':
+            out.write( "\\n", 2 );
+            return true;
+        case '\r':
+            out.write( "\\r", 2 );
+            return true;
+        case '\t':
+            out.write( "\\t", 2 );
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template< class Out >
+    static void writeUnicode( Out& out, uint32_t code )
+    {
+        char escaped[ 6 ] = { '\\', 'u', HEX[ ( code >> 12 ) & 0xF ], HEX[ ( code >> 8 ) & 0xF ], HEX[ ( code >> 4 ) & 0xF ], HEX[ code & 0xF ] };
+        out.write( escaped, 6 );
+    }
+
+    //decode(...) - разбирает символ UTF-8, начинающийся с data[ 0 ]; возвращает его длину или 0, если последовательность некорректна
+    static size_t decode( const unsigned char* data, size_t size, uint32_t& code )
+    {
+        const unsigned char lead = data[ 0 ];
+        size_t length;
+        uint32_t minimum;
+        if( lead >= 0xC2 && lead <= 0xDF )
+        {
+            length = 2;
+            code = lead & 0x1F;
+            minimum = 0x80;
+        }
+        else if( lead >= 0xE0 && lead <= 0xEF )
+        {
+            length = 3;
+            code = lead & 0x0F;
+            minimum = 0x800;
+        }
+        else if( lead >= 0xF0 && lead <= 0xF4 )
+        {
+            length = 4;
+            code = lead & 0x07;
+            minimum = 0x10000;
+        }
+        else
+        {
+            return 0;
+        }
+        if( length > size )
+        {
+            return 0;
+        }
+        for( size_t i = 1; i < length; ++i )
+        {
+            if( ( data[ i ] & 0xC0 ) != 0x80 )
+            {
+                return 0;
+            }
+            code = ( code << 6 ) | ( data[ i ] & 0x3F );
+        }
+        //Слишком длинная запись, суррогаты и значения за пределами Unicode недопустимы
+        if( code < minimum || ( code >= 0xD800 && code <= 0xDFFF ) || code > 0x10FFFF )
+        {
+            return 0;
+        }
+        return length;
+    }
+
+    template< class Out >
+    static void unicode( Out& out, std::string_view text, bool java )
+    {
+        const char* data = text.data();
+        const size_t size = text.size();
+        size_t pos = 0;
+        while( pos < size )
+        {
+            size_t clean = pos + scan( data + pos, size - pos, '"' );
+            if( clean > pos )
+            {
+                out.write( data + pos, clean - pos );
+                pos = clean;
+                if( pos == size )
+                {
+                    break;
+                }
+            }
+            const unsigned char symbol = static_cast< unsigned char >( data[ pos ] );
+            if( writeShort( out, symbol ) )
+            {
+                ++pos;
+            }
+            else if( symbol < 0x20 )
+            {
+                if( java )
+                {
+                    char escaped[ 4 ] = { '\\', static_cast< char >( '0' + ( symbol >> 6 ) ), static_cast< char >( '0' + ( ( symbol >> 3 ) & 7 ) ),
+                                          static_cast< char >( '0' + ( symbol & 7 ) ) };
+                    out.write( escaped, 4 );
+                }
+                else
+                {
+                    writeUnicode( out, symbol );
+                }
+                ++pos;
+            }
+            else
+            {
+                uint32_t code = 0;
+                size_t length = decode( reinterpret_cast< const unsigned char* >( data + pos ), size - pos, code );
+                if( length == 0 )
+                {
+                    writeUnicode( out, symbol );
+                    ++pos;
+                }
+                else
+                {
+                    if( code > 0xFFFF )
+                    {
+                        code -= 0x10000;
+                        writeUnicode( out, 0xD800 + ( code >> 10 ) );
+                        writeUnicode( out, 0xDC00 + ( code & 0x3FF ) );
+                    }
+                    else
+                    {
+                        writeUnicode( out, code );
+                    }
+                    pos += length;
+                }
+            }
+        }
+    }
+};
+
+#endif // ESCAPE_H
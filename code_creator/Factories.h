@@ -4,34 +4,72 @@
 #include "Pluses.h"
 #include "CSharp.h"
 #include "Java.h"
+#include "UnitArena.h"
 
 //Абстрактная фабрика
 //Она создаёт абстрактные "продукты" с типами ClassUnit, MethodUnit, PrintOperatorUnit,
 //чтобы в дальнейшем создать "конкретные продукты" для каждого из трёх предсталенных в программе языков программирования
+//Если фабрике передана арена, все продукты размещаются в ней: фабрика отдаёт невладеющие shared_ptr,
+//а память освобождается вместе с ареной. Без арены продукты, как и раньше, владеют собой сами
 class AbstractFactory {
 public:
-    virtual std::shared_ptr<ClassUnit> ClassCreator(const std::string& name, Unit::Flags accessFlags = 0, Unit::Flags modificatorFlags = 0) const = 0;
-    virtual std::shared_ptr<MethodUnit> MethodCreator(const std::string& name, const std::string& returnType, Unit::Flags flags) const = 0;
-    virtual std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(const std::string& text) const = 0;
+    explicit AbstractFactory( UnitArena* arena = nullptr ): m_arena( arena ) {}
+    //Имена и типы принимаются как std::string_view: они всё равно попадают в таблицу символов, и строку для них создавать не нужно
+    //Текст оператора вывода принимается по значению: переданная через std::move(...) строка перемещается прямо в узел
+    virtual std::shared_ptr<ClassUnit> ClassCreator(std::string_view name, Unit::Flags accessFlags = 0, Unit::Flags modificatorFlags = 0) const = 0;
+    virtual std::shared_ptr<MethodUnit> MethodCreator(std::string_view name, std::string_view returnType, Unit::Flags flags) const = 0;
+    virtual std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(std::string text) const = 0;
+    //finishMethod(...) - вызывается, когда тело метода, созданного MethodCreator(...), собрано целиком;
+    //возвращает узел, который нужно вложить в родителя. Обычная фабрика возвращает сам метод,
+    //а InterningFactory (Interning.h) - общий узел для одинаковых методов
+    virtual std::shared_ptr<MethodUnit> finishMethod(std::shared_ptr<MethodUnit> method) const
+    {
+        return method;
+    }
+    //arena() - арена, в которой фабрика размещает продукты (nullptr, если продукты владеют собой сами)
+    UnitArena* arena() const
+    {
+        return m_arena;
+    }
     //Виртуальный деструктор
     virtual ~AbstractFactory() = default;
+protected:
+    //make(...) - создаёт продукт в арене, если она есть, иначе - в куче одним выделением памяти
+    template< class T, class... Args >
+    std::shared_ptr< T > make( Args&&... args ) const
+    {
+        INSTRUMENT_SCOPE( T::Syntax::LANGUAGE_INDEX, nodeKind< T >(), Instrumentation::CREATE, nullptr );
+        return makeUnit< T >( m_arena, std::forward< Args >( args )... );
+    }
+private:
+    //Вид продукта для счётчиков Instrumentation
+    template< class T >
+    static constexpr Instrumentation::NodeKind nodeKind()
+    {
+        return std::is_base_of< ClassUnit, T >::value ? Instrumentation::CLASS_NODE
+             : std::is_base_of< MethodUnit, T >::value ? Instrumentation::METHOD_NODE : Instrumentation::PRINT_NODE;
+    }
+    //арена, в которой размещаются продукты (может отсутствовать)
+    UnitArena* m_arena;
 };
 
 //Конкретная фабрика для C++
 class PlussesFactory: public AbstractFactory
 {
 public:
-    std::shared_ptr<ClassUnit> ClassCreator(const std::string& name, Unit::Flags, Unit::Flags) const override
+    PlussesFactory() = default;
+    explicit PlussesFactory( UnitArena& arena ): AbstractFactory( &arena ) {}
+    std::shared_ptr<ClassUnit> ClassCreator(std::string_view name, Unit::Flags, Unit::Flags) const override
     {
-        return shared_ptr<ClassUnit>(new PlussesClassUnit(name));
+        return make<PlussesClassUnit>(name);
     }
-    std::shared_ptr<MethodUnit> MethodCreator(const std::string& name, const std::string& returnType, Unit::Flags flags) const override
+    std::shared_ptr<MethodUnit> MethodCreator(std::string_view name, std::string_view returnType, Unit::Flags flags) const override
     {
-        return shared_ptr<MethodUnit>(new PlussesMethodUnit(name, returnType, flags));
+        return make<PlussesMethodUnit>(name, returnType, flags);
     }
-    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(const std::string& text) const override
+    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(std::string text) const override
     {
-        return shared_ptr<PrintOperatorUnit>(new PlussesPrintOperatorUnit(text));
+        return make<PlussesPrintOperatorUnit>(std::move(text));
     }
     //Деструктор
     ~PlussesFactory() = default;
@@ -41,17 +79,19 @@ public:
 class CSharpFactory: public AbstractFactory
 {
 public:
-    std::shared_ptr<ClassUnit> ClassCreator(const std::string& name, Unit::Flags, Unit::Flags) const override
+    CSharpFactory() = default;
+    explicit CSharpFactory( UnitArena& arena ): AbstractFactory( &arena ) {}
+    std::shared_ptr<ClassUnit> ClassCreator(std::string_view name, Unit::Flags, Unit::Flags) const override
     {
-        return shared_ptr<ClassUnit>(new CSharpClassUnit(name));
+        return make<CSharpClassUnit>(name);
     }
-    std::shared_ptr<MethodUnit> MethodCreator(const std::string& name, const std::string& returnType, Unit::Flags flags) const override
+    std::shared_ptr<MethodUnit> MethodCreator(std::string_view name, std::string_view returnType, Unit::Flags flags) const override
     {
-        return shared_ptr<MethodUnit>(new CSharpMethodUnit(name, returnType, flags));
+        return make<CSharpMethodUnit>(name, returnType, flags);
     }
-    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(const std::string& text) const override
+    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(std::string text) const override
     {
-        return shared_ptr<PrintOperatorUnit>(new CSharpPrintOperatorUnit(text));
+        return make<CSharpPrintOperatorUnit>(std::move(text));
     }
     //Деструктор
     ~CSharpFactory() = default;
@@ -61,17 +101,19 @@ public:
 class JavaFactory: public AbstractFactory
 {
 public:
-    std::shared_ptr<ClassUnit> ClassCreator(const std::string& name, Unit::Flags classAccess = ClassUnit::PUBLIC, Unit::Flags classModifier = 0) const override
+    JavaFactory() = default;
+    explicit JavaFactory( UnitArena& arena ): AbstractFactory( &arena ) {}
+    std::shared_ptr<ClassUnit> ClassCreator(std::string_view name, Unit::Flags classAccess = ClassUnit::PUBLIC, Unit::Flags classModifier = 0) const override
     {
-        return shared_ptr<ClassUnit>(new JavaClassUnit(name, classAccess, classModifier));
+        return make<JavaClassUnit>(name, classAccess, classModifier);
     }
-    std::shared_ptr<MethodUnit> MethodCreator(const std::string& name, const std::string& returnType, Unit::Flags flags) const override
+    std::shared_ptr<MethodUnit> MethodCreator(std::string_view name, std::string_view returnType, Unit::Flags flags) const override
     {
-        return shared_ptr<MethodUnit>(new JavaMethodUnit(name, returnType, flags));
+        return make<JavaMethodUnit>(name, returnType, flags);
     }
-    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(const std::string& text) const override
+    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(std::string text) const override
     {
-        return shared_ptr<PrintOperatorUnit>(new JavaPrintOperatorUnit(text));
+        return make<JavaPrintOperatorUnit>(std::move(text));
     }
     //Деструктор
     ~JavaFactory() = default;
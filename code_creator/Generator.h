@@ -0,0 +1,129 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+#include "Model.h"
+#include "Pluses.h"
+#include "CSharp.h"
+#include "Java.h"
+
+//Генератор, в котором язык выбирается на этапе компиляции
+//Traits - правила синтаксиса языка (ключевые слова, модификаторы, оператор вывода),
+//Out - тип приёмника. Ни узлы модели, ни правила языка, ни приёмник не вызываются через виртуальные функции,
+//поэтому компилятор может подставить весь путь генерации в одно место
+//Для выбора языка во время работы программы остаются фабрики (Factories.h) и Backend (Backends.h)
+template< class Traits, class Out = StringWriter >
+class Generator
+{
+public:
+    //emit(...) - генерирует код узла модели в приёмник out
+    //Всё поддерево проверяется до первой записи, поэтому при ошибке в out ничего не попадает
+    static void emit( Out& out, const ModelNode& node, unsigned int level = 0 )
+    {
+        check( node );
+        write( out, node, level );
+    }
+
+    //generate(...) - то же самое, но результат возвращается строкой
+    static std::string generate( const ModelNode& node, unsigned int level = 0 )
+    {
+        std::string result;
+        StringWriter out( result );
+        Generator< Traits, StringWriter >::emit( out, node, level );
+        return result;
+    }
+
+private:
+    //check(...) - проверяет узел и всех его потомков по правилам языка, ничего не записывая
+    static void check( const ModelNode& node )
+    {
+        switch( node.kind() )
+        {
+        case ModelNode::CLASS:
+        {
+            const ModelClass& modelClass = static_cast< const ModelClass& >( node );
+            const auto& fields = modelClass.fields();
+            Traits::checkClass( modelClass.accessOr( Traits::DEFAULT_CLASS_ACCESS ), modelClass.modifier() );
+            for( size_t i = 0; i < fields.size(); ++i )
+            {
+                if( !fields[ i ].empty() )
+                {
+                    Traits::checkAccess( static_cast< Unit::Flags >( i ) );
+                }
+                for( const auto& f : fields[ i ] )
+                {
+                    check( *f );
+                }
+            }
+            break;
+        }
+        case ModelNode::METHOD:
+        {
+            const ModelMethod& method = static_cast< const ModelMethod& >( node );
+            Traits::checkMethod( method.flags() );
+            for( const auto& b : method.body() )
+            {
+                check( *b );
+            }
+            break;
+        }
+        case ModelNode::PRINT:
+            break;
+        default:
+            throw std::runtime_error( "Unknown model node" );
+        }
+    }
+
+    //write(...) - генерирует код уже проверенного узла
+    static void write( Out& out, const ModelNode& node, unsigned int level )
+    {
+        switch( node.kind() )
+        {
+        case ModelNode::CLASS:
+            writeClass( out, static_cast< const ModelClass& >( node ), level );
+            break;
+        case ModelNode::METHOD:
+            writeMethod( out, static_cast< const ModelMethod& >( node ), level );
+            break;
+        default:
+            Traits::print( out, level, static_cast< const ModelPrint& >( node ).text() );
+            break;
+        }
+    }
+
+    static void writeClass( Out& out, const ModelClass& modelClass, unsigned int level )
+    {
+        const auto& fields = modelClass.fields();
+        Traits::classOpen( out, level, modelClass.name(), modelClass.accessOr( Traits::DEFAULT_CLASS_ACCESS ), modelClass.modifier() );
+        for( size_t i = 0; i < fields.size(); ++i )
+        {
+            if( fields[ i ].empty() )
+            {
+                continue;
+            }
+            Traits::sectionOpen( out, level, i );
+            for( const auto& f : fields[ i ] )
+            {
+                Traits::memberPrefix( out, level + 1, i );
+                write( out, *f, level + 1 );
+            }
+            Traits::sectionClose( out, level );
+        }
+        Traits::classClose( out, level );
+    }
+
+    static void writeMethod( Out& out, const ModelMethod& method, unsigned int level )
+    {
+        Traits::methodOpen( out, level, method.name(), method.returnType(), method.flags() );
+        for( const auto& b : method.body() )
+        {
+            write( out, *b, level + 1 );
+        }
+        Traits::methodClose( out, level );
+    }
+};
+
+//Правила языков в роли параметров Generator
+using CppTraits = PlussesSyntax;
+using CSharpTraits = CSharpSyntax;
+using JavaTraits = JavaSyntax;
+
+#endif // GENERATOR_H
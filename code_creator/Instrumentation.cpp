@@ -0,0 +1,26 @@
+#include <cstdlib>
+#include <new>
+#include "Instrumentation.h"
+
+//Замещённые операторы выделения памяти для сборки со счётчиками (CONFIG+=instrumentation)
+//Каждое выделение учитывается в счётчике текущего потока Instrumentation::threadAllocations()
+
+void* operator new( std::size_t size )
+{
+    ++Instrumentation::threadAllocations();
+    if( void* memory = std::malloc( size ? size : 1 ) )
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete( void* memory ) noexcept
+{
+    std::free( memory );
+}
+
+void operator delete( void* memory, std::size_t ) noexcept
+{
+    std::free( memory );
+}
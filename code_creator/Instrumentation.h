@@ -0,0 +1,263 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <string>
+#include <ostream>
+#include <sstream>
+#include "Sink.h"
+
+//Встроенные счётчики горячих мест генератора
+//Для каждого языка, вида узла и операции (генерация, создание фабрикой, добавление) собираются:
+//число вызовов, суммарное время (вместе с вложенными узлами), записанные байты и выделения памяти
+//Счётчики компилируются, только если задан макрос CODE_CREATOR_INSTRUMENTATION
+//(qmake CONFIG+=instrumentation); без него INSTRUMENT_SCOPE(...) раскрывается в пустоту и ничего не стоит
+//Во время работы сбор включается функцией setEnabled(true); каждый поток пишет в свои счётчики
+class Instrumentation
+{
+public:
+    enum Operation { COMPILE, CREATE, ADD, OPERATION_COUNT };
+    enum NodeKind { CLASS_NODE, METHOD_NODE, PRINT_NODE, NODE_KIND_COUNT };
+    //Языки нумеруются так же, как LANGUAGE_INDEX в правилах синтаксиса
+    static const size_t LANGUAGE_COUNT = 3;
+
+    //Итоговые значения одного счётчика по всем потокам
+    struct Totals
+    {
+        unsigned long long calls = 0;
+        unsigned long long nanoseconds = 0;
+        unsigned long long bytes = 0;
+        unsigned long long allocations = 0;
+    };
+
+    //compiledIn() - собраны ли счётчики в эту программу
+    static bool compiledIn()
+    {
+#ifdef CODE_CREATOR_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+    static void setEnabled( bool enabled )
+    {
+        enabledFlag().store( enabled && compiledIn() );
+    }
+    static bool enabled()
+    {
+        return enabledFlag().load( std::memory_order_relaxed );
+    }
+
+    //Счётчик выделений памяти текущего потока; увеличивается operator new из Instrumentation.cpp
+    static unsigned long long& threadAllocations()
+    {
+        static thread_local unsigned long long allocations = 0;
+        return allocations;
+    }
+
+    //total(...) - сумма счётчика по всем потокам
+    static Totals total( size_t language, NodeKind kind, Operation operation )
+    {
+        Totals result;
+        Registry& r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        for( const auto& block : r.blocks )
+        {
+            const Counter& c = block->counters[ language ][ kind ][ operation ];
+            result.calls += c.calls.load( std::memory_order_relaxed );
+            result.nanoseconds += c.nanoseconds.load( std::memory_order_relaxed );
+            result.bytes += c.bytes.load( std::memory_order_relaxed );
+            result.allocations += c.allocations.load( std::memory_order_relaxed );
+        }
+        return result;
+    }
+
+    //reset() - обнуляет все счётчики
+    static void reset()
+    {
+        Registry& r = registry();
+        std::lock_guard< std::mutex > lock( r.mutex );
+        for( const auto& block : r.blocks )
+        {
+            for( auto& language : block->counters )
+            {
+                for( auto& kind : language )
+                {
+                    for( auto& c : kind )
+                    {
+                        c.calls.store( 0 );
+                        c.nanoseconds.store( 0 );
+                        c.bytes.store( 0 );
+                        c.allocations.store( 0 );
+                    }
+                }
+            }
+        }
+    }
+
+    //report(...) - отчёт в виде таблицы; строки с нулевым числом вызовов пропускаются
+    static void report( std::ostream& out )
+    {
+        out << "language\tnode\toperation\tcalls\ttime_ms\tbytes\tallocations\n";
+        forEachTotal( [ &out ]( size_t language, NodeKind kind, Operation operation, const Totals& t )
+        {
+            out << LANGUAGE_NAMES()[ language ] << '\t' << KIND_NAMES()[ kind ] << '\t' << OPERATION_NAMES()[ operation ] << '\t'
+                << t.calls << '\t' << t.nanoseconds / 1e6 << '\t' << t.bytes << '\t' << t.allocations << '\n';
+        } );
+    }
+
+    //json() - тот же отчёт в формате JSON
+    static std::string json()
+    {
+        std::ostringstream out;
+        out << "{\"compiled_in\": " << ( compiledIn() ? "true" : "false" ) << ", \"counters\": [";
+        bool first = true;
+        forEachTotal( [ &out, &first ]( size_t language, NodeKind kind, Operation operation, const Totals& t )
+        {
+            out << ( first ? "" : ", " ) << "{\"language\": \"" << LANGUAGE_NAMES()[ language ] << "\", \"node\": \"" << KIND_NAMES()[ kind ]
+                << "\", \"operation\": \"" << OPERATION_NAMES()[ operation ] << "\", \"calls\": " << t.calls
+                << ", \"nanoseconds\": " << t.nanoseconds << ", \"bytes\": " << t.bytes << ", \"allocations\": " << t.allocations << "}";
+            first = false;
+        } );
+        out << "]}";
+        return out.str();
+    }
+
+private:
+    struct Counter
+    {
+        std::atomic< unsigned long long > calls{ 0 };
+        std::atomic< unsigned long long > nanoseconds{ 0 };
+        std::atomic< unsigned long long > bytes{ 0 };
+        std::atomic< unsigned long long > allocations{ 0 };
+    };
+    //Счётчики одного потока; пишет в них только этот поток, поэтому атомарные операции не конкурируют
+    struct ThreadBlock
+    {
+        Counter counters[ LANGUAGE_COUNT ][ NODE_KIND_COUNT ][ OPERATION_COUNT ];
+    };
+    //Все блоки потоков; блоки живут до конца программы, чтобы данные завершившихся потоков не терялись
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector< std::shared_ptr< ThreadBlock > > blocks;
+    };
+
+public:
+    //Замер одной области кода: от создания объекта до его разрушения
+    //Если сбор выключен, объект ничего не делает
+    class Probe
+    {
+    public:
+        Probe( size_t language, NodeKind kind, Operation operation, const Sink* sink ): m_active( enabled() )
+        {
+            if( !m_active )
+            {
+                return;
+            }
+            m_counter = &threadBlock().counters[ language ][ kind ][ operation ];
+            m_sink = sink;
+            m_bytes = sink != nullptr ? sink->written() : 0;
+            m_allocations = threadAllocations();
+            m_start = std::chrono::steady_clock::now();
+        }
+        ~Probe()
+        {
+            if( !m_active )
+            {
+                return;
+            }
+            auto nanoseconds = std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - m_start ).count();
+            m_counter->calls.fetch_add( 1, std::memory_order_relaxed );
+            m_counter->nanoseconds.fetch_add( static_cast< unsigned long long >( nanoseconds ), std::memory_order_relaxed );
+            m_counter->allocations.fetch_add( threadAllocations() - m_allocations, std::memory_order_relaxed );
+            if( m_sink != nullptr )
+            {
+                m_counter->bytes.fetch_add( m_sink->written() - m_bytes, std::memory_order_relaxed );
+            }
+        }
+        Probe( const Probe& ) = delete;
+        Probe& operator=( const Probe& ) = delete;
+    private:
+        Counter* m_counter = nullptr;
+        const Sink* m_sink = nullptr;
+        size_t m_bytes = 0;
+        unsigned long long m_allocations = 0;
+        std::chrono::steady_clock::time_point m_start;
+        bool m_active;
+    };
+
+private:
+    static const char* const* LANGUAGE_NAMES()
+    {
+        static const char* const names[] = { "C++", "C#", "Java" };
+        return names;
+    }
+    static const char* const* KIND_NAMES()
+    {
+        static const char* const names[] = { "class", "method", "print" };
+        return names;
+    }
+    static const char* const* OPERATION_NAMES()
+    {
+        static const char* const names[] = { "compile", "create", "add" };
+        return names;
+    }
+
+    static std::atomic< bool >& enabledFlag()
+    {
+        static std::atomic< bool > flag( false );
+        return flag;
+    }
+    static Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+    static ThreadBlock& threadBlock()
+    {
+        static thread_local ThreadBlock* block = nullptr;
+        if( block == nullptr )
+        {
+            std::shared_ptr< ThreadBlock > created = std::make_shared< ThreadBlock >();
+            Registry& r = registry();
+            std::lock_guard< std::mutex > lock( r.mutex );
+            r.blocks.push_back( created );
+            block = created.get();
+        }
+        return *block;
+    }
+
+    template< class Visit >
+    static void forEachTotal( Visit visit )
+    {
+        for( size_t language = 0; language < LANGUAGE_COUNT; ++language )
+        {
+            for( int kind = 0; kind < NODE_KIND_COUNT; ++kind )
+            {
+                for( int operation = 0; operation < OPERATION_COUNT; ++operation )
+                {
+                    Totals t = total( language, static_cast< NodeKind >( kind ), static_cast< Operation >( operation ) );
+                    if( t.calls != 0 )
+                    {
+                        visit( language, static_cast< NodeKind >( kind ), static_cast< Operation >( operation ), t );
+                    }
+                }
+            }
+        }
+    }
+};
+
+//INSTRUMENT_SCOPE(...) - замер до конца текущей области видимости
+//sink - приёмник, байты в котором нужно посчитать (или nullptr)
+#ifdef CODE_CREATOR_INSTRUMENTATION
+#define INSTRUMENT_SCOPE( language, kind, operation, sink ) \
+    Instrumentation::Probe instrumentationProbe( ( language ), ( kind ), ( operation ), ( sink ) )
+#else
+#define INSTRUMENT_SCOPE( language, kind, operation, sink ) ( ( void )0 )
+#endif
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,134 @@
+#ifndef INTERNING_H
+#define INTERNING_H
+#include <unordered_map>
+#include <functional>
+#include "Factories.h"
+
+//Фабрика, которая не создаёт повторно одинаковые узлы (hash-consing)
+//Оборачивает любую фабрику AbstractFactory:
+// - PrintOperatorCreator(...) для одного и того же текста возвращает один и тот же узел;
+// - internMethod(...) вызывается, когда тело метода уже собрано: если такой же метод
+//   (имя, тип, модификаторы и те же самые узлы в теле) уже встречался, возвращается он, иначе - переданный метод.
+//Возвращённые узлы неизменяемые (Unit::seal()), поэтому их можно вкладывать в любое число родителей,
+//а их текст запоминается для каждого уровня вложенности: повторяющееся поддерево генерируется один раз,
+//дальше готовый текст только копируется. Память и время генерации растут с числом разных поддеревьев, а не всех узлов
+//Классы не объединяются: одинаковые классы в одной программе почти не встречаются
+//Фабрику можно использовать из нескольких потоков
+class InterningFactory: public AbstractFactory
+{
+public:
+    //Сколько узлов запрошено и сколько из них оказались новыми
+    struct Stats
+    {
+        size_t printRequests = 0;
+        size_t uniquePrints = 0;
+        size_t methodRequests = 0;
+        size_t uniqueMethods = 0;
+    };
+
+    //inner - фабрика, которая создаёт узлы; должна жить дольше этой
+    //Узлы размещает inner, поэтому и arena() у обёртки та же, что у inner
+    explicit InterningFactory( const AbstractFactory& inner ): AbstractFactory( inner.arena() ), m_inner( inner ) {}
+
+    std::shared_ptr<ClassUnit> ClassCreator(std::string_view name, Unit::Flags accessFlags = 0, Unit::Flags modificatorFlags = 0) const override
+    {
+        return m_inner.ClassCreator( name, accessFlags, modificatorFlags );
+    }
+    //Метод создаётся как обычно: его тело ещё предстоит собрать
+    std::shared_ptr<MethodUnit> MethodCreator(std::string_view name, std::string_view returnType, Unit::Flags flags) const override
+    {
+        return m_inner.MethodCreator( name, returnType, flags );
+    }
+    std::shared_ptr<PrintOperatorUnit> PrintOperatorCreator(std::string text) const override
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        ++m_stats.printRequests;
+        auto found = m_prints.find( text );
+        if( found != m_prints.end() )
+        {
+            return found->second;
+        }
+        std::shared_ptr< PrintOperatorUnit > created = m_inner.PrintOperatorCreator( text );
+        created->seal();
+        m_prints.emplace( std::move( text ), created );
+        ++m_stats.uniquePrints;
+        return created;
+    }
+    //Собранный метод сразу объединяется с такими же (см. SpecReader)
+    std::shared_ptr<MethodUnit> finishMethod(std::shared_ptr<MethodUnit> method) const override
+    {
+        return internMethod( method );
+    }
+    //internMethod(...) - возвращает единственный экземпляр метода с таким же содержимым
+    //Узлы тела сравниваются по адресу, поэтому они сами должны быть получены из этой фабрики
+    std::shared_ptr<MethodUnit> internMethod( const std::shared_ptr< MethodUnit >& method ) const
+    {
+        if( method == nullptr )
+        {
+            return method;
+        }
+        MethodKey key{ method->name(), method->returnType(), method->flags(), {} };
+        key.body.reserve( method->body().size() );
+        for( const auto& b : method->body() )
+        {
+            key.body.push_back( b.get() );
+        }
+        std::lock_guard< std::mutex > lock( m_mutex );
+        ++m_stats.methodRequests;
+        auto found = m_methods.find( key );
+        if( found != m_methods.end() )
+        {
+            return found->second;
+        }
+        method->seal();
+        m_methods.emplace( std::move( key ), method );
+        ++m_stats.uniqueMethods;
+        return method;
+    }
+    Stats stats() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_stats;
+    }
+
+private:
+    //Ключ метода: всё, что влияет на его текст
+    struct MethodKey
+    {
+        Symbol name;
+        Symbol returnType;
+        Unit::Flags flags;
+        std::vector< const Unit* > body;
+        bool operator==( const MethodKey& other ) const
+        {
+            return flags == other.flags && name == other.name && returnType == other.returnType && body == other.body;
+        }
+    };
+    struct MethodKeyHash
+    {
+        size_t operator()( const MethodKey& key ) const
+        {
+            size_t result = key.name.hash();
+            combine( result, key.returnType.hash() );
+            combine( result, key.flags );
+            for( const Unit* b : key.body )
+            {
+                combine( result, std::hash< const Unit* >()( b ) );
+            }
+            return result;
+        }
+        static void combine( size_t& seed, size_t value )
+        {
+            seed ^= value + 0x9e3779b97f4a7c15ull + ( seed << 6 ) + ( seed >> 2 );
+        }
+    };
+
+    const AbstractFactory& m_inner;
+    mutable std::mutex m_mutex;
+    //Таблицы держат узлы живыми, поэтому адреса узлов в ключах не переиспользуются
+    mutable std::unordered_map< std::string, std::shared_ptr< PrintOperatorUnit > > m_prints;
+    mutable std::unordered_map< MethodKey, std::shared_ptr< MethodUnit >, MethodKeyHash > m_methods;
+    mutable Stats m_stats;
+};
+
+#endif // INTERNING_H
@@ -0,0 +1,93 @@
+#ifndef ITERATIVECOMPILER_H
+#define ITERATIVECOMPILER_H
+#include "Abstractions.h"
+
+//Нерекурсивная генерация дерева Unit
+//compileTo(...) узла вызывает compileTo(...) детей, поэтому глубина стека вызовов растёт вместе с глубиной дерева,
+//и очень глубокое дерево может переполнить стек (особенно у рабочих потоков с маленьким стеком)
+//Здесь обход идёт по явному стеку в куче: узлы отдают свой текст шагами (Unit::stepOpen, stepChild, stepClose),
+//а глубина стека вызовов не зависит от глубины дерева. Результат побайтно совпадает с compileTo(...)
+//Отступы, как и в compileTo(...), берутся из общей таблицы (writeShift), строки отступов не создаются
+//Готовый текст узлов (setOutputCaching, seal) используется, но новый не запоминается
+//Стек кадров хранится в объекте и переиспользуется между вызовами; объект не потокобезопасен,
+//каждому потоку нужен свой
+//Разрушение дерева тоже рекурсивно: очень глубокие деревья лучше строить в арене (UnitArena.h)
+class IterativeCompiler
+{
+public:
+    //compile(...) - дописывает код дерева root в приёмник sink
+    void compile( const Unit& root, Sink& sink, unsigned int level = 0 )
+    {
+        start( root, sink, level );
+        while( step() )
+        {
+        }
+    }
+    //compile(...) - то же самое, но результат возвращается строкой
+    std::string compile( const Unit& root, unsigned int level = 0 )
+    {
+        std::string result;
+        StringSink sink( result );
+        compile( root, sink, level );
+        return result;
+    }
+    //start(...), step() - тот же обход по одному шагу, чтобы его можно было приостанавливать (см. PullGenerator.h)
+    //start(...) пишет начало корня; каждый step() пишет в приёмник следующий кусок текста
+    //(начало или конец одного узла) и возвращает false, когда дерево записано целиком
+    void start( const Unit& root, Sink& sink, unsigned int level = 0 )
+    {
+        m_stack.clear();
+        m_sink = &sink;
+        push( root, level );
+    }
+    bool step()
+    {
+        if( m_stack.empty() )
+        {
+            return false;
+        }
+        Frame& top = m_stack.back();
+        if( top.next == top.count )
+        {
+            top.unit->stepClose( *m_sink, top.level );
+            m_stack.pop_back();
+            return !m_stack.empty();
+        }
+        const unsigned int childLevel = top.level + 1;
+        const Unit* child = top.unit->stepChild( *m_sink, top.level, top.next++ );
+        //После push ссылка top может стать недействительной
+        push( *child, childLevel );
+        return true;
+    }
+    //depth() - наибольшая глубина стека кадров за время жизни объекта
+    size_t depth() const
+    {
+        return m_depth;
+    }
+
+private:
+    struct Frame
+    {
+        const Unit* unit;
+        unsigned int level;
+        size_t next;
+        size_t count;
+    };
+
+    void push( const Unit& unit, unsigned int level )
+    {
+        const size_t count = unit.stepOpen( *m_sink, level );
+        if( count == Unit::STEP_DONE )
+        {
+            return;
+        }
+        m_stack.push_back( Frame{ &unit, level, 0, count } );
+        m_depth = std::max( m_depth, m_stack.size() );
+    }
+
+    std::vector< Frame > m_stack;
+    Sink* m_sink = nullptr;
+    size_t m_depth = 0;
+};
+
+#endif // ITERATIVECOMPILER_H
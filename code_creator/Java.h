@@ -1,100 +1,209 @@
 #ifndef JAVA_H
 #define JAVA_H
 #include "Abstractions.h"
+#include "UnitArena.h"
+#include "Escape.h"
 
-//Класс для генерации конкретного класса на языке Java
-class JavaClassUnit: public ClassUnit
+//Правила синтаксиса языка Java
+struct JavaSyntax
 {
-private:
-    //тип доступа для класса
-    Flags accessesModifier_class;
-    //модификатор для класса
-    Flags Modifier;
-public:
-    explicit JavaClassUnit( const std::string& name, Flags classAccess = PUBLIC /*public, private, protected*/, Flags classModifier = 0 /*Final, abstract*/ ): ClassUnit(name)
+    static const char* name()
     {
-        //У Java имеется 3 типа доступа, поэтому изменяем размер на 3
-        m_fields.resize(3);
-        Modifier = 0;
-        //Определение модификатора
-        if (classModifier & MethodUnit::ABSTRACT)
-        {
-           Modifier = MethodUnit::ABSTRACT;
-        }
-
-        else if(classModifier & MethodUnit::FINAL)
-        {
-            Modifier = MethodUnit::FINAL;
-        }
-        //определение типа доступа класса
-        if(classAccess<2)
-        {
-            accessesModifier_class = classAccess;
-        }
-        else
+        return "Java";
+    }
+    //У Java имеется 3 типа доступа
+    //Номер языка в таблицах (счётчики Instrumentation и т.п.)
+    static const size_t LANGUAGE_INDEX = 2;
+    //Ключевые слова и синтаксис оператора вывода - константы времени компиляции
+    static constexpr const char* CLASS_KEYWORD = "class ";
+    static constexpr const char* CLASS_CLOSE = "};\n";
+    static constexpr const char* PRINT_OPEN = "System.out.print( \"";
+    static constexpr const char* PRINT_CLOSE = "\" );\n";
+    static const size_t ACCESS_COUNT = 3;
+    //Тип доступа класса по умолчанию (как в JavaClassUnit)
+    static const Unit::Flags DEFAULT_CLASS_ACCESS = ClassUnit::PUBLIC;
+    static void checkAccess( Unit::Flags flags )
+    {
+        if( flags >= ACCESS_COUNT )
         {
-            accessesModifier_class = PUBLIC;
             throw std::runtime_error("In Java there is no accessModifire for classes like this");
         }
-
     }
-
-    void add(const std::shared_ptr< Unit >& unit, Flags flags) override
+    //Для самого класса допустимы только первые два типа доступа
+    static void checkClass( Unit::Flags classAccess, Unit::Flags /* classModifier */ )
     {
-        //Проверка существования объекта
-        if(unit == nullptr)
+        if( classAccess >= 2 )
         {
-            return;
+            throw std::runtime_error("In Java there is no accessModifire for classes like this");
         }
-        //Определение типа доступа функции
-        int accessModifier = PUBLIC;
-        if(flags < 3)
+    }
+    //Из модификаторов класса учитывается только один: abstract важнее final
+    static Unit::Flags classModifier( Unit::Flags flags )
+    {
+        if( flags & MethodUnit::ABSTRACT )
         {
-            accessModifier = flags;
+            return MethodUnit::ABSTRACT;
         }
-        else
+        else if( flags & MethodUnit::FINAL )
         {
-            throw std::runtime_error("In Java there is no accessModifire for classes like this");
+            return MethodUnit::FINAL;
         }
-        //Добавление в вектор метода и его типа доступа
-        m_fields[accessModifier].push_back(unit);
+        return 0;
     }
-
-    std::string compile( unsigned int level = 0 ) const override
+    template< class Out >
+    static void classOpen( Out& sink, unsigned int level, std::string_view name, Unit::Flags classAccess, Unit::Flags classModifier )
     {
         //Сначала объявляем тип доступа и модификатор класса
-        std::string classAccess = "";
-        std::string Modifier = "";
-
-        classAccess = ACCESS_MODIFIERS[accessesModifier_class] + ' ';
-
-        if(accessesModifier_class & MethodUnit::FINAL)
+        writeShift( sink, level );
+        sink << ClassUnit::ACCESS_MODIFIERS[ classAccess ] << ' ';
+        if( classModifier & MethodUnit::ABSTRACT )
         {
-            Modifier = "final";
+            sink << "abstract ";
         }
-        else if (accessesModifier_class & MethodUnit::ABSTRACT)
+        else if( classModifier & MethodUnit::FINAL )
         {
-            Modifier = "abstract";
+            sink << "final ";
         }
         //После того, как определили тип доступа класса, переходим к непосредственному объявлению класса
-        std::string result = generateShift(level) + classAccess + Modifier + "class " + m_name + " {\n";
-        //Определяем методы и их тела
-        for( size_t i = 0; i < m_fields.size(); ++i )
+        sink << CLASS_KEYWORD << name << " {\n";
+    }
+    //В Java методы не группируются под метками типов доступа
+    template< class Out >
+    static void sectionOpen( Out& /* sink */, unsigned int /* level */, size_t /* access */ ) {}
+    //Поскольку у функций также много различных типов доступа, необходимо их добавить перед каждым методом
+    template< class Out >
+    static void memberPrefix( Out& sink, unsigned int level, size_t access )
+    {
+        writeShift( sink, level );
+        sink << ClassUnit::ACCESS_MODIFIERS[ access ] << ' ';
+    }
+    template< class Out >
+    static void sectionClose( Out& sink, unsigned int /* level */ )
+    {
+        sink << "\n";
+    }
+    template< class Out >
+    static void classClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << CLASS_CLOSE;
+    }
+    //Проверка модификаторов метода: абстрактный метод не может быть final, static или synchronized
+    static void checkMethod( Unit::Flags flags )
+    {
+        if( ( flags & MethodUnit::ABSTRACT ) && ( flags & ( MethodUnit::FINAL | MethodUnit::STATIC | MethodUnit::SYNCHRONIZED ) ) )
+        {
+            throw std::runtime_error( "In Java abstract method can not be final, static or synchronized" );
+        }
+    }
+    //Модификаторы перед типом метода для набора флагов flags (берутся из таблицы)
+    static std::string_view methodPrefix( Unit::Flags flags )
+    {
+        static const ModifierTable table( []( Unit::Flags f )
         {
-            if( m_fields[ i ].empty() )
+            std::string prefix;
+            if( f & MethodUnit::SYNCHRONIZED )
             {
-                continue;
+                prefix += "synchronized ";
             }
-
-            //Поскольку у функций также много различных типов доступа, необходимо их добавить
-            for( const auto& f : m_fields[ i ] )
+            if( f & MethodUnit::STATIC )
             {
-                result += generateShift( level + 1 ) + ACCESS_MODIFIERS[i] + ' ' + f->compile(level+1);
+                prefix += "static ";
             }
-            result += "\n";
+            if( f & MethodUnit::ABSTRACT )
+            {
+                prefix += "abstract ";
+            }
+            else if( f & MethodUnit::FINAL )
+            {
+                prefix += "final ";
+            }
+            return prefix;
+        } );
+        return table[ flags ];
+    }
+    //Объявление метода; отступ уже поставлен вместе с типом доступа в memberPrefix(...)
+    template< class Out >
+    static void methodOpen( Out& sink, unsigned int /* level */, std::string_view name, std::string_view returnType, Unit::Flags flags )
+    {
+        sink << methodPrefix( flags ) << returnType << ' ' << name << "() {\n";
+    }
+    template< class Out >
+    static void methodClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << "}\n";
+    }
+    template< class Out >
+    static void print( Out& sink, unsigned int level, std::string_view text )
+    {
+        writeShift( sink, level );
+        sink << PRINT_OPEN;
+        Escape::java( sink, text );
+        sink << PRINT_CLOSE;
+    }
+};
+
+//Класс для генерации конкретного класса на языке Java
+class JavaClassUnit: public ClassUnit
+{
+private:
+    //тип доступа для класса
+    Flags accessesModifier_class;
+    //модификатор для класса
+    Flags Modifier;
+public:
+    //правила языка, по которым генерируется узел
+    using Syntax = JavaSyntax;
+    explicit JavaClassUnit( std::string_view name, Flags classAccess = PUBLIC /*public, private, protected*/, Flags classModifier = 0 /*Final, abstract*/ ): ClassUnit(name)
+    {
+        //У Java имеется 3 типа доступа, поэтому изменяем размер на 3
+        m_fields.resize(JavaSyntax::ACCESS_COUNT);
+        //Определение модификатора
+        Modifier = JavaSyntax::classModifier(classModifier);
+        //определение типа доступа класса
+        JavaSyntax::checkClass(classAccess, Modifier);
+        accessesModifier_class = classAccess;
+    }
+
+    void add(std::shared_ptr< Unit > unit, Flags flags) override
+    {
+        //Проверка существования объекта
+        if(unit == nullptr)
+        {
+            return;
         }
-        result += generateShift( level ) + "};\n";
-        return result;
+        //Определение типа доступа функции
+        JavaSyntax::checkAccess(flags);
+        //Добавление в вектор метода и его типа доступа
+        addField< Syntax >(std::move(unit), flags);
+    }
+
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
+    {
+        compileClass< Syntax >( sink, level, accessesModifier_class, Modifier );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureClass< Syntax >( level, accessesModifier_class, Modifier );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenClass< Syntax >( sink, level, accessesModifier_class, Modifier );
+    }
+    const Unit* stepChild( Sink& sink, unsigned int level, size_t index ) const override
+    {
+        return stepChildClass< Syntax >( sink, level, index );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseClass< Syntax >( sink, level );
+    }
+    std::shared_ptr< MethodUnit > newMethod( std::string_view name, std::string_view returnType, Flags flags ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags classAccess, Flags classModifier ) const override
+    {
+        return makeUnit< JavaClassUnit >( arena(), name, classAccess, classModifier );
     }
 };
 
@@ -102,50 +211,43 @@ public:
 class JavaMethodUnit: public MethodUnit
 {
 public:
-    JavaMethodUnit( const std::string& name, const std::string& returnType, Flags flags ): MethodUnit(name, returnType, flags){}
+    //правила языка, по которым генерируется узел
+    using Syntax = JavaSyntax;
+    JavaMethodUnit( std::string_view name, std::string_view returnType, Flags flags ): MethodUnit(name, returnType, flags)
+    {
+        //Недопустимое сочетание модификаторов отклоняем сразу, а не при генерации
+        Syntax::checkMethod( flags );
+    }
 
-    void add( const std::shared_ptr< Unit >& unit, Flags /* flags */ = 0 ) override
+    void add( std::shared_ptr< Unit > unit, Flags /* flags */ = 0 ) override
     {
         //Допускаем, что тело функции может быть пустым
         if(unit != nullptr){
-            m_body.push_back( unit );
+            addBody< Syntax >( std::move( unit ) );
         }
     }
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        //Модификаторы
-        std::string result = "";
-
-        if( m_flags & SYNCHRONIZED) {
-            result += "synchronized ";
-        }
-
-        if(m_flags & STATIC)
-        {
-            result += "static ";
-        }
-
-        if(m_flags & ABSTRACT)
-        {
-            result += "abstract ";
-        }
-        // при объявлении метода не могут стоять одновременно abstract и final
-        else if( m_flags & FINAL )
-        {
-            result += "final ";
-        }
-
-        result += m_returnType + " ";
-        result += m_name + "()";
-        result += " {\n";
-        //Сборка тела метода
-        for( const auto& b : m_body )
-        {
-            result += b->compile( level + 1 );
-        }
-        result += generateShift( level ) + "}\n";
-        return result;
+        compileMethod< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureMethod< Syntax >( level );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenMethod< Syntax >( sink, level );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseMethod< Syntax >( sink, level );
+    }
+    std::shared_ptr< PrintOperatorUnit > newPrint( std::string text ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags classAccess, Flags classModifier ) const override
+    {
+        return makeUnit< JavaClassUnit >( arena(), name, classAccess, classModifier );
     }
 };
 
@@ -153,12 +255,28 @@ public:
 class JavaPrintOperatorUnit: public PrintOperatorUnit
 {
 public:
-    explicit JavaPrintOperatorUnit( const std::string& text ): PrintOperatorUnit(text){}
-    std::string compile( unsigned int level = 0 ) const override
+    //правила языка, по которым генерируется узел
+    using Syntax = JavaSyntax;
+    explicit JavaPrintOperatorUnit( std::string text ): PrintOperatorUnit(std::move(text)){}
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
+    {
+        compilePrint< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
     {
-        return generateShift( level ) + "System.out.print( \"" + m_text + "\" );\n";
+        return measurePrint< Syntax >( level );
     }
 };
 
 
+//Узлы, которые создаются функциями emplace...(...), определены ниже своих родителей
+inline std::shared_ptr< MethodUnit > JavaClassUnit::newMethod( std::string_view name, std::string_view returnType, Flags flags ) const
+{
+    return makeUnit< JavaMethodUnit >( arena(), name, returnType, flags );
+}
+inline std::shared_ptr< PrintOperatorUnit > JavaMethodUnit::newPrint( std::string text ) const
+{
+    return makeUnit< JavaPrintOperatorUnit >( arena(), std::move( text ) );
+}
+
 #endif // JAVA_H
@@ -0,0 +1,99 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+#include <string>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+//Файл, отображённый в память
+//Режим записи создаёт (или обрезает) файл заданного размера, после чего в него можно писать как в обычную память;
+//режим чтения отображает существующий файл только для чтения
+//Ошибки системных вызовов сообщаются исключениями std::runtime_error
+class MappedFile
+{
+public:
+    enum Mode { READ, WRITE };
+
+    MappedFile( const std::string& path, Mode mode, size_t size = 0 ): m_data( nullptr ), m_size( 0 )
+    {
+        int fd = mode == WRITE ? ::open( path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644 ) : ::open( path.c_str(), O_RDONLY );
+        if( fd < 0 )
+        {
+            fail( "Can not open " + path );
+        }
+        try
+        {
+            if( mode == WRITE )
+            {
+                if( ::ftruncate( fd, static_cast< off_t >( size ) ) != 0 )
+                {
+                    fail( "Can not resize " + path );
+                }
+            }
+            else
+            {
+                struct stat info;
+                if( ::fstat( fd, &info ) != 0 )
+                {
+                    fail( "Can not stat " + path );
+                }
+                size = static_cast< size_t >( info.st_size );
+            }
+            //Пустой файл отобразить нельзя, но и не нужно
+            if( size > 0 )
+            {
+                void* data = ::mmap( nullptr, size, mode == WRITE ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0 );
+                if( data == MAP_FAILED )
+                {
+                    fail( "Can not map " + path );
+                }
+                m_data = static_cast< char* >( data );
+                m_size = size;
+            }
+        }
+        catch( ... )
+        {
+            ::close( fd );
+            throw;
+        }
+        //Отображение остаётся действительным и после закрытия дескриптора
+        ::close( fd );
+    }
+    ~MappedFile()
+    {
+        if( m_data != nullptr )
+        {
+            ::munmap( m_data, m_size );
+        }
+    }
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    char* data()
+    {
+        return m_data;
+    }
+    const char* data() const
+    {
+        return m_data;
+    }
+    size_t size() const
+    {
+        return m_size;
+    }
+
+private:
+    static void fail( const std::string& message )
+    {
+        throw std::runtime_error( message + ": " + std::strerror( errno ) );
+    }
+
+    char* m_data;
+    size_t m_size;
+};
+
+#endif // MAPPEDFILE_H
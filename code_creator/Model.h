@@ -0,0 +1,135 @@
+#ifndef MODEL_H
+#define MODEL_H
+#include "Abstractions.h"
+
+//Промежуточное представление (модель) программы, не зависящее от языка
+//Дерево модели строится один раз, после чего не меняется и может использоваться
+//сразу для всех языков (см. Backends.h), в отличие от деревьев Unit, которые фабрика строит отдельно под каждый язык
+//Типы доступа и модификаторы - те же, что у ClassUnit::AccessModifier и MethodUnit::Modifier
+//Имена и типы, как и в узлах Unit, хранятся символами общей таблицы SymbolTable и принимаются как std::string_view,
+//а текст оператора вывода принимается по значению и перемещается в узел
+
+//Базовый узел модели
+class ModelNode
+{
+public:
+    //Вид узла; по нему генератор понимает, как обходить узел, без виртуальных вызовов
+    enum Kind { CLASS, METHOD, PRINT };
+    using Flags = Unit::Flags;
+    //Узлы модели неизменяемые, поэтому и хранятся по указателю на const
+    using Ptr = std::shared_ptr< const ModelNode >;
+    virtual ~ModelNode() = default;
+    Kind kind() const
+    {
+        return m_kind;
+    }
+protected:
+    explicit ModelNode( Kind kind ): m_kind( kind ) {}
+private:
+    Kind m_kind;
+};
+
+//Класс: имя, тип доступа и модификатор самого класса, методы по группам типов доступа
+class ModelClass: public ModelNode
+{
+public:
+    //Значение типа доступа "как принято в языке по умолчанию"
+    static const Flags DEFAULT_ACCESS = ~0u;
+    explicit ModelClass( std::string_view name, Flags access = DEFAULT_ACCESS, Flags modifier = 0 ):
+        ModelNode( CLASS ), m_name( name ), m_access( access ), m_modifier( modifier )
+    {
+        m_fields.resize( ClassUnit::ACCESS_MODIFIERS.size() );
+    }
+    //add(...) - добавляет вложенный узел с указанным типом доступа
+    //Допустим ли тип доступа в конкретном языке, проверяется при генерации
+    void add( const Ptr& node, Flags access )
+    {
+        if( node == nullptr )
+        {
+            return;
+        }
+        if( access >= m_fields.size() )
+        {
+            throw std::runtime_error( "There is no accessModifire like this" );
+        }
+        m_fields[ access ].push_back( node );
+    }
+    Symbol name() const
+    {
+        return m_name;
+    }
+    Flags access() const
+    {
+        return m_access;
+    }
+    //accessOr(...) - тип доступа класса или fallback, если он не задан
+    Flags accessOr( Flags fallback ) const
+    {
+        return m_access == DEFAULT_ACCESS ? fallback : m_access;
+    }
+    Flags modifier() const
+    {
+        return m_modifier;
+    }
+    const std::vector< std::vector< Ptr > >& fields() const
+    {
+        return m_fields;
+    }
+private:
+    Symbol m_name;
+    Flags m_access;
+    Flags m_modifier;
+    std::vector< std::vector< Ptr > > m_fields;
+};
+
+//Метод: имя, возвращаемый тип, модификаторы MethodUnit::Modifier и тело
+class ModelMethod: public ModelNode
+{
+public:
+    explicit ModelMethod( std::string_view name, std::string_view returnType, Flags flags ):
+        ModelNode( METHOD ), m_name( name ), m_returnType( returnType ), m_flags( flags ) {}
+    //Допускаем, что тело метода может быть пустым
+    void add( const Ptr& node )
+    {
+        if( node != nullptr )
+        {
+            m_body.push_back( node );
+        }
+    }
+    Symbol name() const
+    {
+        return m_name;
+    }
+    Symbol returnType() const
+    {
+        return m_returnType;
+    }
+    Flags flags() const
+    {
+        return m_flags;
+    }
+    const std::vector< Ptr >& body() const
+    {
+        return m_body;
+    }
+private:
+    Symbol m_name;
+    Symbol m_returnType;
+    Flags m_flags;
+    std::vector< Ptr > m_body;
+};
+
+//Оператор вывода текста
+class ModelPrint: public ModelNode
+{
+public:
+    explicit ModelPrint( std::string text ): ModelNode( PRINT ), m_text( std::move( text ) ) {}
+    const std::string& text() const
+    {
+        return m_text;
+    }
+private:
+    std::string m_text;
+};
+
+#endif // MODEL_H
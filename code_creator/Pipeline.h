@@ -0,0 +1,375 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include "Spec.h"
+
+//Показатели очереди BoundedQueue
+struct QueueStats
+{
+    size_t capacity = 0;
+    size_t pushed = 0;
+    size_t maxDepth = 0;
+    //средняя глубина сразу после добавления
+    double averageDepth = 0;
+    //сколько производитель ждал места и потребитель - элементов
+    double pushWaitMs = 0;
+    double popWaitMs = 0;
+};
+
+//Очередь ограниченной ёмкости между стадиями конвейера
+//push(...) ждёт, пока в очереди не появится место: быстрая стадия не убегает вперёд медленной (обратное давление),
+//и память конвейера ограничена ёмкостью очередей
+//Время ожидания в push(...) и pop(...) и глубина очереди собираются для отчёта
+template< class T >
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue( size_t capacity ): m_capacity( capacity ? capacity : 1 ) {}
+
+    //push(...) - false, если очередь уже закрыта (элемент тогда не добавляется)
+    bool push( T item )
+    {
+        std::unique_lock< std::mutex > lock( m_mutex );
+        if( m_items.size() >= m_capacity && !m_closed )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            m_notFull.wait( lock, [ this ] { return m_items.size() < m_capacity || m_closed; } );
+            m_pushWait += std::chrono::steady_clock::now() - start;
+        }
+        if( m_closed )
+        {
+            return false;
+        }
+        m_items.push_back( std::move( item ) );
+        ++m_pushed;
+        m_depthSum += m_items.size();
+        m_maxDepth = std::max( m_maxDepth, m_items.size() );
+        m_notEmpty.notify_one();
+        return true;
+    }
+    //pop(...) - false, если очередь закрыта и пуста
+    bool pop( T& item )
+    {
+        std::unique_lock< std::mutex > lock( m_mutex );
+        if( m_items.empty() && !m_closed )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            m_notEmpty.wait( lock, [ this ] { return !m_items.empty() || m_closed; } );
+            m_popWait += std::chrono::steady_clock::now() - start;
+        }
+        if( m_items.empty() )
+        {
+            return false;
+        }
+        item = std::move( m_items.front() );
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+    //close() - новых элементов не будет; уже добавленные ещё можно забрать
+    void close()
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+    QueueStats stats() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        QueueStats s;
+        s.capacity = m_capacity;
+        s.pushed = m_pushed;
+        s.maxDepth = m_maxDepth;
+        s.averageDepth = m_pushed ? static_cast< double >( m_depthSum ) / static_cast< double >( m_pushed ) : 0;
+        s.pushWaitMs = std::chrono::duration< double, std::milli >( m_pushWait ).count();
+        s.popWaitMs = std::chrono::duration< double, std::milli >( m_popWait ).count();
+        return s;
+    }
+
+private:
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque< T > m_items;
+    bool m_closed = false;
+    size_t m_pushed = 0;
+    size_t m_depthSum = 0;
+    size_t m_maxDepth = 0;
+    std::chrono::steady_clock::duration m_pushWait{};
+    std::chrono::steady_clock::duration m_popWait{};
+};
+
+//Конвейер пакетной генерации: построение деревьев, генерация и запись работают одновременно
+//  построение - поток, вызвавший run(...): SpecReader читает описание и строит деревья класса верхнего уровня;
+//  генерация  - compileThreads потоков: compile() деревьев класса для всех фабрик;
+//  запись     - отдельный поток: передаёт готовый код обработчику записи строго в порядке описания.
+//Стадии связаны очередями BoundedQueue. Класс попадает сразу в очередь генерации и, в виде обещанного результата,
+//в очередь записи; запись ждёт результат первого класса в своей очереди, поэтому порядок сохраняется без сортировки,
+//а число классов в работе ограничено ёмкостью очередей и числом потоков генерации
+//Время работы конвейера приближается ко времени самой медленной стадии, а не к сумме всех стадий
+//Деревья освобождаются в потоке генерации, поэтому фабрики не должны размещать узлы в общей арене, которую кто-то очищает
+//Первая ошибка любой стадии останавливает построение и выбрасывается из run(...) после остановки всех потоков
+class GenerationPipeline
+{
+public:
+    //Код одного класса верхнего уровня: texts[ i ] построен фабрикой i
+    struct CompiledClass
+    {
+        std::string name;
+        std::vector< std::string > texts;
+    };
+    using WriteHandler = std::function< void( const CompiledClass& ) >;
+
+    //Показатели стадии: items - обработано классов, busyMs - время работы (у генерации - сумма по потокам),
+    //waitMs - время ожидания соседних стадий
+    struct StageStats
+    {
+        const char* name = "";
+        size_t threads = 1;
+        size_t items = 0;
+        double busyMs = 0;
+        double waitMs = 0;
+        size_t bytes = 0;
+    };
+
+    //compileThreads - потоки стадии генерации (0 - по числу ядер); queueCapacity - ёмкость каждой очереди в классах
+    GenerationPipeline( std::vector< const AbstractFactory* > factories, WriteHandler writer, size_t compileThreads = 0, size_t queueCapacity = 16 ):
+        m_factories( std::move( factories ) ), m_writer( std::move( writer ) ), m_compileThreads( compileThreads ),
+        m_compileQueue( queueCapacity ), m_writeQueue( queueCapacity )
+    {
+        if( m_compileThreads == 0 )
+        {
+            m_compileThreads = std::max( 1u, std::thread::hardware_concurrency() );
+        }
+    }
+    GenerationPipeline( const GenerationPipeline& ) = delete;
+    GenerationPipeline& operator=( const GenerationPipeline& ) = delete;
+
+    //run(...) - пропускает описание через конвейер; возвращается, когда записан последний класс
+    //Объект рассчитан на один вызов run(...)
+    void run( std::istream& in )
+    {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector< std::thread > compilers;
+        for( size_t i = 0; i < m_compileThreads; ++i )
+        {
+            compilers.emplace_back( &GenerationPipeline::compileLoop, this );
+        }
+        std::thread writer( &GenerationPipeline::writeLoop, this );
+
+        SpecReader reader( m_factories, [ this ]( const std::vector< std::shared_ptr< Unit > >& units )
+        {
+            Job job{ units, std::promise< CompiledClass >() };
+            std::future< CompiledClass > result = job.result.get_future();
+            if( m_failed.load() || !m_compileQueue.push( std::move( job ) ) || !m_writeQueue.push( std::move( result ) ) )
+            {
+                throw Stopped();
+            }
+            ++m_constructed;
+        } );
+        try
+        {
+            reader.read( in );
+        }
+        catch( const Stopped& )
+        {
+        }
+        catch( ... )
+        {
+            fail( std::current_exception() );
+        }
+        //Стадия построения ждёт только места в очередях; остальное время до конца описания она работает
+        m_constructTime = std::chrono::steady_clock::now() - start;
+        m_compileQueue.close();
+        m_writeQueue.close();
+        for( auto& thread : compilers )
+        {
+            thread.join();
+        }
+        writer.join();
+        m_wall = std::chrono::steady_clock::now() - start;
+        if( m_error )
+        {
+            std::rethrow_exception( m_error );
+        }
+    }
+
+    //classes() - сколько классов прошло через конвейер
+    size_t classes() const
+    {
+        return m_written;
+    }
+    //stages() - показатели стадий: построение, генерация, запись
+    std::vector< StageStats > stages() const
+    {
+        std::vector< StageStats > result( 3 );
+        result[ 0 ].name = "construct";
+        result[ 0 ].items = m_constructed;
+        result[ 0 ].waitMs = m_compileQueue.stats().pushWaitMs + m_writeQueue.stats().pushWaitMs;
+        result[ 0 ].busyMs = milliseconds( m_constructTime ) - result[ 0 ].waitMs;
+        result[ 1 ].name = "compile";
+        result[ 1 ].threads = m_compileThreads;
+        result[ 1 ].items = m_compiled.load();
+        result[ 1 ].busyMs = static_cast< double >( m_compileBusy.load() ) / 1e6;
+        result[ 1 ].waitMs = m_compileQueue.stats().popWaitMs;
+        result[ 1 ].bytes = m_compiledBytes.load();
+        result[ 2 ].name = "write";
+        result[ 2 ].items = m_written;
+        result[ 2 ].busyMs = milliseconds( m_writeBusy );
+        result[ 2 ].waitMs = milliseconds( m_writeWait );
+        result[ 2 ].bytes = m_compiledBytes.load();
+        return result;
+    }
+    QueueStats compileQueue() const
+    {
+        return m_compileQueue.stats();
+    }
+    QueueStats writeQueue() const
+    {
+        return m_writeQueue.stats();
+    }
+    double wallMs() const
+    {
+        return milliseconds( m_wall );
+    }
+
+    //report(...) - показатели стадий и очередей в текстовом виде
+    void report( std::ostream& out ) const
+    {
+        for( const auto& s : stages() )
+        {
+            out << s.name << ": " << s.items << " classes, threads " << s.threads << ", busy " << s.busyMs << " ms, waiting "
+                << s.waitMs << " ms";
+            if( s.busyMs > 0 )
+            {
+                out << ", " << static_cast< double >( s.items ) * 1000.0 / s.busyMs * static_cast< double >( s.threads )
+                    << " classes/s";
+            }
+            out << "\n";
+        }
+        const auto queue = [ &out ]( const char* name, const QueueStats& q )
+        {
+            out << name << " queue: capacity " << q.capacity << ", max depth " << q.maxDepth << ", average depth "
+                << q.averageDepth << ", producer blocked " << q.pushWaitMs << " ms\n";
+        };
+        queue( "compile", m_compileQueue.stats() );
+        queue( "write", m_writeQueue.stats() );
+        out << "pipeline wall time: " << wallMs() << " ms\n";
+    }
+
+private:
+    struct Job
+    {
+        std::vector< std::shared_ptr< Unit > > units;
+        std::promise< CompiledClass > result;
+    };
+    //Построение остановлено, потому что другая стадия уже упала
+    struct Stopped
+    {
+    };
+
+    static double milliseconds( std::chrono::steady_clock::duration d )
+    {
+        return std::chrono::duration< double, std::milli >( d ).count();
+    }
+
+    void compileLoop()
+    {
+        Job job;
+        while( m_compileQueue.pop( job ) )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            try
+            {
+                CompiledClass compiled;
+                compiled.name = static_cast< const ClassUnit& >( *job.units.front() ).name().str();
+                size_t bytes = 0;
+                for( const auto& unit : job.units )
+                {
+                    compiled.texts.push_back( unit->compile() );
+                    bytes += compiled.texts.back().size();
+                }
+                //Деревья больше не нужны: освобождаем их здесь, а не в потоке записи
+                job.units.clear();
+                m_compiledBytes += bytes;
+                job.result.set_value( std::move( compiled ) );
+            }
+            catch( ... )
+            {
+                job.result.set_exception( std::current_exception() );
+            }
+            job.units.clear();
+            ++m_compiled;
+            m_compileBusy += static_cast< unsigned long long >(
+                std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count() );
+        }
+    }
+
+    void writeLoop()
+    {
+        std::future< CompiledClass > result;
+        while( m_writeQueue.pop( result ) )
+        {
+            const auto waitStart = std::chrono::steady_clock::now();
+            result.wait();
+            const auto start = std::chrono::steady_clock::now();
+            m_writeWait += start - waitStart;
+            //После ошибки оставшиеся классы только забираются из очереди, чтобы построение не зависло на полной очереди
+            if( !m_failed.load() )
+            {
+                try
+                {
+                    m_writer( result.get() );
+                    ++m_written;
+                }
+                catch( ... )
+                {
+                    fail( std::current_exception() );
+                }
+            }
+            m_writeBusy += std::chrono::steady_clock::now() - start;
+        }
+    }
+
+    void fail( std::exception_ptr error )
+    {
+        std::lock_guard< std::mutex > lock( m_errorMutex );
+        if( !m_error )
+        {
+            m_error = error;
+        }
+        m_failed.store( true );
+    }
+
+    std::vector< const AbstractFactory* > m_factories;
+    WriteHandler m_writer;
+    size_t m_compileThreads;
+    BoundedQueue< Job > m_compileQueue;
+    BoundedQueue< std::future< CompiledClass > > m_writeQueue;
+
+    std::atomic< bool > m_failed{ false };
+    std::mutex m_errorMutex;
+    std::exception_ptr m_error;
+
+    size_t m_constructed = 0;
+    std::chrono::steady_clock::duration m_constructTime{};
+    std::atomic< size_t > m_compiled{ 0 };
+    std::atomic< unsigned long long > m_compileBusy{ 0 };
+    std::atomic< size_t > m_compiledBytes{ 0 };
+    size_t m_written = 0;
+    std::chrono::steady_clock::duration m_writeBusy{};
+    std::chrono::steady_clock::duration m_writeWait{};
+    std::chrono::steady_clock::duration m_wall{};
+};
+
+#endif // PIPELINE_H
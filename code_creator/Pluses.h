@@ -1,18 +1,134 @@
 #ifndef PLUSES_H
 #define PLUSES_H
 #include "Abstractions.h"
+#include "UnitArena.h"
+#include "Escape.h"
+
+//Правила синтаксиса языка С++
+//Здесь собраны все ключевые слова и правила расстановки модификаторов,
+//чтобы ими одинаково пользовались и узлы дерева (Unit), и генерация из промежуточного представления (Model.h)
+struct PlussesSyntax
+{
+    //название языка
+    static const char* name()
+    {
+        return "C++";
+    }
+    //У С++ иммется три типа доступа
+    //Номер языка в таблицах (счётчики Instrumentation и т.п.)
+    static const size_t LANGUAGE_INDEX = 0;
+    //Ключевые слова и синтаксис оператора вывода - константы времени компиляции
+    static constexpr const char* CLASS_KEYWORD = "class ";
+    static constexpr const char* CLASS_CLOSE = "};\n";
+    static constexpr const char* PRINT_OPEN = "printf( \"";
+    static constexpr const char* PRINT_CLOSE = "\" );\n";
+    static const size_t ACCESS_COUNT = 3;
+    //У классов С++ нет типа доступа; значение не используется
+    static const Unit::Flags DEFAULT_CLASS_ACCESS = ClassUnit::PRIVATE;
+    //Проверка типа доступа метода
+    static void checkAccess( Unit::Flags flags )
+    {
+        //Если пришёл флаг, который больше, чем количество типов доступа,
+        //программа выдаёт соответствующее сообщение пользователю
+        if( flags >= ACCESS_COUNT )
+        {
+            throw std::runtime_error("In C++ there is no accessModifire like this");
+        }
+    }
+    //У классов С++ нет ни типа доступа, ни модификаторов
+    static void checkClass( Unit::Flags /* classAccess */, Unit::Flags /* classModifier */ ) {}
+    //Объявляем сам класс
+    template< class Out >
+    static void classOpen( Out& sink, unsigned int level, std::string_view name, Unit::Flags /* classAccess */, Unit::Flags /* classModifier */ )
+    {
+        writeShift( sink, level );
+        sink << CLASS_KEYWORD << name << " {\n";
+    }
+    //добавляем тип доступа перед группой методов
+    template< class Out >
+    static void sectionOpen( Out& sink, unsigned int /* level */, size_t access )
+    {
+        sink << ClassUnit::ACCESS_MODIFIERS[ access ] << ":\n";
+    }
+    //В С++ перед каждым методом тип доступа не пишется
+    template< class Out >
+    static void memberPrefix( Out& /* sink */, unsigned int /* level */, size_t /* access */ ) {}
+    template< class Out >
+    static void sectionClose( Out& sink, unsigned int /* level */ )
+    {
+        sink << "\n";
+    }
+    //закрываем сам класс
+    template< class Out >
+    static void classClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << CLASS_CLOSE;
+    }
+    //Проверка модификаторов метода: статический метод не может быть ни виртуальным, ни константным
+    static void checkMethod( Unit::Flags flags )
+    {
+        if( ( flags & MethodUnit::STATIC ) && ( flags & ( MethodUnit::VIRTUAL | MethodUnit::CONST ) ) )
+        {
+            throw std::runtime_error( "In C++ static method can not be virtual or const" );
+        }
+    }
+    //Модификаторы перед типом метода для набора флагов flags (берутся из таблицы)
+    static std::string_view methodPrefix( Unit::Flags flags )
+    {
+        static const ModifierTable table( []( Unit::Flags f )
+        {
+            std::string prefix;
+            if( f & MethodUnit::STATIC )
+            {
+                prefix += "static ";
+            }
+            else if( f & MethodUnit::VIRTUAL )
+            {
+                prefix += "virtual ";
+            }
+            return prefix;
+        } );
+        return table[ flags ];
+    }
+    //Объявление метода: отступ, модификаторы, тип, имя
+    template< class Out >
+    static void methodOpen( Out& sink, unsigned int level, std::string_view name, std::string_view returnType, Unit::Flags flags )
+    {
+        writeShift( sink, level );
+        sink << methodPrefix( flags ) << returnType << ' ' << name;
+        sink << ( ( flags & MethodUnit::CONST ) ? "() const {\n" : "() {\n" );
+    }
+    template< class Out >
+    static void methodClose( Out& sink, unsigned int level )
+    {
+        writeShift( sink, level );
+        sink << "}\n";
+    }
+    //Оператор вывода; текст экранируется по правилам строковых литералов языка (Escape.h)
+    template< class Out >
+    static void print( Out& sink, unsigned int level, std::string_view text )
+    {
+        writeShift( sink, level );
+        sink << PRINT_OPEN;
+        Escape::cpp( sink, text );
+        sink << PRINT_CLOSE;
+    }
+};
 
 //Класс, генерирующий конкретный класс на языке С++
 class PlussesClassUnit: public ClassUnit
 {
 public:
-    explicit PlussesClassUnit( const std::string& name ): ClassUnit(name)
+    //правила языка, по которым генерируется узел
+    using Syntax = PlussesSyntax;
+    explicit PlussesClassUnit( std::string_view name ): ClassUnit(name)
     {
         //У С++ иммется три типа доступа, поэтому размер меняем на три
-        m_fields.resize(3);
+        m_fields.resize(PlussesSyntax::ACCESS_COUNT);
     }
 
-    void add(const std::shared_ptr< Unit >& unit, Flags flags) override
+    void add(std::shared_ptr< Unit > unit, Flags flags) override
     {
         //Проверка существования объекта
         if(unit == nullptr)
@@ -20,49 +136,37 @@ public:
             return;
         }
 
-        //По умолчанию тип доступа в С++ - PRIVATE
-        int accessModifier = PRIVATE;
-        //Если указан другой тип доступа, меняем его
-        if(flags < 3)
-        {
-            accessModifier = flags;
-        }
-        //Если пришёл флаг, который больше, чем количество типов доступа,
-        //программа выдаёт соответствующее сообщение пользователю
-        else
-        {
-            throw std::runtime_error("In C++ there is no accessModifire like this");
-        }
+        //Проверяем, что такой тип доступа есть в С++
+        PlussesSyntax::checkAccess(flags);
         //Добавляем метод и его тип доступа
-        m_fields[accessModifier].push_back(unit);
+        addField< Syntax >(std::move(unit), flags);
     }
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        //Объявляем сам класс
-        std::string result = generateShift( level ) + "class " + m_name + " {\n";
-        //объявление метода, также в этом цикле определяются тела методов
-        //Здесь происходит сборка методов с одинаковыми типами доступа
-        for( size_t i = 0; i < m_fields.size(); ++i )
-        {
-            //тело метода может быть пустым
-            //и если это так, просто выходим из цикла
-            if( m_fields[ i ].empty() )
-            {
-                continue;
-            }
-            //добавляем тип доступа
-            result += ACCESS_MODIFIERS[ i ] + ":\n";
-            //Собираем методы с таким типом доступа
-            for( const auto& f : m_fields[ i ] )
-            {
-                result += f->compile( level + 1 );
-            }
-            result += "\n";
-        }
-        //закрываем сам класс
-        result += generateShift( level ) + "};\n";
-        return result;
+        compileClass< Syntax >( sink, level, 0, 0 );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureClass< Syntax >( level, 0, 0 );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenClass< Syntax >( sink, level, 0, 0 );
+    }
+    const Unit* stepChild( Sink& sink, unsigned int level, size_t index ) const override
+    {
+        return stepChildClass< Syntax >( sink, level, index );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseClass< Syntax >( sink, level );
+    }
+    std::shared_ptr< MethodUnit > newMethod( std::string_view name, std::string_view returnType, Flags flags ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags /* classAccess */, Flags /* classModifier */ ) const override
+    {
+        return makeUnit< PlussesClassUnit >( arena(), name );
     }
 };
 
@@ -70,45 +174,43 @@ public:
 class PlussesMethodUnit: public MethodUnit
 {
 public:
+    //правила языка, по которым генерируется узел
+    using Syntax = PlussesSyntax;
     //конструктор
-    explicit PlussesMethodUnit( const std::string& name, const std::string& returnType, Flags flags ): MethodUnit(name, returnType, flags){}
-    void add( const std::shared_ptr< Unit >& unit, Flags /* flags */ = 0 ) override
+    explicit PlussesMethodUnit( std::string_view name, std::string_view returnType, Flags flags ): MethodUnit(name, returnType, flags)
+    {
+        //Недопустимое сочетание модификаторов отклоняем сразу, а не при генерации
+        Syntax::checkMethod( flags );
+    }
+    void add( std::shared_ptr< Unit > unit, Flags /* flags */ = 0 ) override
     {
         //Допускаем, что тело функции может быть пустым
         if(unit != nullptr){
-            m_body.push_back( unit );
+            addBody< Syntax >( std::move( unit ) );
         }
     }
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        std::string result = generateShift( level );
-        //здесь добавляется имя метода и соответствующий модификатор
-        if( m_flags & STATIC )
-        {
-            result += "static ";
-        }
-
-        else if( m_flags & VIRTUAL )
-        {
-            result += "virtual ";
-        }
-
-        result += m_returnType + " ";
-        result += m_name + "()";
-
-        if( m_flags & CONST )
-        {
-            result += " const";
-        }
-        result += " {\n";
-        //Собираем тело метода
-        for( const auto& b : m_body )
-        {
-            result += b->compile( level + 1 );
-        }
-        result += generateShift( level ) + "}\n";
-        return result;
+        compileMethod< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measureMethod< Syntax >( level );
+    }
+protected:
+    size_t stepOpen( Sink& sink, unsigned int level ) const override
+    {
+        return stepOpenMethod< Syntax >( sink, level );
+    }
+    void stepClose( Sink& sink, unsigned int level ) const override
+    {
+        stepCloseMethod< Syntax >( sink, level );
+    }
+    std::shared_ptr< PrintOperatorUnit > newPrint( std::string text ) const override;
+    std::shared_ptr< ClassUnit > newClass( std::string_view name, Flags /* classAccess */, Flags /* classModifier */ ) const override
+    {
+        return makeUnit< PlussesClassUnit >( arena(), name );
     }
 };
 
@@ -116,12 +218,28 @@ public:
 class PlussesPrintOperatorUnit: public PrintOperatorUnit
 {
 public:
-    explicit PlussesPrintOperatorUnit( const std::string& text ): PrintOperatorUnit(text){}
+    //правила языка, по которым генерируется узел
+    using Syntax = PlussesSyntax;
+    explicit PlussesPrintOperatorUnit( std::string text ): PrintOperatorUnit(std::move(text)){}
 
-    std::string compile( unsigned int level = 0 ) const override
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
     {
-        return generateShift( level ) + "printf( \"" + m_text + "\" );\n";
+        compilePrint< Syntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measurePrint< Syntax >( level );
     }
 };
 
+//Узлы, которые создаются функциями emplace...(...), определены ниже своих родителей
+inline std::shared_ptr< MethodUnit > PlussesClassUnit::newMethod( std::string_view name, std::string_view returnType, Flags flags ) const
+{
+    return makeUnit< PlussesMethodUnit >( arena(), name, returnType, flags );
+}
+inline std::shared_ptr< PrintOperatorUnit > PlussesMethodUnit::newPrint( std::string text ) const
+{
+    return makeUnit< PlussesPrintOperatorUnit >( arena(), std::move( text ) );
+}
+
 #endif // PLUSES_H
@@ -0,0 +1,123 @@
+#ifndef PULLGENERATOR_H
+#define PULLGENERATOR_H
+#include "IterativeCompiler.h"
+
+//Генерация по запросу: код дерева Unit выдаётся кусками фиксированного размера или по строкам,
+//и только тогда, когда потребитель их просит
+//Обход идёт по шагам IterativeCompiler (Unit::stepOpen, stepChild, stepClose) по тем же правилам синтаксиса
+//языков, что и compile(), поэтому склеенные куски побайтно совпадают с compile()
+//Шаг выполняется, только когда в буфере не хватает текста для очередного куска, поэтому в памяти лежит
+//не больше куска и текста одного шага (заголовка класса или метода, оператора вывода;
+//при включённом запоминании текста - запомненного текста узла). Потребитель может остановиться в любой момент,
+//а пока он не просит следующий кусок, генерация стоит на месте
+//Дерево не должно меняться, пока генератор по нему идёт
+class PullGenerator
+{
+public:
+    static const size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+    explicit PullGenerator( const Unit& root, size_t chunkSize = DEFAULT_CHUNK_SIZE, unsigned int level = 0 ):
+        m_chunkSize( chunkSize ? chunkSize : 1 ), m_sink( m_buffer ), m_position( 0 ), m_produced( 0 )
+    {
+        m_buffer.reserve( m_chunkSize * 2 );
+        m_engine.start( root, m_sink, level );
+        m_running = true;
+    }
+    //Буфер и приёмник ссылаются друг на друга, поэтому генератор не копируется и не перемещается
+    PullGenerator( const PullGenerator& ) = delete;
+    PullGenerator& operator=( const PullGenerator& ) = delete;
+
+    //next(...) - следующий кусок длиной chunkSize (последний может быть короче)
+    //Возвращает false, когда текст кончился; chunk действителен до следующего вызова next(...) или nextLine(...)
+    bool next( std::string_view& chunk )
+    {
+        discardConsumed();
+        while( available() < m_chunkSize && advance() )
+        {
+        }
+        return take( std::min( available(), m_chunkSize ), chunk );
+    }
+    //nextLine(...) - следующая строка вместе с завершающим '\n' (у последней строки его может не быть)
+    bool nextLine( std::string_view& line )
+    {
+        discardConsumed();
+        size_t searched = 0;
+        for( ;; )
+        {
+            const size_t end = m_buffer.find( '\n', m_position + searched );
+            if( end != std::string::npos )
+            {
+                return take( end + 1 - m_position, line );
+            }
+            searched = available();
+            if( !advance() )
+            {
+                return take( available(), line );
+            }
+        }
+    }
+    //done() - весь текст уже выдан
+    bool done() const
+    {
+        return !m_running && available() == 0;
+    }
+    //produced() - сколько байт выдано потребителю
+    size_t produced() const
+    {
+        return m_produced;
+    }
+
+private:
+    size_t available() const
+    {
+        return m_buffer.size() - m_position;
+    }
+    //advance() - выполняет один шаг обхода; false - обход закончен
+    bool advance()
+    {
+        if( !m_running )
+        {
+            return false;
+        }
+        m_running = m_engine.step();
+        return true;
+    }
+    bool take( size_t size, std::string_view& result )
+    {
+        if( size == 0 )
+        {
+            return false;
+        }
+        result = std::string_view( m_buffer.data() + m_position, size );
+        m_position += size;
+        m_produced += size;
+        return true;
+    }
+    //discardConsumed() - убирает из буфера уже выданный текст; выделенная память остаётся для следующих шагов
+    //Остаток сдвигается, только когда выданное занимает не меньше половины буфера, иначе чтение
+    //большого запомненного текста по строкам сдвигало бы его на каждой строке
+    void discardConsumed()
+    {
+        if( m_position == m_buffer.size() )
+        {
+            m_buffer.clear();
+            m_position = 0;
+        }
+        else if( m_position * 2 >= m_buffer.size() )
+        {
+            m_buffer.erase( 0, m_position );
+            m_position = 0;
+        }
+    }
+
+    const size_t m_chunkSize;
+    std::string m_buffer;
+    StringSink m_sink;
+    IterativeCompiler m_engine;
+    //начало ещё не выданного текста в буфере
+    size_t m_position;
+    size_t m_produced;
+    bool m_running = false;
+};
+
+#endif // PULLGENERATOR_H
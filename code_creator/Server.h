@@ -0,0 +1,887 @@
+#ifndef SERVER_H
+#define SERVER_H
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <list>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include "Interning.h"
+#include "Spec.h"
+#include "ThreadPool.h"
+
+//Сервер генерации на локальном сокете (Unix domain socket)
+//Сборка вызывает генератор сотни раз; отдельный процесс на каждый вызов каждый раз платит за запуск
+//и строит все деревья заново. Сервер живёт между вызовами и держит тёплыми:
+// - готовый код классов верхнего уровня: ключ - текст класса в описании и язык (вытесняется по LRU в пределах объёма);
+// - общие узлы операторов вывода и методов каждого языка (InterningFactory): они неизменяемые и помнят свой текст
+//   для каждого уровня, поэтому в изменённом классе заново генерируются только изменившиеся методы;
+// - таблицу имён (Symbol), общую для всего процесса.
+//Описание режется на классы верхнего уровня по SpecReader::nesting(...), без построения деревьев;
+//деревья строятся только для классов, которых нет в кеше, и только для недостающих языков
+//Код каждого класса отправляется, как только он готов, не дожидаясь остального описания
+//Каждое соединение читает запросы в своём потоке, а в пул потоков попадает только генерация по запросу GENERATE,
+//поэтому молчащие постоянные клиенты не занимают пул. Число открытых соединений ограничено:
+//лишнее соединение получает ERROR и сразу закрывается
+//
+//Протокол: заголовки - строки текста, за заголовком с длиной следуют ровно столько байт данных
+//  GENERATE ЯЗЫКИ ДЛИНА\n<описание>    ЯЗЫКИ - через запятую из cpp, csharp, java
+//      -> CLASS ЯЗЫК ИМЯ ДЛИНА\n<код>  для каждого класса и каждого языка в порядке описания
+//      -> OK КЛАССЫ ПОПАДАНИЯ МИКРОСЕКУНДЫ\n  или  ERROR СООБЩЕНИЕ\n (код уже разобранных классов к этому времени отправлен)
+//  STATS\n     -> строки "ключ значение", затем OK\n
+//  SHUTDOWN\n  -> OK\n, после чего сервер закрывает соединения и run() возвращается
+//По одному соединению можно отправить любое число запросов подряд
+
+//Соединение: буферизованное чтение строк и данных заданной длины, запись через FdSink
+//Дескриптор не закрывает: им владеет создавший его код
+class SocketChannel
+{
+public:
+    explicit SocketChannel( int fd ): m_fd( fd ), m_position( 0 ), m_sink( fd ) {}
+    SocketChannel( const SocketChannel& ) = delete;
+    SocketChannel& operator=( const SocketChannel& ) = delete;
+
+    Sink& sink()
+    {
+        return m_sink;
+    }
+    void flush()
+    {
+        m_sink.flush();
+    }
+    //readLine(...) - следующая строка без '\n'; false, если соединение закрыто между строками
+    bool readLine( std::string& line )
+    {
+        for( ;; )
+        {
+            const size_t end = m_input.find( '\n', m_position );
+            if( end != std::string::npos )
+            {
+                line.assign( m_input, m_position, end - m_position );
+                m_position = end + 1;
+                return true;
+            }
+            if( !fill() )
+            {
+                if( m_position == m_input.size() )
+                {
+                    return false;
+                }
+                throw std::runtime_error( "Connection closed in the middle of a line" );
+            }
+        }
+    }
+    //read(...) - ровно size байт данных
+    void read( std::string& data, size_t size )
+    {
+        data.clear();
+        data.reserve( size );
+        for( ;; )
+        {
+            const size_t part = std::min( size - data.size(), m_input.size() - m_position );
+            data.append( m_input, m_position, part );
+            m_position += part;
+            if( data.size() == size )
+            {
+                return;
+            }
+            if( !fill() )
+            {
+                throw std::runtime_error( "Connection closed in the middle of data" );
+            }
+        }
+    }
+
+private:
+    static const size_t READ_SIZE = 64 * 1024;
+
+    //fill() - дочитывает данные из сокета; false - соединение закрыто
+    bool fill()
+    {
+        m_input.erase( 0, m_position );
+        m_position = 0;
+        const size_t used = m_input.size();
+        m_input.resize( used + READ_SIZE );
+        ssize_t count;
+        do
+        {
+            count = ::read( m_fd, &m_input[ used ], READ_SIZE );
+        }
+        while( count < 0 && errno == EINTR );
+        m_input.resize( used + static_cast< size_t >( std::max< ssize_t >( count, 0 ) ) );
+        if( count < 0 )
+        {
+            throw std::runtime_error( std::string( "Read from socket failed: " ) + std::strerror( errno ) );
+        }
+        return count > 0;
+    }
+
+    int m_fd;
+    std::string m_input;
+    //начало ещё не прочитанных данных в m_input
+    size_t m_position;
+    FdSink m_sink;
+};
+
+//socketAddress(...) - адрес локального сокета; путь ограничен размером sun_path
+inline sockaddr_un socketAddress( const std::string& path )
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if( path.empty() || path.size() >= sizeof( address.sun_path ) )
+    {
+        throw std::runtime_error( "Bad socket path '" + path + "'" );
+    }
+    std::memcpy( address.sun_path, path.c_str(), path.size() + 1 );
+    return address;
+}
+
+//Готовый код классов верхнего уровня с вытеснением давно не использованных (LRU)
+//Ключ - номер языка и текст класса в описании; объём считается по длине ключа и кода
+class ClassTextCache
+{
+public:
+    struct ClassText
+    {
+        std::string name;
+        std::string code;
+    };
+
+    explicit ClassTextCache( size_t capacity ): m_capacity( capacity ), m_bytes( 0 ), m_evictions( 0 ) {}
+
+    //find(...) - готовый код или nullptr; найденная запись становится самой свежей
+    std::shared_ptr< const ClassText > find( size_t language, const std::string& source )
+    {
+        const std::string key = makeKey( language, source );
+        std::lock_guard< std::mutex > lock( m_mutex );
+        auto found = m_index.find( key );
+        if( found == m_index.end() )
+        {
+            return nullptr;
+        }
+        m_entries.splice( m_entries.begin(), m_entries, found->second );
+        return found->second->text;
+    }
+    void insert( size_t language, const std::string& source, std::shared_ptr< const ClassText > text )
+    {
+        std::string key = makeKey( language, source );
+        const size_t bytes = key.size() + text->name.size() + text->code.size();
+        if( bytes > m_capacity )
+        {
+            return;
+        }
+        std::lock_guard< std::mutex > lock( m_mutex );
+        if( m_index.count( key ) != 0 )
+        {
+            return;
+        }
+        m_entries.push_front( Entry{ std::move( key ), std::move( text ), bytes } );
+        m_index.emplace( m_entries.front().key, m_entries.begin() );
+        m_bytes += bytes;
+        while( m_bytes > m_capacity )
+        {
+            Entry& oldest = m_entries.back();
+            m_bytes -= oldest.bytes;
+            m_index.erase( oldest.key );
+            m_entries.pop_back();
+            ++m_evictions;
+        }
+    }
+    size_t size() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_index.size();
+    }
+    size_t bytes() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_bytes;
+    }
+    size_t evictions() const
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        return m_evictions;
+    }
+
+private:
+    struct Entry
+    {
+        std::string key;
+        std::shared_ptr< const ClassText > text;
+        size_t bytes;
+    };
+
+    static std::string makeKey( size_t language, const std::string& source )
+    {
+        std::string key( 1, static_cast< char >( language ) );
+        key += source;
+        return key;
+    }
+
+    const size_t m_capacity;
+    mutable std::mutex m_mutex;
+    //от самой свежей записи к самой старой; ключи индекса указывают на строки внутри записей
+    std::list< Entry > m_entries;
+    std::unordered_map< std::string_view, std::list< Entry >::iterator > m_index;
+    size_t m_bytes;
+    size_t m_evictions;
+};
+
+class GenerationServer
+{
+public:
+    static const size_t DEFAULT_CACHE_BYTES = 256 * 1024 * 1024;
+    static const size_t DEFAULT_MAX_CONNECTIONS = 256;
+    //Сколько разных операторов вывода и методов одного языка хранить; при превышении таблицы начинаются заново
+    static const size_t INTERN_LIMIT = 1024 * 1024;
+
+    //path - путь сокета; оставшийся от упавшего сервера файл удаляется, а работающий сервер на том же пути - ошибка
+    //threads - сколько запросов GENERATE генерируется одновременно (0 - по числу ядер), остальные ждут очереди
+    //maxConnections - сколько соединений может быть открыто одновременно
+    explicit GenerationServer( std::string path, size_t threads = 0, size_t cacheBytes = DEFAULT_CACHE_BYTES,
+                               size_t maxConnections = DEFAULT_MAX_CONNECTIONS ):
+        m_path( std::move( path ) ), m_listen( -1 ), m_stopping( false ), m_cache( cacheBytes ),
+        m_maxConnections( maxConnections ? maxConnections : 1 ), m_pool( threads )
+    {
+        m_languages[ 0 ].factory = std::make_unique< PlussesFactory >();
+        m_languages[ 1 ].factory = std::make_unique< CSharpFactory >();
+        m_languages[ 2 ].factory = std::make_unique< JavaFactory >();
+        for( auto& language : m_languages )
+        {
+            language.interning = std::make_shared< InterningFactory >( *language.factory );
+        }
+        listen();
+    }
+    //Деструктор останавливает сервер, дожидается закрытия соединений и удаляет файл сокета
+    ~GenerationServer()
+    {
+        stop();
+        {
+            std::unique_lock< std::mutex > lock( m_connectionsMutex );
+            m_connectionsClosed.wait( lock, [ this ]{ return m_connections.empty(); } );
+        }
+        ::close( m_listen );
+        ::unlink( m_path.c_str() );
+    }
+    GenerationServer( const GenerationServer& ) = delete;
+    GenerationServer& operator=( const GenerationServer& ) = delete;
+
+    //run() - принимает соединения, пока не будет вызван stop() или не придёт запрос SHUTDOWN
+    void run()
+    {
+        //Клиент может закрыть соединение посреди ответа: ошибка записи обрабатывается, сигнал не нужен
+        std::signal( SIGPIPE, SIG_IGN );
+        while( !m_stopping.load() )
+        {
+            int fd = ::accept( m_listen, nullptr, nullptr );
+            if( fd < 0 )
+            {
+                if( m_stopping.load() )
+                {
+                    break;
+                }
+                if( errno == EINTR || errno == ECONNABORTED || errno == EMFILE || errno == ENFILE )
+                {
+                    continue;
+                }
+                throw std::runtime_error( std::string( "Accept failed: " ) + std::strerror( errno ) );
+            }
+            if( !open( fd ) )
+            {
+                reject( fd );
+                continue;
+            }
+            //Поток соединения большую часть времени ждёт в read(), поэтому он не из пула
+            try
+            {
+                std::thread( [ this, fd ]
+                {
+                    serve( fd );
+                } ).detach();
+            }
+            catch( const std::system_error& )
+            {
+                close( fd );
+            }
+        }
+    }
+    //stop() - прекращает приём соединений и закрывает открытые; можно вызывать из любого потока
+    void stop()
+    {
+        m_stopping.store( true );
+        std::lock_guard< std::mutex > lock( m_connectionsMutex );
+        //shutdown() будит поток, ждущий в accept() или read(), в отличие от close()
+        ::shutdown( m_listen, SHUT_RDWR );
+        for( int fd : m_connections )
+        {
+            ::shutdown( fd, SHUT_RDWR );
+        }
+    }
+
+    //stats() - счётчики в виде строк "ключ значение"
+    std::string stats() const
+    {
+        Counters c;
+        {
+            std::lock_guard< std::mutex > lock( m_statsMutex );
+            c = m_counters;
+        }
+        InterningFactory::Stats shared;
+        {
+            std::lock_guard< std::mutex > lock( m_languagesMutex );
+            for( const auto& language : m_languages )
+            {
+                const InterningFactory::Stats s = language.interning->stats();
+                shared.printRequests += s.printRequests;
+                shared.uniquePrints += s.uniquePrints;
+                shared.methodRequests += s.methodRequests;
+                shared.uniqueMethods += s.uniqueMethods;
+            }
+        }
+        std::ostringstream out;
+        size_t connections;
+        {
+            std::lock_guard< std::mutex > lock( m_connectionsMutex );
+            connections = m_connections.size();
+        }
+        out << "requests " << c.requests << "\n"
+            << "failed " << c.failed << "\n"
+            << "connections " << connections << "\n"
+            << "connections_rejected " << c.rejected << "\n"
+            << "classes " << c.classes << "\n"
+            << "cache_hits " << c.hits << "\n"
+            << "cache_misses " << c.misses << "\n"
+            << "cache_hit_rate " << ratio( c.hits, c.hits + c.misses ) << "\n"
+            << "cache_entries " << m_cache.size() << "\n"
+            << "cache_bytes " << m_cache.bytes() << "\n"
+            << "cache_evictions " << m_cache.evictions() << "\n"
+            << "print_requests " << shared.printRequests << "\n"
+            << "print_unique " << shared.uniquePrints << "\n"
+            << "print_hit_rate " << ratio( shared.printRequests - shared.uniquePrints, shared.printRequests ) << "\n"
+            << "method_requests " << shared.methodRequests << "\n"
+            << "method_unique " << shared.uniqueMethods << "\n"
+            << "method_hit_rate " << ratio( shared.methodRequests - shared.uniqueMethods, shared.methodRequests ) << "\n"
+            << "latency_avg_us " << ( c.requests ? c.totalMicros / c.requests : 0 ) << "\n"
+            << "latency_p50_us " << percentile( c, 0.5 ) << "\n"
+            << "latency_p99_us " << percentile( c, 0.99 ) << "\n"
+            << "latency_max_us " << c.maxMicros << "\n";
+        return out.str();
+    }
+
+    static const char* languageName( size_t language )
+    {
+        static const char* const NAMES[ LANGUAGE_COUNT ] = { "cpp", "csharp", "java" };
+        return NAMES[ language ];
+    }
+
+private:
+    static const size_t LANGUAGE_COUNT = 3;
+    //Описание больше этого размера не принимается, а соединение закрывается
+    static const size_t MAX_REQUEST = size_t( 1 ) << 30;
+    //Корзина k гистограммы задержек - от 2^k до 2^(k+1) микросекунд
+    static const size_t LATENCY_BUCKETS = 40;
+
+    struct Language
+    {
+        std::unique_ptr< AbstractFactory > factory;
+        std::shared_ptr< InterningFactory > interning;
+    };
+    struct Counters
+    {
+        size_t requests = 0;
+        size_t failed = 0;
+        size_t rejected = 0;
+        size_t classes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+        unsigned long long totalMicros = 0;
+        unsigned long long maxMicros = 0;
+        size_t latency[ LATENCY_BUCKETS ] = {};
+    };
+    //Итог одного запроса GENERATE
+    struct Outcome
+    {
+        size_t classes = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    static double ratio( size_t part, size_t total )
+    {
+        return total ? static_cast< double >( part ) / static_cast< double >( total ) : 0.0;
+    }
+    //percentile(...) - верхняя граница корзины, в которую попадает доля share запросов
+    static unsigned long long percentile( const Counters& c, double share )
+    {
+        size_t seen = 0;
+        for( size_t k = 0; k < LATENCY_BUCKETS; ++k )
+        {
+            seen += c.latency[ k ];
+            if( c.requests != 0 && static_cast< double >( seen ) >= share * static_cast< double >( c.requests ) )
+            {
+                return std::min( c.maxMicros, ( 2ull << k ) - 1 );
+            }
+        }
+        return c.maxMicros;
+    }
+
+    void listen()
+    {
+        const sockaddr_un address = socketAddress( m_path );
+        struct stat info;
+        if( ::lstat( m_path.c_str(), &info ) == 0 )
+        {
+            if( !S_ISSOCK( info.st_mode ) )
+            {
+                throw std::runtime_error( m_path + " exists and is not a socket" );
+            }
+            //Файл остался от сервера, который не завершился штатно, если к нему нельзя подключиться
+            int probe = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+            const bool alive = probe >= 0 && ::connect( probe, reinterpret_cast< const sockaddr* >( &address ), sizeof( address ) ) == 0;
+            ::close( probe );
+            if( alive )
+            {
+                throw std::runtime_error( "Another server is listening on " + m_path );
+            }
+            ::unlink( m_path.c_str() );
+        }
+        m_listen = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+        if( m_listen < 0 || ::bind( m_listen, reinterpret_cast< const sockaddr* >( &address ), sizeof( address ) ) != 0 ||
+            ::listen( m_listen, SOMAXCONN ) != 0 )
+        {
+            const int error = errno;
+            if( m_listen >= 0 )
+            {
+                ::close( m_listen );
+            }
+            throw std::runtime_error( "Can not listen on " + m_path + ": " + std::strerror( error ) );
+        }
+    }
+
+    //open(...) - запоминает соединение, если не превышен предел; false - соединение нужно отклонить
+    bool open( int fd )
+    {
+        std::lock_guard< std::mutex > lock( m_connectionsMutex );
+        if( m_connections.size() >= m_maxConnections )
+        {
+            return false;
+        }
+        m_connections.insert( fd );
+        return true;
+    }
+    //close(...) - забывает соединение и закрывает его
+    //Из списка убираем до close(): иначе stop() мог бы закрыть чужой дескриптор с тем же номером
+    void close( int fd )
+    {
+        std::lock_guard< std::mutex > lock( m_connectionsMutex );
+        m_connections.erase( fd );
+        ::close( fd );
+        //Уведомление под замком: после того как замок снят, поток соединения к серверу больше не обращается
+        m_connectionsClosed.notify_all();
+    }
+    //reject(...) - сообщает клиенту, что соединений слишком много, и закрывает соединение
+    void reject( int fd )
+    {
+        static const char MESSAGE[] = "ERROR too many connections\n";
+        ssize_t result;
+        do
+        {
+            result = ::write( fd, MESSAGE, sizeof( MESSAGE ) - 1 );
+        }
+        while( result < 0 && errno == EINTR );
+        ::close( fd );
+        std::lock_guard< std::mutex > lock( m_statsMutex );
+        ++m_counters.rejected;
+    }
+
+    //runOnPool(...) - выполняет job в пуле и ждёт окончания; исключение из job пробрасывается дальше
+    //TaskGroup здесь не подходит: ожидая, она выполняла бы в потоке соединения чужие задачи пула
+    void runOnPool( const std::function< void() >& job )
+    {
+        std::mutex mutex;
+        std::condition_variable finished;
+        bool done = false;
+        std::exception_ptr error;
+        m_pool.submit( [ & ]
+        {
+            try
+            {
+                job();
+            }
+            catch( ... )
+            {
+                error = std::current_exception();
+            }
+            //Уведомление под замком: иначе ожидающий мог бы уйти, и переменные были бы разрушены раньше времени
+            std::lock_guard< std::mutex > lock( mutex );
+            done = true;
+            finished.notify_all();
+        } );
+        std::unique_lock< std::mutex > lock( mutex );
+        finished.wait( lock, [ & ]{ return done; } );
+        if( error )
+        {
+            std::rethrow_exception( error );
+        }
+    }
+
+    //serve(...) - обслуживает одно соединение в его собственном потоке
+    void serve( int fd )
+    {
+        try
+        {
+            SocketChannel channel( fd );
+            std::string line;
+            while( !m_stopping.load() && channel.readLine( line ) )
+            {
+                std::istringstream words( line );
+                std::string command;
+                words >> command;
+                if( command == "GENERATE" )
+                {
+                    generate( words, channel );
+                }
+                else if( command == "STATS" )
+                {
+                    channel.sink() << stats() << "OK\n";
+                }
+                else if( command == "SHUTDOWN" )
+                {
+                    channel.sink() << "OK\n";
+                    channel.flush();
+                    stop();
+                    break;
+                }
+                else
+                {
+                    channel.sink() << "ERROR unknown command '" << command << "'\n";
+                }
+                channel.flush();
+            }
+        }
+        catch( const std::exception& )
+        {
+            //Соединение оборвано или запрос нельзя разобрать - просто закрываем его
+        }
+        close( fd );
+    }
+
+    void generate( std::istringstream& words, SocketChannel& channel )
+    {
+        std::string names;
+        size_t size;
+        if( !( words >> names >> size ) || size > MAX_REQUEST )
+        {
+            throw std::runtime_error( "Bad GENERATE request" );
+        }
+        std::string spec;
+        channel.read( spec, size );
+        const auto start = std::chrono::steady_clock::now();
+        Outcome outcome;
+        std::string error;
+        try
+        {
+            //Описание уже прочитано: в пул уходит только генерация
+            runOnPool( [ & ]
+            {
+                generate( languages( names ), spec, channel.sink(), outcome );
+            } );
+        }
+        catch( const std::exception& e )
+        {
+            error = e.what();
+        }
+        const unsigned long long micros = static_cast< unsigned long long >(
+            std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now() - start ).count() );
+        if( error.empty() )
+        {
+            channel.sink() << "OK " << std::to_string( outcome.classes ) << ' ' << std::to_string( outcome.hits ) << ' '
+                           << std::to_string( micros ) << '\n';
+        }
+        else
+        {
+            std::replace( error.begin(), error.end(), '\n', ' ' );
+            channel.sink() << "ERROR " << error << '\n';
+        }
+        record( outcome, micros, !error.empty() );
+    }
+
+    static std::vector< size_t > languages( const std::string& names )
+    {
+        std::vector< size_t > result;
+        std::stringstream list( names );
+        std::string name;
+        while( std::getline( list, name, ',' ) )
+        {
+            size_t language = 0;
+            while( language < LANGUAGE_COUNT && name != languageName( language ) )
+            {
+                ++language;
+            }
+            if( language == LANGUAGE_COUNT )
+            {
+                throw std::runtime_error( "unknown language " + name );
+            }
+            result.push_back( language );
+        }
+        if( result.empty() )
+        {
+            throw std::runtime_error( "no languages" );
+        }
+        return result;
+    }
+
+    //generate(...) - режет описание на классы верхнего уровня и отправляет код каждого, как только он готов
+    void generate( const std::vector< size_t >& targets, const std::string& spec, Sink& sink, Outcome& outcome )
+    {
+        std::istringstream in( spec );
+        std::string line, block;
+        size_t number = 0, firstLine = 0;
+        int depth = 0;
+        while( std::getline( in, line ) )
+        {
+            ++number;
+            const int change = SpecReader::nesting( line );
+            if( depth == 0 && change <= 0 )
+            {
+                const size_t first = line.find_first_not_of( " \t\r" );
+                if( first != std::string::npos && line[ first ] != '#' )
+                {
+                    //Строка вне класса - ошибка; сообщение о ней формирует SpecReader
+                    emitClass( targets, line + "\n", number, sink, outcome );
+                }
+                continue;
+            }
+            if( depth == 0 )
+            {
+                block.clear();
+                firstLine = number;
+            }
+            block += line;
+            block += '\n';
+            depth += change;
+            if( depth == 0 )
+            {
+                emitClass( targets, block, firstLine, sink, outcome );
+            }
+        }
+        if( depth != 0 )
+        {
+            emitClass( targets, block, firstLine, sink, outcome );
+        }
+    }
+
+    //emitClass(...) - код одного класса верхнего уровня (source - его текст в описании) на всех языках targets
+    void emitClass( const std::vector< size_t >& targets, const std::string& source, size_t firstLine, Sink& sink, Outcome& outcome )
+    {
+        std::vector< std::shared_ptr< const ClassTextCache::ClassText > > texts( targets.size() );
+        std::vector< size_t > missing;
+        for( size_t i = 0; i < targets.size(); ++i )
+        {
+            texts[ i ] = m_cache.find( targets[ i ], source );
+            if( texts[ i ] == nullptr )
+            {
+                missing.push_back( i );
+            }
+        }
+        if( !missing.empty() )
+        {
+            //Фабрики берутся под замком: таблица общих узлов может смениться, но эта остаётся жива до конца разбора
+            std::vector< std::shared_ptr< InterningFactory > > interning;
+            std::vector< const AbstractFactory* > factories;
+            for( size_t i : missing )
+            {
+                interning.push_back( internFactory( targets[ i ] ) );
+                factories.push_back( interning.back().get() );
+            }
+            SpecReader reader( factories, [ & ]( const std::vector< std::shared_ptr< Unit > >& units )
+            {
+                for( size_t k = 0; k < units.size(); ++k )
+                {
+                    auto text = std::make_shared< ClassTextCache::ClassText >();
+                    text->name = static_cast< const ClassUnit& >( *units[ k ] ).name().str();
+                    text->code = units[ k ]->compile();
+                    texts[ missing[ k ] ] = std::move( text );
+                }
+            } );
+            reader.setLineNumber( firstLine - 1 );
+            std::istringstream in( source );
+            reader.read( in );
+            for( size_t i : missing )
+            {
+                m_cache.insert( targets[ i ], source, texts[ i ] );
+            }
+        }
+        for( size_t i = 0; i < targets.size(); ++i )
+        {
+            sink << "CLASS " << languageName( targets[ i ] ) << ' ' << texts[ i ]->name << ' '
+                 << std::to_string( texts[ i ]->code.size() ) << '\n' << texts[ i ]->code;
+        }
+        ++outcome.classes;
+        outcome.hits += targets.size() - missing.size();
+        outcome.misses += missing.size();
+    }
+
+    std::shared_ptr< InterningFactory > internFactory( size_t language )
+    {
+        std::lock_guard< std::mutex > lock( m_languagesMutex );
+        Language& l = m_languages[ language ];
+        const InterningFactory::Stats s = l.interning->stats();
+        if( s.uniquePrints > INTERN_LIMIT || s.uniqueMethods > INTERN_LIMIT )
+        {
+            l.interning = std::make_shared< InterningFactory >( *l.factory );
+        }
+        return l.interning;
+    }
+
+    void record( const Outcome& outcome, unsigned long long micros, bool failed )
+    {
+        size_t bucket = 0;
+        while( bucket + 1 < LATENCY_BUCKETS && ( 2ull << bucket ) <= micros )
+        {
+            ++bucket;
+        }
+        std::lock_guard< std::mutex > lock( m_statsMutex );
+        ++m_counters.requests;
+        m_counters.failed += failed ? 1 : 0;
+        m_counters.classes += outcome.classes;
+        m_counters.hits += outcome.hits;
+        m_counters.misses += outcome.misses;
+        m_counters.totalMicros += micros;
+        m_counters.maxMicros = std::max( m_counters.maxMicros, micros );
+        ++m_counters.latency[ bucket ];
+    }
+
+    const std::string m_path;
+    int m_listen;
+    std::atomic< bool > m_stopping;
+    Language m_languages[ LANGUAGE_COUNT ];
+    mutable std::mutex m_languagesMutex;
+    ClassTextCache m_cache;
+    mutable std::mutex m_statsMutex;
+    Counters m_counters;
+    const size_t m_maxConnections;
+    mutable std::mutex m_connectionsMutex;
+    std::condition_variable m_connectionsClosed;
+    std::set< int > m_connections;
+    //Пул объявлен последним: его деструктор дожидается задач, пока остальные поля ещё живы
+    ThreadPool m_pool;
+};
+
+//Клиент сервера генерации; одно соединение на объект, запросы выполняются по очереди
+class GenerationClient
+{
+public:
+    //Итог запроса GENERATE по данным сервера
+    struct Result
+    {
+        size_t classes = 0;
+        size_t hits = 0;
+        unsigned long long serverMicros = 0;
+    };
+    //Обработчик кода одного класса на одном языке
+    using ClassHandler = std::function< void( const std::string& language, const std::string& name, const std::string& code ) >;
+
+    explicit GenerationClient( const std::string& path ): m_fd( ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 ) )
+    {
+        const sockaddr_un address = socketAddress( path );
+        if( m_fd < 0 || ::connect( m_fd, reinterpret_cast< const sockaddr* >( &address ), sizeof( address ) ) != 0 )
+        {
+            const int error = errno;
+            if( m_fd >= 0 )
+            {
+                ::close( m_fd );
+            }
+            throw std::runtime_error( "Can not connect to " + path + ": " + std::strerror( error ) );
+        }
+        m_channel = std::make_unique< SocketChannel >( m_fd );
+    }
+    ~GenerationClient()
+    {
+        m_channel.reset();
+        ::close( m_fd );
+    }
+    GenerationClient( const GenerationClient& ) = delete;
+    GenerationClient& operator=( const GenerationClient& ) = delete;
+
+    //generate(...) - генерирует код описания spec на языках languages ("cpp,java");
+    //handler вызывается для каждого класса по мере получения; ошибка сервера - исключение
+    Result generate( const std::string& languages, std::string_view spec, const ClassHandler& handler )
+    {
+        m_channel->sink() << "GENERATE " << languages << ' ' << std::to_string( spec.size() ) << '\n' << spec;
+        m_channel->flush();
+        std::string line, language, name, code;
+        for( ;; )
+        {
+            const std::string reply = readReply( line );
+            std::istringstream words( line );
+            std::string word;
+            words >> word;
+            if( reply == "CLASS" )
+            {
+                size_t size;
+                if( !( words >> language >> name >> size ) )
+                {
+                    throw std::runtime_error( "Bad server reply: " + line );
+                }
+                m_channel->read( code, size );
+                handler( language, name, code );
+                continue;
+            }
+            Result result;
+            if( !( words >> result.classes >> result.hits >> result.serverMicros ) )
+            {
+                throw std::runtime_error( "Bad server reply: " + line );
+            }
+            return result;
+        }
+    }
+    //stats() - счётчики сервера, строки "ключ значение"
+    std::string stats()
+    {
+        m_channel->sink() << "STATS\n";
+        m_channel->flush();
+        std::string result, line;
+        while( readReply( line ) != "OK" )
+        {
+            result += line;
+            result += '\n';
+        }
+        return result;
+    }
+    //shutdown() - останавливает сервер
+    void shutdown()
+    {
+        m_channel->sink() << "SHUTDOWN\n";
+        m_channel->flush();
+        std::string line;
+        readReply( line );
+    }
+
+private:
+    //readReply(...) - очередная строка ответа и её первое слово; ERROR превращается в исключение
+    std::string readReply( std::string& line )
+    {
+        if( !m_channel->readLine( line ) )
+        {
+            throw std::runtime_error( "Server closed the connection" );
+        }
+        if( line.compare( 0, 6, "ERROR " ) == 0 )
+        {
+            throw std::runtime_error( line.substr( 6 ) );
+        }
+        return line.substr( 0, line.find( ' ' ) );
+    }
+
+    int m_fd;
+    std::unique_ptr< SocketChannel > m_channel;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,273 @@
+#ifndef SINK_H
+#define SINK_H
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <unistd.h>
+
+//Приёмник сгенерированного кода
+//Вместо того, чтобы каждый узел дерева возвращал собственную строку std::string,
+//узлы дописывают свой текст прямо в приёмник, переданный вызывающей стороной
+//Так весь код попадает в один буфер (поток, файл) без промежуточных строк
+class Sink
+{
+public:
+    Sink(): m_written( 0 ) {}
+    //виртуальный деструктор
+    virtual ~Sink() = default;
+    //write(...) - дописывает size байт из data и учитывает их в счётчике written()
+    void write( const char* data, size_t size )
+    {
+        m_written += size;
+        writeData( data, size );
+    }
+    //written() - сколько байт записано в приёмник за всё время
+    size_t written() const
+    {
+        return m_written;
+    }
+    //Вспомогательные операторы, чтобы узлы могли писать цепочкой: sink << "class " << m_name;
+    Sink& operator<<( const std::string& text )
+    {
+        write( text.data(), text.size() );
+        return *this;
+    }
+    Sink& operator<<( std::string_view text )
+    {
+        write( text.data(), text.size() );
+        return *this;
+    }
+    Sink& operator<<( const char* text )
+    {
+        write( text, std::strlen( text ) );
+        return *this;
+    }
+    Sink& operator<<( char symbol )
+    {
+        write( &symbol, 1 );
+        return *this;
+    }
+protected:
+    //writeData(...) - чисто виртуальная функция, которую реализуют конкретные приёмники
+    virtual void writeData( const char* data, size_t size ) = 0;
+private:
+    size_t m_written;
+};
+
+//Приёмник, дописывающий код в строку, принадлежащую вызывающей стороне
+//Строка растёт сама, поэтому это и есть "растущий буфер"
+class StringSink: public Sink
+{
+public:
+    explicit StringSink( std::string& buffer ): m_buffer( buffer ) {}
+protected:
+    void writeData( const char* data, size_t size ) override
+    {
+        m_buffer.append( data, size );
+    }
+private:
+    std::string& m_buffer;
+};
+
+//Невиртуальный приёмник для генераторов, у которых тип приёмника известен на этапе компиляции
+//(см. Generator.h): все вызовы записи подставляются компилятором в место вызова
+class StringWriter
+{
+public:
+    explicit StringWriter( std::string& buffer ): m_buffer( buffer ) {}
+    void write( const char* data, size_t size )
+    {
+        m_buffer.append( data, size );
+    }
+    StringWriter& operator<<( const std::string& text )
+    {
+        m_buffer.append( text );
+        return *this;
+    }
+    StringWriter& operator<<( std::string_view text )
+    {
+        m_buffer.append( text.data(), text.size() );
+        return *this;
+    }
+    StringWriter& operator<<( const char* text )
+    {
+        m_buffer.append( text );
+        return *this;
+    }
+    StringWriter& operator<<( char symbol )
+    {
+        m_buffer.push_back( symbol );
+        return *this;
+    }
+private:
+    std::string& m_buffer;
+};
+
+//Невиртуальный счётчик байт с тем же интерфейсом, что у StringWriter
+//Правила синтаксиса, вызванные с ним вместо приёмника, ничего не копируют, а только считают длину текста
+//(см. Unit::measure(...))
+class SizeCounter
+{
+public:
+    SizeCounter(): m_size( 0 ) {}
+    void write( const char* /* data */, size_t size )
+    {
+        m_size += size;
+    }
+    SizeCounter& operator<<( const std::string& text )
+    {
+        m_size += text.size();
+        return *this;
+    }
+    SizeCounter& operator<<( std::string_view text )
+    {
+        m_size += text.size();
+        return *this;
+    }
+    SizeCounter& operator<<( const char* text )
+    {
+        m_size += std::strlen( text );
+        return *this;
+    }
+    SizeCounter& operator<<( char /* symbol */ )
+    {
+        ++m_size;
+        return *this;
+    }
+    //size() - сколько байт было бы записано
+    size_t size() const
+    {
+        return m_size;
+    }
+    //add(...) - учитывает размер, посчитанный отдельно (например, размер вложенного узла)
+    void add( size_t size )
+    {
+        m_size += size;
+    }
+private:
+    size_t m_size;
+};
+
+//Приёмник, который ничего не хранит; полезен, когда нужен только счётчик written()
+class NullSink: public Sink
+{
+protected:
+    void writeData( const char* /* data */, size_t /* size */ ) override {}
+};
+
+//Приёмник, пишущий в заранее выделенную область памяти фиксированного размера
+//(например, в отображённый в память файл, см. MappedFile.h)
+//Если данных больше, чем помещается в область, бросает исключение
+class MemorySink: public Sink
+{
+public:
+    MemorySink( char* memory, size_t capacity ): m_memory( memory ), m_capacity( capacity ), m_used( 0 ) {}
+    size_t used() const
+    {
+        return m_used;
+    }
+protected:
+    void writeData( const char* data, size_t size ) override
+    {
+        if( size > m_capacity - m_used )
+        {
+            throw std::runtime_error( "Memory sink overflow" );
+        }
+        std::memcpy( m_memory + m_used, data, size );
+        m_used += size;
+    }
+private:
+    char* m_memory;
+    size_t m_capacity;
+    size_t m_used;
+};
+
+//Приёмник, передающий код в стандартный поток вывода (std::cout, std::ofstream и т.д.)
+class OStreamSink: public Sink
+{
+public:
+    explicit OStreamSink( std::ostream& stream ): m_stream( stream ) {}
+protected:
+    void writeData( const char* data, size_t size ) override
+    {
+        m_stream.write( data, static_cast< std::streamsize >( size ) );
+    }
+private:
+    std::ostream& m_stream;
+};
+
+//Приёмник, пишущий в файловый дескриптор
+//Накапливает данные в собственном буфере фиксированного размера и сбрасывает их одним системным вызовом
+class FdSink: public Sink
+{
+public:
+    explicit FdSink( int fd ): m_fd( fd ), m_used( 0 ) {}
+    //Деструктор сбрасывает остаток буфера; исключения из деструктора не выпускаем
+    ~FdSink() override
+    {
+        try
+        {
+            flush();
+        }
+        catch( ... )
+        {
+        }
+    }
+    FdSink( const FdSink& ) = delete;
+    FdSink& operator=( const FdSink& ) = delete;
+
+    //flush() - отправляет накопленные данные в дескриптор
+    void flush()
+    {
+        size_t used = m_used;
+        m_used = 0;
+        writeAll( m_buffer, used );
+    }
+protected:
+    void writeData( const char* data, size_t size ) override
+    {
+        //Если данные не помещаются в буфер, сбрасываем его
+        if( m_used + size > BUFFER_SIZE )
+        {
+            flush();
+        }
+        //Большие куски пишем напрямую, минуя буфер
+        if( size >= BUFFER_SIZE )
+        {
+            writeAll( data, size );
+            return;
+        }
+        std::memcpy( m_buffer + m_used, data, size );
+        m_used += size;
+    }
+private:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    void writeAll( const char* data, size_t size )
+    {
+        while( size > 0 )
+        {
+            ssize_t written = ::write( m_fd, data, size );
+            if( written < 0 )
+            {
+                //Вызов прерван сигналом - просто повторяем
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+                throw std::runtime_error( std::string( "Write to file descriptor failed: " ) + std::strerror( errno ) );
+            }
+            data += written;
+            size -= static_cast< size_t >( written );
+        }
+    }
+
+    int m_fd;
+    size_t m_used;
+    char m_buffer[ BUFFER_SIZE ];
+};
+
+#endif // SINK_H
@@ -0,0 +1,327 @@
+#ifndef SPEC_H
+#define SPEC_H
+#include <istream>
+#include <sstream>
+#include <functional>
+#include "Factories.h"
+
+//Потоковый разбор текстового описания модели (spec)
+//Описание читается построчно; как только закрывается класс верхнего уровня, его деревья (по одному на каждую фабрику)
+//передаются обработчику, после чего читатель о них забывает. Поэтому в памяти одновременно находится
+//только один класс верхнего уровня, каким бы большим ни было всё описание
+//
+//Формат (одна конструкция на строку, отступы не важны, '#' в начале строки - комментарий):
+//  class ИМЯ [ДОСТУП] [МОДИФИКАТОРЫ]           - класс верхнего уровня или класс в теле метода
+//  ДОСТУП method ИМЯ ТИП [МОДИФИКАТОРЫ]        - метод класса
+//  ДОСТУП class ИМЯ [ДОСТУП] [МОДИФИКАТОРЫ]    - вложенный класс
+//  print ТЕКСТ                                 - оператор вывода в теле метода (ДОСТУП print ТЕКСТ - в классе)
+//  end                                         - закрывает последний открытый класс или метод
+//ДОСТУП: public, protected, private, internal, protected_internal, private_protected
+//МОДИФИКАТОРЫ: static, const, virtual, abstract, async, unsave, final, synchronized
+//ТЕКСТ - остаток строки после одного пробела; в нём понимаются \n, \t, \r и удвоенная обратная косая черта
+class SpecReader
+{
+public:
+    using Flags = Unit::Flags;
+    //Обработчик класса верхнего уровня: по дереву на каждую фабрику, в том же порядке
+    using ClassHandler = std::function< void( const std::vector< std::shared_ptr< Unit > >& ) >;
+
+    SpecReader( std::vector< const AbstractFactory* > factories, ClassHandler handler ):
+        m_factories( std::move( factories ) ), m_handler( std::move( handler ) ), m_line( 0 ), m_classes( 0 ) {}
+
+    //read(...) - читает описание до конца потока
+    void read( std::istream& in )
+    {
+        std::string line;
+        while( std::getline( in, line ) )
+        {
+            ++m_line;
+            try
+            {
+                parseLine( line );
+            }
+            catch( const std::exception& error )
+            {
+                throw std::runtime_error( "line " + std::to_string( m_line ) + ": " + error.what() );
+            }
+        }
+        if( !m_stack.empty() )
+        {
+            throw std::runtime_error( "line " + std::to_string( m_line ) + ": unexpected end of spec, missing 'end'" );
+        }
+    }
+    //classes() - сколько классов верхнего уровня обработано
+    size_t classes() const
+    {
+        return m_classes;
+    }
+    //setLineNumber(...) - номер последней прочитанной строки: когда описание читается по частям,
+    //сообщения об ошибках продолжают нумерацию всего описания
+    void setLineNumber( size_t line )
+    {
+        m_line = line;
+    }
+
+    //nesting(...) - как строка меняет вложенность: 1 - открывает класс или метод, -1 - 'end', 0 - остальные строки
+    //По ней описание можно разрезать на классы верхнего уровня, не строя деревьев (см. Server.h)
+    static int nesting( const std::string& line )
+    {
+        std::istringstream words( line );
+        std::string word;
+        if( !( words >> word ) || word[ 0 ] == '#' )
+        {
+            return 0;
+        }
+        if( word == "end" )
+        {
+            return -1;
+        }
+        if( isAccess( word ) && !( words >> word ) )
+        {
+            return 0;
+        }
+        return word == "class" || word == "method" ? 1 : 0;
+    }
+
+private:
+    enum FrameKind { CLASS_FRAME, METHOD_FRAME };
+    //Открытый класс или метод: узлы для всех фабрик
+    //Метод вкладывается в класс только после 'end' (с типом доступа memberAccess), когда фабрика
+    //уже видела его тело (AbstractFactory::finishMethod)
+    struct Frame
+    {
+        FrameKind kind;
+        std::vector< std::shared_ptr< Unit > > units;
+        Flags memberAccess;
+    };
+
+    void parseLine( const std::string& line )
+    {
+        std::istringstream words( line );
+        std::string word;
+        if( !( words >> word ) || word[ 0 ] == '#' )
+        {
+            return;
+        }
+        if( word == "end" )
+        {
+            closeFrame();
+            return;
+        }
+        //Внутри класса каждая конструкция начинается с типа доступа
+        Flags memberAccess = 0;
+        if( !m_stack.empty() && m_stack.back().kind == CLASS_FRAME )
+        {
+            memberAccess = access( word );
+            if( !( words >> word ) )
+            {
+                throw std::runtime_error( "member kind expected after access" );
+            }
+        }
+        if( word == "class" )
+        {
+            openClass( words, memberAccess );
+        }
+        else if( word == "method" )
+        {
+            if( m_stack.empty() || m_stack.back().kind != CLASS_FRAME )
+            {
+                throw std::runtime_error( "method outside of class" );
+            }
+            openMethod( words, memberAccess );
+        }
+        else if( word == "print" )
+        {
+            if( m_stack.empty() )
+            {
+                throw std::runtime_error( "print outside of class or method" );
+            }
+            addPrint( line, memberAccess );
+        }
+        else
+        {
+            throw std::runtime_error( "unknown construction '" + word + "'" );
+        }
+    }
+
+    void openClass( std::istringstream& words, Flags memberAccess )
+    {
+        std::string name;
+        if( !( words >> name ) )
+        {
+            throw std::runtime_error( "class name expected" );
+        }
+        Flags classAccess = ClassUnit::PUBLIC;
+        Flags modifier = 0;
+        std::string word;
+        bool first = true;
+        while( words >> word )
+        {
+            if( first && isAccess( word ) )
+            {
+                classAccess = access( word );
+            }
+            else
+            {
+                modifier |= this->modifier( word );
+            }
+            first = false;
+        }
+        Frame frame{ CLASS_FRAME, {}, memberAccess };
+        for( const AbstractFactory* factory : m_factories )
+        {
+            frame.units.push_back( factory->ClassCreator( name, classAccess, modifier ) );
+        }
+        attach( frame.units, memberAccess );
+        m_stack.push_back( std::move( frame ) );
+    }
+
+    void openMethod( std::istringstream& words, Flags memberAccess )
+    {
+        std::string name, returnType, word;
+        if( !( words >> name >> returnType ) )
+        {
+            throw std::runtime_error( "method name and return type expected" );
+        }
+        Flags flags = 0;
+        while( words >> word )
+        {
+            flags |= modifier( word );
+        }
+        Frame frame{ METHOD_FRAME, {}, memberAccess };
+        for( const AbstractFactory* factory : m_factories )
+        {
+            frame.units.push_back( factory->MethodCreator( name, returnType, flags ) );
+        }
+        m_stack.push_back( std::move( frame ) );
+    }
+
+    void addPrint( const std::string& line, Flags memberAccess )
+    {
+        //Текст - всё после слова print и одного пробела
+        size_t start = line.find( "print" ) + 5;
+        if( start < line.size() && ( line[ start ] == ' ' || line[ start ] == '\t' ) )
+        {
+            ++start;
+        }
+        const std::string text = unescape( line.substr( start ) );
+        std::vector< std::shared_ptr< Unit > > units;
+        for( const AbstractFactory* factory : m_factories )
+        {
+            units.push_back( factory->PrintOperatorCreator( text ) );
+        }
+        attach( units, memberAccess );
+    }
+
+    //attach(...) - добавляет новые узлы в открытый класс или метод
+    void attach( const std::vector< std::shared_ptr< Unit > >& units, Flags memberAccess )
+    {
+        if( m_stack.empty() )
+        {
+            return;
+        }
+        Frame& parent = m_stack.back();
+        for( size_t i = 0; i < units.size(); ++i )
+        {
+            parent.units[ i ]->add( units[ i ], memberAccess );
+        }
+    }
+
+    void closeFrame()
+    {
+        if( m_stack.empty() )
+        {
+            throw std::runtime_error( "'end' without open class or method" );
+        }
+        Frame frame = std::move( m_stack.back() );
+        m_stack.pop_back();
+        if( frame.kind == METHOD_FRAME )
+        {
+            for( size_t i = 0; i < frame.units.size(); ++i )
+            {
+                frame.units[ i ] = m_factories[ i ]->finishMethod( std::static_pointer_cast< MethodUnit >( std::move( frame.units[ i ] ) ) );
+            }
+            attach( frame.units, frame.memberAccess );
+            return;
+        }
+        if( m_stack.empty() )
+        {
+            ++m_classes;
+            m_handler( frame.units );
+        }
+    }
+
+    static bool isAccess( const std::string& word )
+    {
+        for( const char* name : ACCESS_NAMES )
+        {
+            if( word == name )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+    static Flags access( const std::string& word )
+    {
+        for( size_t i = 0; i < sizeof( ACCESS_NAMES ) / sizeof( ACCESS_NAMES[ 0 ] ); ++i )
+        {
+            if( word == ACCESS_NAMES[ i ] )
+            {
+                return static_cast< Flags >( i );
+            }
+        }
+        throw std::runtime_error( "unknown access '" + word + "'" );
+    }
+    static Flags modifier( const std::string& word )
+    {
+        for( size_t i = 0; i < sizeof( MODIFIER_NAMES ) / sizeof( MODIFIER_NAMES[ 0 ] ); ++i )
+        {
+            if( word == MODIFIER_NAMES[ i ] )
+            {
+                return 1u << i;
+            }
+        }
+        throw std::runtime_error( "unknown modifier '" + word + "'" );
+    }
+    static std::string unescape( const std::string& text )
+    {
+        std::string result;
+        result.reserve( text.size() );
+        for( size_t i = 0; i < text.size(); ++i )
+        {
+            if( text[ i ] != '\\' || i + 1 == text.size() )
+            {
+                result += text[ i ];
+                continue;
+            }
+            switch( text[ ++i ] )
+            {
+            case 'n':
+                result += '\n';
+                break;
+            case 't':
+                result += '\t';
+                break;
+            case 'r':
+                result += '\r';
+                break;
+            default:
+                result += text[ i ];
+            }
+        }
+        return result;
+    }
+
+    //Названия в том же порядке, что ClassUnit::AccessModifier и биты MethodUnit::Modifier
+    static constexpr const char* ACCESS_NAMES[] = { "public", "protected", "private", "internal", "protected_internal", "private_protected" };
+    static constexpr const char* MODIFIER_NAMES[] = { "static", "const", "virtual", "abstract", "async", "unsave", "final", "synchronized" };
+
+    std::vector< const AbstractFactory* > m_factories;
+    ClassHandler m_handler;
+    std::vector< Frame > m_stack;
+    size_t m_line;
+    size_t m_classes;
+};
+
+#endif // SPEC_H
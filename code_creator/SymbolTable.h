@@ -0,0 +1,206 @@
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
+class SymbolTable;
+
+//Символ - ссылка на строку, хранящуюся в таблице символов (SymbolTable) в единственном экземпляре
+//Занимает 8 байт, копируется без выделения памяти; одинаковые строки дают один и тот же символ,
+//поэтому символы одной таблицы сравниваются по адресу
+//Длина строки хранится в таблице прямо перед её символами
+class Symbol
+{
+public:
+    //Пустая строка
+    Symbol(): m_data( emptyData() ) {}
+    //Символ строки text из общей таблицы SymbolTable::global()
+    explicit Symbol( std::string_view text );
+
+    std::string_view view() const
+    {
+        uint32_t size;
+        std::memcpy( &size, m_data - sizeof( uint32_t ), sizeof( size ) );
+        return std::string_view( m_data, size );
+    }
+    operator std::string_view() const
+    {
+        return view();
+    }
+    std::string str() const
+    {
+        return std::string( view() );
+    }
+    size_t size() const
+    {
+        return view().size();
+    }
+    bool empty() const
+    {
+        return size() == 0;
+    }
+    bool operator==( const Symbol& other ) const
+    {
+        return m_data == other.m_data;
+    }
+    bool operator!=( const Symbol& other ) const
+    {
+        return m_data != other.m_data;
+    }
+    //хеш символа - хеш его адреса
+    size_t hash() const
+    {
+        return std::hash< const char* >()( m_data );
+    }
+
+private:
+    friend class SymbolTable;
+    explicit Symbol( const char* data ): m_data( data ) {}
+    static const char* emptyData()
+    {
+        //длина 0 и завершающий ноль
+        alignas( uint32_t ) static const char EMPTY[ sizeof( uint32_t ) + 1 ] = {};
+        return EMPTY + sizeof( uint32_t );
+    }
+    const char* m_data;
+};
+
+//Таблица символов (интернирование строк)
+//Каждая строка хранится один раз в больших блоках памяти, которые никогда не перемещаются и не освобождаются
+//до разрушения таблицы; повторный запрос той же строки не выделяет память
+//Таблица разбита на части со своими мьютексами, чтобы потоки, строящие деревья параллельно, не мешали друг другу
+class SymbolTable
+{
+public:
+    SymbolTable() = default;
+    SymbolTable( const SymbolTable& ) = delete;
+    SymbolTable& operator=( const SymbolTable& ) = delete;
+
+    //global() - общая таблица, которой пользуются узлы Unit и модель
+    //Никогда не разрушается, чтобы символы в статических объектах оставались действительными до конца программы
+    static SymbolTable& global()
+    {
+        static SymbolTable* table = new SymbolTable;
+        return *table;
+    }
+
+    //intern(...) - символ строки text
+    Symbol intern( std::string_view text )
+    {
+        if( text.empty() )
+        {
+            return Symbol();
+        }
+        if( text.size() > UINT32_MAX )
+        {
+            throw std::length_error( "Symbol is too long" );
+        }
+        const size_t hash = std::hash< std::string_view >()( text );
+        Shard& shard = m_shards[ ( hash >> 8 ) % SHARD_COUNT ];
+        std::lock_guard< std::mutex > lock( shard.mutex );
+        auto found = shard.symbols.find( text );
+        if( found != shard.symbols.end() )
+        {
+            return Symbol( found->data() );
+        }
+        const char* data = shard.store( text );
+        shard.symbols.insert( std::string_view( data, text.size() ) );
+        return Symbol( data );
+    }
+    //size() - сколько разных строк в таблице
+    size_t size() const
+    {
+        size_t result = 0;
+        for( const auto& shard : m_shards )
+        {
+            std::lock_guard< std::mutex > lock( shard.mutex );
+            result += shard.symbols.size();
+        }
+        return result;
+    }
+    //memoryUsage() - сколько байт занимают блоки со строками
+    size_t memoryUsage() const
+    {
+        size_t result = 0;
+        for( const auto& shard : m_shards )
+        {
+            std::lock_guard< std::mutex > lock( shard.mutex );
+            result += shard.reserved;
+        }
+        return result;
+    }
+
+private:
+    static const size_t SHARD_COUNT = 16;
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::unordered_set< std::string_view > symbols;
+        std::vector< std::unique_ptr< char[] > > blocks;
+        //блоки длинных строк
+        std::vector< std::unique_ptr< char[] > > large;
+        //занято байт в последнем блоке
+        size_t used = BLOCK_SIZE;
+        size_t reserved = 0;
+
+        //store(...) - копирует строку в блок: длина, символы, завершающий ноль; возвращает адрес символов
+        const char* store( std::string_view text )
+        {
+            const size_t need = sizeof( uint32_t ) + text.size() + 1;
+            //Записи выравниваются, чтобы длина перед строкой лежала по выровненному адресу
+            const size_t aligned = ( need + alignof( uint32_t ) - 1 ) & ~( alignof( uint32_t ) - 1 );
+            char* entry;
+            //Длинные строки получают собственный блок, чтобы не тратить впустую остаток общего
+            if( aligned > BLOCK_SIZE / 4 )
+            {
+                large.emplace_back( new char[ aligned ] );
+                entry = large.back().get();
+                reserved += aligned;
+            }
+            else
+            {
+                if( used + aligned > BLOCK_SIZE )
+                {
+                    blocks.emplace_back( new char[ BLOCK_SIZE ] );
+                    used = 0;
+                    reserved += BLOCK_SIZE;
+                }
+                entry = blocks.back().get() + used;
+                used += aligned;
+            }
+            const uint32_t size = static_cast< uint32_t >( text.size() );
+            std::memcpy( entry, &size, sizeof( size ) );
+            std::memcpy( entry + sizeof( size ), text.data(), text.size() );
+            entry[ sizeof( size ) + text.size() ] = '\0';
+            return entry + sizeof( size );
+        }
+    };
+
+    Shard m_shards[ SHARD_COUNT ];
+};
+
+inline Symbol::Symbol( std::string_view text ): Symbol( SymbolTable::global().intern( text ) ) {}
+
+namespace std
+{
+template<>
+struct hash< Symbol >
+{
+    size_t operator()( const Symbol& symbol ) const
+    {
+        return symbol.hash();
+    }
+};
+}
+
+#endif // SYMBOLTABLE_H
@@ -0,0 +1,295 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <exception>
+#include <memory>
+
+//Пул потоков фиксированного размера с перехватом работы (work stealing)
+//У каждого потока своя очередь задач: свои задачи поток берёт с конца очереди,
+//а когда они кончаются - забирает задачи из начала очередей других потоков
+class ThreadPool
+{
+public:
+    using Task = std::function< void() >;
+
+    //threads - число рабочих потоков; 0 означает "по числу ядер"
+    explicit ThreadPool( size_t threads = 0 ): m_pending( 0 ), m_waiting( 0 ), m_stop( false ), m_next( 0 )
+    {
+        if( threads == 0 )
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+        if( threads == 0 )
+        {
+            threads = 1;
+        }
+        for( size_t i = 0; i < threads; ++i )
+        {
+            m_queues.emplace_back( new Queue );
+        }
+        for( size_t i = 0; i < threads; ++i )
+        {
+            m_workers.emplace_back( &ThreadPool::workerLoop, this, i );
+        }
+    }
+    //Копировать пул нельзя
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+    //Деструктор дожидается окончания всех уже поставленных задач
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard< std::mutex > lock( m_sleepMutex );
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+        for( auto& w : m_workers )
+        {
+            w.join();
+        }
+    }
+
+    //число рабочих потоков
+    size_t size() const
+    {
+        return m_workers.size();
+    }
+
+    //submit(...) - ставит задачу в очередь
+    //Задача не должна выпускать исключения; если нужен результат или ошибка - используйте TaskGroup
+    //Задача, поставленная из рабочего потока, попадает в его собственную очередь
+    void submit( Task task )
+    {
+        size_t index = currentWorker() == this ? currentIndex() : m_next.fetch_add( 1 ) % m_queues.size();
+        //Счётчик увеличиваем заранее, чтобы он не ушёл в минус, если задачу заберут сразу после вставки
+        bool waiters;
+        {
+            std::lock_guard< std::mutex > lock( m_sleepMutex );
+            ++m_pending;
+            waiters = m_waiting > 0;
+        }
+        {
+            std::lock_guard< std::mutex > lock( m_queues[ index ]->mutex );
+            m_queues[ index ]->tasks.push_back( std::move( task ) );
+        }
+        m_wakeUp.notify_one();
+        //Ждущие группы (TaskGroup::wait()) тоже могут выполнить новую задачу
+        if( waiters )
+        {
+            m_workOrDone.notify_all();
+        }
+    }
+
+    //runPendingTask() - выполняет одну задачу из очередей пула в вызывающем потоке
+    //Возвращает false, если задач нет. Нужна тем, кто ждёт результатов и не хочет простаивать
+    bool runPendingTask()
+    {
+        Task task;
+        size_t own = currentWorker() == this ? currentIndex() : 0;
+        if( !take( own, task ) )
+        {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+    //waitForWork(...) - засыпает, пока в пуле нет задач и ready() возвращает false
+    //Кто делает ready() истинным, должен после этого вызвать wakeWaiters()
+    template< class Ready >
+    void waitForWork( Ready ready )
+    {
+        std::unique_lock< std::mutex > lock( m_sleepMutex );
+        ++m_waiting;
+        m_workOrDone.wait( lock, [ this, &ready ]{ return m_pending > 0 || ready(); } );
+        --m_waiting;
+    }
+    //wakeWaiters() - будит всех, кто ждёт в waitForWork(...), чтобы они проверили своё условие
+    void wakeWaiters()
+    {
+        {
+            std::lock_guard< std::mutex > lock( m_sleepMutex );
+        }
+        m_workOrDone.notify_all();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque< Task > tasks;
+    };
+
+    //Номер рабочего потока и пул, которому он принадлежит (для вызовов изнутри задач)
+    static ThreadPool*& currentWorker()
+    {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+    static size_t& currentIndex()
+    {
+        static thread_local size_t index = 0;
+        return index;
+    }
+
+    //take(...) - берёт задачу: сначала с конца своей очереди, затем с начала чужих
+    bool take( size_t own, Task& task )
+    {
+        {
+            std::lock_guard< std::mutex > lock( m_queues[ own ]->mutex );
+            if( !m_queues[ own ]->tasks.empty() )
+            {
+                task = std::move( m_queues[ own ]->tasks.back() );
+                m_queues[ own ]->tasks.pop_back();
+                taken();
+                return true;
+            }
+        }
+        for( size_t i = 1; i < m_queues.size(); ++i )
+        {
+            Queue& victim = *m_queues[ ( own + i ) % m_queues.size() ];
+            std::lock_guard< std::mutex > lock( victim.mutex );
+            if( !victim.tasks.empty() )
+            {
+                task = std::move( victim.tasks.front() );
+                victim.tasks.pop_front();
+                taken();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void taken()
+    {
+        std::lock_guard< std::mutex > lock( m_sleepMutex );
+        --m_pending;
+    }
+
+    void workerLoop( size_t index )
+    {
+        currentWorker() = this;
+        currentIndex() = index;
+        Task task;
+        while( true )
+        {
+            if( take( index, task ) )
+            {
+                task();
+                task = nullptr;
+                continue;
+            }
+            std::unique_lock< std::mutex > lock( m_sleepMutex );
+            m_wakeUp.wait( lock, [ this ]{ return m_stop || m_pending > 0; } );
+            if( m_stop && m_pending == 0 )
+            {
+                return;
+            }
+        }
+    }
+
+    std::vector< std::unique_ptr< Queue > > m_queues;
+    std::vector< std::thread > m_workers;
+    //защищает m_pending, m_waiting и m_stop; на нём спят потоки без работы и ждущие группы задач
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    std::condition_variable m_workOrDone;
+    size_t m_pending;
+    //сколько потоков спит в waitForWork(...)
+    size_t m_waiting;
+    bool m_stop;
+    //очередь, в которую попадёт следующая задача извне пула
+    std::atomic< size_t > m_next;
+};
+
+//Группа задач, которых можно дождаться
+//Пока группа ждёт, вызывающий поток сам выполняет задачи пула, поэтому ждать можно и изнутри задачи
+class TaskGroup
+{
+public:
+    explicit TaskGroup( ThreadPool& pool ): m_pool( pool ), m_state( std::make_shared< State >() ) {}
+    //Группу нельзя бросить с незавершёнными задачами: они ссылаются на её данные
+    ~TaskGroup()
+    {
+        try
+        {
+            wait();
+        }
+        catch( ... )
+        {
+        }
+    }
+    TaskGroup( const TaskGroup& ) = delete;
+    TaskGroup& operator=( const TaskGroup& ) = delete;
+
+    //run(...) - ставит задачу группы в пул
+    void run( ThreadPool::Task task )
+    {
+        std::shared_ptr< State > state = m_state;
+        ThreadPool* pool = &m_pool;
+        state->left.fetch_add( 1 );
+        m_pool.submit( [ state, pool, task ]()
+        {
+            try
+            {
+                task();
+            }
+            catch( ... )
+            {
+                std::lock_guard< std::mutex > lock( state->mutex );
+                if( !state->error )
+                {
+                    state->error = std::current_exception();
+                }
+            }
+            //Последняя задача группы будит тех, кто её ждёт
+            if( state->left.fetch_sub( 1 ) == 1 )
+            {
+                pool->wakeWaiters();
+            }
+        } );
+    }
+
+    //wait() - дожидается всех задач группы; первое исключение из задач пробрасывается дальше
+    void wait()
+    {
+        while( m_state->left.load() > 0 )
+        {
+            if( m_pool.runPendingTask() )
+            {
+                continue;
+            }
+            //Спим, пока группа не закончится или в пуле не появится задача, которую можно выполнить самим
+            m_pool.waitForWork( [ this ]{ return m_state->left.load() == 0; } );
+        }
+        std::exception_ptr error;
+        {
+            std::lock_guard< std::mutex > lock( m_state->mutex );
+            std::swap( error, m_state->error );
+        }
+        if( error )
+        {
+            std::rethrow_exception( error );
+        }
+    }
+
+private:
+    struct State
+    {
+        State(): left( 0 ) {}
+        std::atomic< size_t > left;
+        std::mutex mutex;
+        std::exception_ptr error;
+    };
+
+    ThreadPool& m_pool;
+    std::shared_ptr< State > m_state;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,180 @@
+#ifndef UNITARENA_H
+#define UNITARENA_H
+#include <memory>
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+#include "Abstractions.h"
+
+//Арена (пул памяти) для узлов дерева
+//Узлы размещаются подряд в больших блоках памяти, а не отдельным new на каждый узел
+//Арена владеет всеми созданными в ней узлами: они разрушаются вместе с ареной одним проходом,
+//а память возвращается целыми блоками
+//Пользователи арены получают невладеющие указатели (handle), которые не должны переживать саму арену
+class UnitArena
+{
+public:
+    explicit UnitArena( size_t blockSize = DEFAULT_BLOCK_SIZE ): m_blockSize( blockSize ), m_current( nullptr ), m_left( 0 ), m_last( nullptr ), m_count( 0 ) {}
+    //Копировать арену нельзя - она единственный владелец своих узлов
+    UnitArena( const UnitArena& ) = delete;
+    UnitArena& operator=( const UnitArena& ) = delete;
+    ~UnitArena()
+    {
+        clear();
+    }
+
+    //create(...) - создаёт объект типа T прямо в памяти арены и возвращает обычный указатель на него
+    template< class T, class... Args >
+    T* create( Args&&... args )
+    {
+        //Перед объектом лежит заголовок, через который арена потом вызовет деструктор
+        void* memory = allocate( sizeof( Header ) + offsetOf< T >() + sizeof( T ), alignof( Header ) > alignof( T ) ? alignof( Header ) : alignof( T ) );
+        Header* header = static_cast< Header* >( memory );
+        T* object = new( static_cast< char* >( memory ) + sizeof( Header ) + offsetOf< T >() ) T( std::forward< Args >( args )... );
+        header->destroy = &destroyObject< T >;
+        header->detach = detachFunction< T >( std::is_base_of< Unit, T >() );
+        header->object = object;
+        header->previous = m_last;
+        place( object, std::is_base_of< Unit, T >() );
+        m_last = header;
+        ++m_count;
+        return object;
+    }
+
+    //make(...) - то же самое, но результат упакован в невладеющий shared_ptr
+    //У такого указателя нет блока подсчёта ссылок, поэтому его копирование (например, в add(...))
+    //не выделяет память и не трогает атомарный счётчик
+    template< class T, class... Args >
+    std::shared_ptr< T > make( Args&&... args )
+    {
+        return handle( create< T >( std::forward< Args >( args )... ) );
+    }
+
+    //handle(...) - оборачивает узел арены в невладеющий shared_ptr
+    template< class T >
+    static std::shared_ptr< T > handle( T* object )
+    {
+        return std::shared_ptr< T >( std::shared_ptr< T >(), object );
+    }
+
+    //clear() - разрушает все узлы (в обратном порядке создания) и освобождает блоки памяти
+    //Узлы Unit сначала отвязываются друг от друга, чтобы порядок разрушения не имел значения
+    void clear()
+    {
+        for( Header* header = m_last; header != nullptr; header = header->previous )
+        {
+            if( header->detach != nullptr )
+            {
+                header->detach( header->object );
+            }
+        }
+        for( Header* header = m_last; header != nullptr; header = header->previous )
+        {
+            header->destroy( header->object );
+        }
+        m_last = nullptr;
+        m_count = 0;
+        m_blocks.clear();
+        m_current = nullptr;
+        m_left = 0;
+    }
+
+    //Количество живых узлов в арене
+    size_t size() const
+    {
+        return m_count;
+    }
+
+private:
+    static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    //Заголовок перед каждым объектом: односвязный список для вызова деструкторов
+    struct Header
+    {
+        void ( *destroy )( void* );
+        void ( *detach )( void* );
+        void* object;
+        Header* previous;
+    };
+
+    template< class T >
+    static void destroyObject( void* object )
+    {
+        static_cast< T* >( object )->~T();
+    }
+
+    //Для узлов Unit - функция, отвязывающая узел от соседей перед разрушением арены
+    template< class T >
+    static void detachObject( void* object )
+    {
+        static_cast< T* >( object )->detachLinks();
+    }
+    template< class T >
+    static void ( *detachFunction( std::true_type ) )( void* )
+    {
+        return &detachObject< T >;
+    }
+    template< class T >
+    static void ( *detachFunction( std::false_type ) )( void* )
+    {
+        return nullptr;
+    }
+
+    //place(...) - узел Unit запоминает арену, чтобы его дети, созданные через emplace...(...), попали туда же
+    void place( Unit* unit, std::true_type )
+    {
+        unit->m_arena = this;
+    }
+    void place( void*, std::false_type ) {}
+
+    //Смещение объекта после заголовка, чтобы объект был правильно выровнен
+    template< class T >
+    static constexpr size_t offsetOf()
+    {
+        return ( alignof( T ) - sizeof( Header ) % alignof( T ) ) % alignof( T );
+    }
+
+    void* allocate( size_t size, size_t alignment )
+    {
+        size_t padding = m_current ? ( alignment - reinterpret_cast< size_t >( m_current ) % alignment ) % alignment : 0;
+        if( m_current == nullptr || padding + size > m_left )
+        {
+            //Слишком большие объекты получают собственный блок
+            size_t blockSize = size + alignment > m_blockSize ? size + alignment : m_blockSize;
+            m_blocks.emplace_back( new char[ blockSize ] );
+            m_current = m_blocks.back().get();
+            m_left = blockSize;
+            padding = ( alignment - reinterpret_cast< size_t >( m_current ) % alignment ) % alignment;
+        }
+        char* result = m_current + padding;
+        m_current = result + size;
+        m_left -= padding + size;
+        return result;
+    }
+
+    //размер одного блока
+    size_t m_blockSize;
+    //все выделенные блоки памяти
+    std::vector< std::unique_ptr< char[] > > m_blocks;
+    //свободное место в текущем блоке
+    char* m_current;
+    size_t m_left;
+    //последний созданный объект (начало списка деструкторов)
+    Header* m_last;
+    size_t m_count;
+};
+
+//makeUnit(...) - создаёт узел в арене arena, если она есть, иначе - в куче одним выделением памяти
+template< class T, class... Args >
+std::shared_ptr< T > makeUnit( UnitArena* arena, Args&&... args )
+{
+    if( arena != nullptr )
+    {
+        return arena->make< T >( std::forward< Args >( args )... );
+    }
+    return std::make_shared< T >( std::forward< Args >( args )... );
+}
+
+#endif // UNITARENA_H
@@ -0,0 +1,121 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <sstream>
+#include <sys/resource.h>
+
+//Счётчик выделений памяти в куче
+//Увеличивается замещённым operator new в main.cpp программы замеров
+inline std::atomic< unsigned long long >& allocationCounter()
+{
+    static std::atomic< unsigned long long > counter( 0 );
+    return counter;
+}
+
+//Пиковый объём резидентной памяти процесса в килобайтах
+inline long peakRssKb()
+{
+    struct rusage usage;
+    if( getrusage( RUSAGE_SELF, &usage ) != 0 )
+    {
+        return -1;
+    }
+    return usage.ru_maxrss;
+}
+
+//Результат одного замера: лучшее время из нескольких повторов и число выделений памяти за один повтор
+struct Measurement
+{
+    double seconds = 0;
+    unsigned long long allocations = 0;
+};
+
+//measure(...) - запускает run repeat раз и возвращает лучший результат
+template< class Run >
+Measurement measure( size_t repeat, Run run )
+{
+    Measurement best;
+    best.seconds = 1e100;
+    for( size_t i = 0; i < repeat; ++i )
+    {
+        unsigned long long allocationsBefore = allocationCounter().load();
+        auto start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        unsigned long long allocations = allocationCounter().load() - allocationsBefore;
+        if( seconds < best.seconds )
+        {
+            best.seconds = seconds;
+            best.allocations = allocations;
+        }
+    }
+    return best;
+}
+
+//Простой построитель JSON-объекта: поля добавляются по одному, вложенные объекты - готовым текстом
+class JsonObject
+{
+public:
+    JsonObject& field( const std::string& name, const std::string& value )
+    {
+        return raw( name, quote( value ) );
+    }
+    JsonObject& field( const std::string& name, const char* value )
+    {
+        return raw( name, quote( value ) );
+    }
+    JsonObject& field( const std::string& name, double value )
+    {
+        std::ostringstream text;
+        text.precision( 12 );
+        text << value;
+        return raw( name, text.str() );
+    }
+    JsonObject& field( const std::string& name, unsigned long long value )
+    {
+        return raw( name, std::to_string( value ) );
+    }
+    JsonObject& field( const std::string& name, long value )
+    {
+        return raw( name, std::to_string( value ) );
+    }
+    JsonObject& field( const std::string& name, size_t value )
+    {
+        return raw( name, std::to_string( value ) );
+    }
+    JsonObject& field( const std::string& name, bool value )
+    {
+        return raw( name, value ? "true" : "false" );
+    }
+    //raw(...) - поле, значение которого уже записано в формате JSON (объект, массив)
+    JsonObject& raw( const std::string& name, const std::string& json )
+    {
+        m_text += m_text.empty() ? "{" : ", ";
+        m_text += quote( name ) + ": " + json;
+        return *this;
+    }
+    std::string str() const
+    {
+        return m_text.empty() ? "{}" : m_text + "}";
+    }
+
+    static std::string quote( const std::string& value )
+    {
+        std::string result = "\"";
+        for( char c : value )
+        {
+            if( c == '"' || c == '\\' )
+            {
+                result += '\\';
+            }
+            result += c;
+        }
+        return result + "\"";
+    }
+private:
+    std::string m_text;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,144 @@
+#ifndef SYNTHETICTREE_H
+#define SYNTHETICTREE_H
+#include "Interning.h"
+#include "Model.h"
+
+//Параметры синтетического дерева для замеров
+struct TreeShape
+{
+    //число классов верхнего уровня
+    size_t classes = 100;
+    //методов в каждом классе
+    size_t methods = 100;
+    //операторов вывода в теле каждого метода
+    size_t statements = 4;
+    //глубина вложенности: первый метод каждого класса содержит вложенный класс того же вида,
+    //и так до заданной глубины (1 - без вложенных классов)
+    size_t depth = 1;
+};
+
+//Генератор синтетических деревьев одной и той же формы через фабрику (Unit) или в виде модели (Model.h)
+class SyntheticTree
+{
+public:
+    explicit SyntheticTree( const TreeShape& shape ): m_shape( shape ) {}
+
+    //buildUnits(...) - строит classes деревьев Unit фабрикой factory и считает созданные узлы
+    std::vector< std::shared_ptr< Unit > > buildUnits( const AbstractFactory& factory, size_t& nodes ) const
+    {
+        std::vector< std::shared_ptr< Unit > > result;
+        result.reserve( m_shape.classes );
+        for( size_t c = 0; c < m_shape.classes; ++c )
+        {
+            result.push_back( buildUnitClass( factory, "Class" + std::to_string( c ), m_shape.depth, nodes ) );
+        }
+        return result;
+    }
+
+    //buildUnitsInPlace(...) - те же деревья, но методы и операторы вывода создаются прямо в родителях (emplace...(...))
+    std::vector< std::shared_ptr< Unit > > buildUnitsInPlace( const AbstractFactory& factory, size_t& nodes ) const
+    {
+        std::vector< std::shared_ptr< Unit > > result;
+        result.reserve( m_shape.classes );
+        for( size_t c = 0; c < m_shape.classes; ++c )
+        {
+            auto unitClass = factory.ClassCreator( "Class" + std::to_string( c ), ClassUnit::PUBLIC, 0 );
+            ++nodes;
+            fillUnitClass( *unitClass, "Class" + std::to_string( c ), m_shape.depth, nodes );
+            result.push_back( std::move( unitClass ) );
+        }
+        return result;
+    }
+
+    //buildModel() - то же самое в виде модели, не зависящей от языка
+    std::vector< ModelNode::Ptr > buildModel() const
+    {
+        std::vector< ModelNode::Ptr > result;
+        result.reserve( m_shape.classes );
+        for( size_t c = 0; c < m_shape.classes; ++c )
+        {
+            result.push_back( buildModelClass( "Class" + std::to_string( c ), m_shape.depth ) );
+        }
+        return result;
+    }
+
+private:
+    //Модификаторы методов подбираются так, чтобы они были допустимы во всех трёх языках
+    static Unit::Flags methodFlags( size_t index )
+    {
+        return index % 2 ? MethodUnit::STATIC : 0;
+    }
+    static Unit::Flags methodAccess( size_t index )
+    {
+        return static_cast< Unit::Flags >( index % 3 );
+    }
+
+    std::shared_ptr< Unit > buildUnitClass( const AbstractFactory& factory, const std::string& name, size_t depth, size_t& nodes ) const
+    {
+        auto unitClass = factory.ClassCreator( name, ClassUnit::PUBLIC, 0 );
+        ++nodes;
+        for( size_t m = 0; m < m_shape.methods; ++m )
+        {
+            auto method = factory.MethodCreator( "method" + std::to_string( m ), "void", methodFlags( m ) );
+            ++nodes;
+            for( size_t s = 0; s < m_shape.statements; ++s )
+            {
+                method->add( factory.PrintOperatorCreator( "statement " + std::to_string( s ) ) );
+                ++nodes;
+            }
+            if( m == 0 && depth > 1 )
+            {
+                method->add( buildUnitClass( factory, name + "Nested", depth - 1, nodes ) );
+            }
+            //Фабрика с объединением узлов отдаёт единственный экземпляр одинаковых методов
+            if( const auto* interning = dynamic_cast< const InterningFactory* >( &factory ) )
+            {
+                method = interning->internMethod( method );
+            }
+            unitClass->add( std::move( method ), methodAccess( m ) );
+        }
+        return unitClass;
+    }
+
+    void fillUnitClass( ClassUnit& unitClass, const std::string& name, size_t depth, size_t& nodes ) const
+    {
+        for( size_t m = 0; m < m_shape.methods; ++m )
+        {
+            MethodUnit& method = unitClass.emplaceMethod( methodAccess( m ), "method" + std::to_string( m ), "void", methodFlags( m ) );
+            ++nodes;
+            for( size_t s = 0; s < m_shape.statements; ++s )
+            {
+                method.emplacePrint( "statement " + std::to_string( s ) );
+                ++nodes;
+            }
+            if( m == 0 && depth > 1 )
+            {
+                ++nodes;
+                fillUnitClass( method.emplaceClass( name + "Nested", ClassUnit::PUBLIC ), name + "Nested", depth - 1, nodes );
+            }
+        }
+    }
+
+    ModelNode::Ptr buildModelClass( const std::string& name, size_t depth ) const
+    {
+        auto modelClass = std::make_shared< ModelClass >( name, ClassUnit::PUBLIC );
+        for( size_t m = 0; m < m_shape.methods; ++m )
+        {
+            auto method = std::make_shared< ModelMethod >( "method" + std::to_string( m ), "void", methodFlags( m ) );
+            for( size_t s = 0; s < m_shape.statements; ++s )
+            {
+                method->add( std::make_shared< ModelPrint >( "statement " + std::to_string( s ) ) );
+            }
+            if( m == 0 && depth > 1 )
+            {
+                method->add( buildModelClass( name + "Nested", depth - 1 ) );
+            }
+            modelClass->add( method, methodAccess( m ) );
+        }
+        return modelClass;
+    }
+
+    TreeShape m_shape;
+};
+
+#endif // SYNTHETICTREE_H
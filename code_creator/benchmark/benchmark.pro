@@ -0,0 +1,15 @@
+QT -= core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+#Набор замеров генератора; собирается отдельно от основной программы
+#Заголовки генератора берутся из родительского каталога
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+    Metrics.h \
+    SyntheticTree.h
@@ -0,0 +1,338 @@
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <sys/wait.h>
+#include "Backends.h"
+#include "Generator.h"
+#include "CompactTree.h"
+#include "CompactImage.h"
+#include "SyntheticTree.h"
+#include "Metrics.h"
+
+//Набор замеров генератора для трёх языков
+//Для каждого языка отдельно измеряются:
+// - построение деревьев Unit фабрикой (узлов в секунду, выделений памяти на узел);
+// - compile() построенных деревьев (байт в секунду, выделений памяти на байт);
+// - генерация из модели через Backend (виртуальные вызовы) и через Generator<Traits> (шаблоны);
+// - построение компактного дерева (CompactTree.h), его размер и генерация по нему;
+// - сохранение компактного дерева в двоичный образ (CompactImage.h), его загрузка и генерация по отображённому файлу;
+// - построение и compile() деревьев с объединением одинаковых узлов (Interning.h);
+// - построение тех же деревьев функциями emplace...(...), создающими узлы прямо в родителях;
+// - пиковый объём памяти процесса.
+//Каждый язык замеряется в отдельном дочернем процессе, чтобы пиковая память не смешивалась
+//Результат выводится в формате JSON
+//Параметры: --classes N --methods N --statements N --depth N --repeat N --output FILE
+
+//Замещённые операторы выделения памяти считают выделения (см. allocationCounter())
+//noinline не даёт компилятору подставить free() в место вызова delete и ошибочно сообщить о несоответствии new/free
+__attribute__(( noinline )) void* operator new( size_t size )
+{
+    allocationCounter().fetch_add( 1, std::memory_order_relaxed );
+    if( void* memory = std::malloc( size ? size : 1 ) )
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+__attribute__(( noinline )) void operator delete( void* memory ) noexcept
+{
+    std::free( memory );
+}
+__attribute__(( noinline )) void operator delete( void* memory, size_t ) noexcept
+{
+    std::free( memory );
+}
+
+//Описание языка для замеров
+struct Language
+{
+    const char* name;
+    std::shared_ptr< AbstractFactory > factory;
+    std::shared_ptr< Backend > backend;
+    //генерация из модели шаблонным генератором
+    void ( *generate )( std::string&, const std::vector< ModelNode::Ptr >& );
+    //генерация по компактному дереву
+    void ( *generateCompact )( std::string&, const CompactView& );
+};
+
+template< class Traits >
+static void generateStatic( std::string& result, const std::vector< ModelNode::Ptr >& model )
+{
+    StringWriter out( result );
+    for( const auto& c : model )
+    {
+        Generator< Traits >::emit( out, *c );
+    }
+}
+
+template< class Traits >
+static void generateCompact( std::string& result, const CompactView& tree )
+{
+    StringWriter out( result );
+    CompactGenerator< Traits >::emitAll( out, tree );
+}
+
+static JsonObject throughput( const Measurement& m, size_t bytes )
+{
+    JsonObject result;
+    result.field( "bytes", bytes )
+          .field( "seconds", m.seconds )
+          .field( "bytes_per_sec", bytes / m.seconds )
+          .field( "allocations", m.allocations )
+          .field( "allocations_per_byte", bytes ? double( m.allocations ) / bytes : 0.0 );
+    return result;
+}
+
+//benchmarkLanguage(...) - все замеры для одного языка; возвращает JSON-объект с результатами
+static std::string benchmarkLanguage( const Language& language, const TreeShape& shape, size_t repeat )
+{
+    SyntheticTree generator( shape );
+    //Построение деревьев фабрикой
+    std::vector< std::shared_ptr< Unit > > trees;
+    size_t nodes = 0;
+    Measurement construction = measure( repeat, [ & ]
+    {
+        trees.clear();
+        nodes = 0;
+        trees = generator.buildUnits( *language.factory, nodes );
+    } );
+    //compile() каждого класса
+    size_t bytes = 0;
+    Measurement compile = measure( repeat, [ & ]
+    {
+        bytes = 0;
+        for( const auto& t : trees )
+        {
+            bytes += t->compile().size();
+        }
+    } );
+    //То же самое с объединением одинаковых узлов
+    std::vector< std::shared_ptr< Unit > > internedTrees;
+    size_t internedNodes = 0;
+    Measurement internedConstruction = measure( repeat, [ & ]
+    {
+        internedTrees.clear();
+        internedNodes = 0;
+        InterningFactory interning( *language.factory );
+        internedTrees = generator.buildUnits( interning, internedNodes );
+    } );
+    size_t internedBytes = 0;
+    Measurement internedCompile = measure( repeat, [ & ]
+    {
+        internedBytes = 0;
+        for( const auto& t : internedTrees )
+        {
+            internedBytes += t->compile().size();
+        }
+    } );
+    //Построение с созданием узлов прямо в родителях
+    std::vector< std::shared_ptr< Unit > > inPlaceTrees;
+    size_t inPlaceNodes = 0;
+    Measurement inPlaceConstruction = measure( repeat, [ & ]
+    {
+        inPlaceTrees.clear();
+        inPlaceNodes = 0;
+        inPlaceTrees = generator.buildUnitsInPlace( *language.factory, inPlaceNodes );
+    } );
+    //Генерация из модели: виртуальные вызовы против шаблонов
+    auto model = generator.buildModel();
+    std::string virtualResult, templateResult;
+    Measurement virtualEmit = measure( repeat, [ & ]
+    {
+        std::string().swap( virtualResult );
+        StringSink sink( virtualResult );
+        ModelEmitter emitter;
+        emitter.addTarget( *language.backend, sink );
+        for( const auto& c : model )
+        {
+            emitter.emit( *c );
+        }
+    } );
+    Measurement templateEmit = measure( repeat, [ & ]
+    {
+        std::string().swap( templateResult );
+        language.generate( templateResult, model );
+    } );
+    //Компактное дерево: построение из модели и генерация
+    CompactTree compact;
+    Measurement compactBuild = measure( repeat, [ & ]
+    {
+        CompactTreeBuilder builder;
+        for( const auto& c : model )
+        {
+            builder.addModel( *c );
+        }
+        compact = builder.build();
+    } );
+    std::string compactResult;
+    Measurement compactEmit = measure( repeat, [ & ]
+    {
+        std::string().swap( compactResult );
+        language.generateCompact( compactResult, compact.view() );
+    } );
+    //Двоичный образ компактного дерева: запись, загрузка и генерация прямо по отображённому файлу
+    const std::string imagePath = "benchmark_" + std::to_string( getpid() ) + ".image";
+    size_t imageSize = 0;
+    Measurement imageSave = measure( repeat, [ & ]
+    {
+        imageSize = CompactImage::save( compact, imagePath );
+    } );
+    std::unique_ptr< CompactImage > image;
+    Measurement imageLoad = measure( repeat, [ & ]
+    {
+        image.reset();
+        image = std::make_unique< CompactImage >( imagePath );
+    } );
+    std::string imageResult;
+    Measurement imageEmit = measure( repeat, [ & ]
+    {
+        std::string().swap( imageResult );
+        language.generateCompact( imageResult, image->view() );
+    } );
+    image.reset();
+    std::remove( imagePath.c_str() );
+
+    JsonObject constructionJson;
+    constructionJson.field( "nodes", nodes )
+                    .field( "seconds", construction.seconds )
+                    .field( "nodes_per_sec", nodes / construction.seconds )
+                    .field( "allocations", construction.allocations )
+                    .field( "allocations_per_node", nodes ? double( construction.allocations ) / nodes : 0.0 );
+    JsonObject result;
+    result.field( "language", language.name )
+          .raw( "construction", constructionJson.str() )
+          .raw( "compile", throughput( compile, bytes ).str() )
+          .raw( "interned_construction", JsonObject().field( "nodes", internedNodes ).field( "seconds", internedConstruction.seconds )
+                                                     .field( "allocations", internedConstruction.allocations ).str() )
+          .raw( "interned_compile", throughput( internedCompile, internedBytes ).str() )
+          .raw( "emplace_construction", JsonObject().field( "nodes", inPlaceNodes ).field( "seconds", inPlaceConstruction.seconds )
+                                                    .field( "allocations", inPlaceConstruction.allocations ).str() )
+          .raw( "model_virtual", throughput( virtualEmit, virtualResult.size() ).str() )
+          .raw( "model_template", throughput( templateEmit, templateResult.size() ).str() )
+          .raw( "compact_build", JsonObject().field( "nodes", static_cast< size_t >( compact.size() ) ).field( "seconds", compactBuild.seconds )
+                                             .field( "memory_bytes", compact.memoryUsage() ).str() )
+          .raw( "compact_emit", throughput( compactEmit, compactResult.size() ).str() )
+          .raw( "image_save", JsonObject().field( "bytes", imageSize ).field( "seconds", imageSave.seconds ).str() )
+          .raw( "image_load", JsonObject().field( "seconds", imageLoad.seconds ).str() )
+          .raw( "image_emit", throughput( imageEmit, imageResult.size() ).str() )
+          .field( "outputs_match", virtualResult == templateResult && compactResult == templateResult && imageResult == templateResult )
+          .field( "peak_rss_kb", peakRssKb() );
+    return result.str();
+}
+
+//runIsolated(...) - выполняет замер языка в дочернем процессе и забирает его JSON через канал
+//Если создать процесс не удалось, замер выполняется в текущем процессе
+static std::string runIsolated( const Language& language, const TreeShape& shape, size_t repeat )
+{
+    int channel[ 2 ];
+    if( pipe( channel ) != 0 )
+    {
+        return benchmarkLanguage( language, shape, repeat );
+    }
+    pid_t child = fork();
+    if( child < 0 )
+    {
+        close( channel[ 0 ] );
+        close( channel[ 1 ] );
+        return benchmarkLanguage( language, shape, repeat );
+    }
+    if( child == 0 )
+    {
+        close( channel[ 0 ] );
+        int status = 0;
+        try
+        {
+            FdSink out( channel[ 1 ] );
+            out << benchmarkLanguage( language, shape, repeat );
+        }
+        catch( const std::exception& error )
+        {
+            std::cerr << language.name << ": " << error.what() << std::endl;
+            status = 1;
+        }
+        close( channel[ 1 ] );
+        _exit( status );
+    }
+    close( channel[ 1 ] );
+    std::string result;
+    char buffer[ 4096 ];
+    ssize_t got;
+    while( ( got = read( channel[ 0 ], buffer, sizeof( buffer ) ) ) > 0 || ( got < 0 && errno == EINTR ) )
+    {
+        if( got > 0 )
+        {
+            result.append( buffer, static_cast< size_t >( got ) );
+        }
+    }
+    close( channel[ 0 ] );
+    int status = 0;
+    waitpid( child, &status, 0 );
+    if( !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 || result.empty() )
+    {
+        throw std::runtime_error( std::string( "Benchmark failed for " ) + language.name );
+    }
+    return result;
+}
+
+int main( int argc, char* argv[] )
+{
+    TreeShape shape;
+    size_t repeat = 3;
+    std::string output;
+    for( int i = 1; i + 1 < argc; i += 2 )
+    {
+        std::string option = argv[ i ];
+        size_t value = std::strtoul( argv[ i + 1 ], nullptr, 10 );
+        if( option == "--classes" ) shape.classes = value;
+        else if( option == "--methods" ) shape.methods = value;
+        else if( option == "--statements" ) shape.statements = value;
+        else if( option == "--depth" ) shape.depth = value ? value : 1;
+        else if( option == "--repeat" ) repeat = value ? value : 1;
+        else if( option == "--output" ) output = argv[ i + 1 ];
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 2;
+        }
+    }
+
+    std::vector< Language > languages = {
+        { "C++", std::make_shared< PlussesFactory >(), std::make_shared< PlussesBackend >(), &generateStatic< CppTraits >, &generateCompact< CppTraits > },
+        { "C#", std::make_shared< CSharpFactory >(), std::make_shared< CSharpBackend >(), &generateStatic< CSharpTraits >, &generateCompact< CSharpTraits > },
+        { "Java", std::make_shared< JavaFactory >(), std::make_shared< JavaBackend >(), &generateStatic< JavaTraits >, &generateCompact< JavaTraits > }
+    };
+    try
+    {
+        std::string results = "[";
+        for( size_t i = 0; i < languages.size(); ++i )
+        {
+            results += ( i ? ", " : "" ) + runIsolated( languages[ i ], shape, repeat );
+        }
+        results += "]";
+
+        JsonObject shapeJson;
+        shapeJson.field( "classes", shape.classes )
+                 .field( "methods", shape.methods )
+                 .field( "statements", shape.statements )
+                 .field( "depth", shape.depth )
+                 .field( "repeat", repeat );
+        JsonObject report;
+        report.field( "benchmark", "code_creator" )
+              .raw( "shape", shapeJson.str() )
+              .raw( "results", results );
+        if( output.empty() )
+        {
+            std::cout << report.str() << std::endl;
+        }
+        else
+        {
+            std::ofstream( output ) << report.str() << std::endl;
+        }
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,6 @@
 QT -= gui
 
-CONFIG += c++11 console
+CONFIG += c++17 console
 CONFIG -= app_bundle
 
 # The following define makes your compiler emit warnings if you use
@@ -17,6 +17,18 @@ DEFINES += QT_DEPRECATED_WARNINGS
 SOURCES += \
         main.cpp
 
+#Встроенные счётчики производительности (Instrumentation.h): qmake CONFIG+=instrumentation
+instrumentation {
+    DEFINES += CODE_CREATOR_INSTRUMENTATION
+    SOURCES += Instrumentation.cpp
+}
+
+#Сжатие архивов (Archive.h) библиотекой zlib: qmake CONFIG+=zlib
+zlib {
+    DEFINES += CODE_CREATOR_ZLIB
+    LIBS += -lz
+}
+
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
 else: unix:!android: target.path = /opt/$${TARGET}/bin
@@ -24,7 +36,29 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 
 HEADERS += \
     Abstractions.h \
+    Archive.h \
+    Backends.h \
+    Batch.h \
     CSharp.h \
+    CompactImage.h \
+    CompactTree.h \
+    ConcurrentList.h \
+    DiffWriter.h \
+    Escape.h \
     Factories.h \
+    Generator.h \
+    Instrumentation.h \
+    Interning.h \
+    IterativeCompiler.h \
     Java.h \
-    Pluses.h
+    MappedFile.h \
+    Model.h \
+    Pipeline.h \
+    Pluses.h \
+    PullGenerator.h \
+    Server.h \
+    Sink.h \
+    Spec.h \
+    SymbolTable.h \
+    ThreadPool.h \
+    UnitArena.h
@@ -3,27 +3,495 @@
 #include "Factories.h"
 #include "Pluses.h"
 #include "CSharp.h"
+#include "Backends.h"
+#include "Spec.h"
+#include "DiffWriter.h"
+#include "Server.h"
+#include "Pipeline.h"
+#include "Archive.h"
+#include "IterativeCompiler.h"
+#include <chrono>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/resource.h>
 
-std::string generateProgram( const std::shared_ptr< AbstractFactory >& factory ) {
-    auto myClass = factory->ClassCreator( "MyClass" );
-    myClass->add( factory->MethodCreator( " testFunc1 ", " void ", 0), ClassUnit::PUBLIC );
-    myClass->add( factory->MethodCreator( " testFunc2 ", " void ", MethodUnit::STATIC ), ClassUnit::PRIVATE);
-    myClass->add( factory->MethodCreator( " testFunc3 ", " void ", MethodUnit::VIRTUAL| MethodUnit::CONST ), ClassUnit::PUBLIC);
-    std::shared_ptr< MethodUnit >method = factory->MethodCreator(" testFunc4 ", " void ", MethodUnit::STATIC);
-    method->add(factory->PrintOperatorCreator(R"(Hello, world!\n)"));
+//buildProgram() - строит модель класса один раз; код на всех языках потом генерируется из неё
+std::shared_ptr< ModelClass > buildProgram() {
+    auto myClass = std::make_shared< ModelClass >( "MyClass" );
+    myClass->add( std::make_shared< ModelMethod >( " testFunc1 ", " void ", 0), ClassUnit::PUBLIC );
+    myClass->add( std::make_shared< ModelMethod >( " testFunc2 ", " void ", MethodUnit::STATIC ), ClassUnit::PRIVATE);
+    myClass->add( std::make_shared< ModelMethod >( " testFunc3 ", " void ", MethodUnit::VIRTUAL| MethodUnit::CONST ), ClassUnit::PUBLIC);
+    std::shared_ptr< ModelMethod >method = std::make_shared< ModelMethod >(" testFunc4 ", " void ", MethodUnit::STATIC);
+    method->add(std::make_shared< ModelPrint >("Hello, world!\n"));
     myClass->add(method, ClassUnit::PROTECTED);
-    return myClass->compile();
+    return myClass;
+}
+
+//Язык, который можно выбрать в пакетном режиме
+struct BatchTarget
+{
+    const char* name;
+    const char* extension;
+    std::unique_ptr< AbstractFactory > factory;
+    std::unique_ptr< FdSink > sink;
+    int fd;
+    size_t bytes;
+};
+
+//makeFactory(...) - фабрика языка; без арены узлы создаются в куче
+template< class Factory >
+static std::unique_ptr< AbstractFactory > makeFactory( UnitArena* arena )
+{
+    return arena ? std::make_unique< Factory >( *arena ) : std::make_unique< Factory >();
+}
+
+//runBatch(...) - пакетный режим без цикла событий Qt
+//code_creator --spec FILE|- [--lang cpp,csharp,java] [--out-dir DIR [--split] | --archive FILE [--compress LEVEL]] [--pipeline THREADS]
+//Описание модели (см. Spec.h) читается потоково; каждый класс верхнего уровня генерируется и записывается сразу,
+//как только он закрыт, после чего его память освобождается. Без --out-dir код пишется в стандартный вывод
+//(тогда язык должен быть один). С --split каждый класс пишется в свой файл ИМЯ.расширение через DiffWriter:
+//файлы, содержимое которых не изменилось с прошлого запуска, не переписываются, а файлы выбранных языков,
+//которые прошлый запуск создал, а этот - нет, удаляются (файлы других языков в том же каталоге остаются)
+//С --archive все классы всех языков пишутся в один архив с оглавлением (см. Archive.h) под именами ИМЯ.расширение;
+//--compress LEVEL сжимает каждую запись zlib в фоновом потоке
+//С --pipeline разбор, генерация (на THREADS потоках, 0 - по числу ядер) и запись идут одновременно (см. Pipeline.h),
+//а показатели стадий и очередей выводятся в stderr
+//Время запуска, общее время и пиковая память выводятся в stderr
+static int runBatch( int argc, char* argv[], std::chrono::steady_clock::time_point start )
+{
+    std::string spec, languages = "cpp,csharp,java", outDir, archivePath;
+    bool split = false;
+    int compression = 0;
+    long pipelineThreads = -1;
+    for( int i = 1; i < argc; ++i )
+    {
+        std::string option = argv[ i ];
+        if( option == "--split" )
+        {
+            split = true;
+            continue;
+        }
+        if( i + 1 >= argc )
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 2;
+        }
+        if( option == "--spec" ) spec = argv[ ++i ];
+        else if( option == "--lang" ) languages = argv[ ++i ];
+        else if( option == "--out-dir" ) outDir = argv[ ++i ];
+        else if( option == "--pipeline" ) pipelineThreads = std::stol( argv[ ++i ] );
+        else if( option == "--archive" ) archivePath = argv[ ++i ];
+        else if( option == "--compress" ) compression = std::stoi( argv[ ++i ] );
+        else
+        {
+            std::cerr << "Unknown option " << option << "\n"
+                      << "Usage: " << argv[ 0 ] << " --spec FILE|- [--lang cpp,csharp,java] [--out-dir DIR [--split] | --archive FILE [--compress LEVEL]]"
+                      << " [--pipeline THREADS]\n"
+                      << "       " << argv[ 0 ] << " --list ARCHIVE | --extract ARCHIVE NAME" << std::endl;
+            return 2;
+        }
+    }
+    if( spec.empty() )
+    {
+        std::cerr << "--spec is required" << std::endl;
+        return 2;
+    }
+    if( split && outDir.empty() )
+    {
+        std::cerr << "--split requires --out-dir" << std::endl;
+        return 2;
+    }
+    if( !archivePath.empty() && !outDir.empty() )
+    {
+        std::cerr << "--archive and --out-dir can not be used together" << std::endl;
+        return 2;
+    }
+    if( compression != 0 && archivePath.empty() )
+    {
+        std::cerr << "--compress requires --archive" << std::endl;
+        return 2;
+    }
+    //Все узлы одного класса верхнего уровня размещаются в арене и освобождаются одним вызовом
+    UnitArena arena;
+    //В конвейере деревья освобождаются в потоках генерации, поэтому общая арена не используется
+    const bool pipeline = pipelineThreads >= 0;
+    UnitArena* factoryArena = pipeline ? nullptr : &arena;
+    std::vector< BatchTarget > targets;
+    std::stringstream list( languages );
+    std::string language;
+    while( std::getline( list, language, ',' ) )
+    {
+        if( language == "cpp" ) targets.push_back( BatchTarget{ "C++", "cpp", makeFactory< PlussesFactory >( factoryArena ), nullptr, 1, 0 } );
+        else if( language == "csharp" ) targets.push_back( BatchTarget{ "C#", "cs", makeFactory< CSharpFactory >( factoryArena ), nullptr, 1, 0 } );
+        else if( language == "java" ) targets.push_back( BatchTarget{ "Java", "java", makeFactory< JavaFactory >( factoryArena ), nullptr, 1, 0 } );
+        else
+        {
+            std::cerr << "Unknown language " << language << std::endl;
+            return 2;
+        }
+    }
+    if( targets.empty() || ( outDir.empty() && archivePath.empty() && targets.size() > 1 ) )
+    {
+        std::cerr << "Choose exactly one language with --lang or write to files with --out-dir or --archive" << std::endl;
+        return 2;
+    }
+    std::unique_ptr< DiffWriter > diff;
+    std::unique_ptr< ArchiveWriter > archive;
+    try
+    {
+        if( split )
+        {
+            diff = std::make_unique< DiffWriter >( outDir );
+            for( const auto& t : targets )
+            {
+                diff->claim( t.extension );
+            }
+        }
+        if( !archivePath.empty() )
+        {
+            archive = std::make_unique< ArchiveWriter >( archivePath, compression );
+        }
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    for( auto& t : targets )
+    {
+        if( split || archive )
+        {
+            continue;
+        }
+        if( !outDir.empty() )
+        {
+            std::string path = outDir + "/generated." + t.extension;
+            t.fd = ::open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+            if( t.fd < 0 )
+            {
+                std::cerr << "Can not open " << path << ": " << std::strerror( errno ) << std::endl;
+                return 1;
+            }
+        }
+        t.sink = std::make_unique< FdSink >( t.fd );
+    }
+    std::ifstream file;
+    if( spec != "-" )
+    {
+        file.open( spec );
+        if( !file )
+        {
+            std::cerr << "Can not open " << spec << std::endl;
+            return 1;
+        }
+    }
+    std::istream& in = spec == "-" ? std::cin : file;
+    std::vector< const AbstractFactory* > factories;
+    for( const auto& t : targets )
+    {
+        factories.push_back( t.factory.get() );
+    }
+    auto ready = std::chrono::steady_clock::now();
+    int status = 0;
+    //writeClass(...) - код класса name на языке targets[ i ]
+    auto writeClass = [ & ]( size_t i, const std::string& name, const std::string& text )
+    {
+        if( diff )
+        {
+            diff->write( name + "." + targets[ i ].extension, text, targets[ i ].extension );
+            targets[ i ].bytes += text.size();
+        }
+        else if( archive )
+        {
+            archive->add( name + "." + targets[ i ].extension, text );
+            targets[ i ].bytes += text.size();
+        }
+        else
+        {
+            *targets[ i ].sink << text;
+        }
+    };
+    //Вложенность классов и методов в описании ничем не ограничена, поэтому код генерируется без рекурсии (IterativeCompiler.h)
+    IterativeCompiler compiler;
+    SpecReader reader( factories, [ & ]( const std::vector< std::shared_ptr< Unit > >& units )
+    {
+        for( size_t i = 0; i < units.size(); ++i )
+        {
+            if( diff || archive )
+            {
+                writeClass( i, static_cast< const ClassUnit& >( *units[ i ] ).name().str(), compiler.compile( *units[ i ] ) );
+            }
+            else
+            {
+                compiler.compile( *units[ i ], *targets[ i ].sink );
+            }
+        }
+        arena.clear();
+    } );
+    GenerationPipeline engine( factories, [ & ]( const GenerationPipeline::CompiledClass& compiled )
+    {
+        for( size_t i = 0; i < compiled.texts.size(); ++i )
+        {
+            writeClass( i, compiled.name, compiled.texts[ i ] );
+        }
+    }, pipeline ? static_cast< size_t >( pipelineThreads ) : 1 );
+    try
+    {
+        if( pipeline )
+        {
+            engine.run( in );
+        }
+        else
+        {
+            reader.read( in );
+        }
+        //Манифест сохраняется только после успешного разбора: после ошибки следующий запуск сравнит файлы с диском
+        if( diff )
+        {
+            diff->commit( true );
+        }
+        if( archive )
+        {
+            archive->finish();
+        }
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << spec << ": " << error.what() << std::endl;
+        status = 1;
+    }
+    for( auto& t : targets )
+    {
+        if( !t.sink )
+        {
+            continue;
+        }
+        t.sink->flush();
+        t.bytes = t.sink->written();
+        if( t.fd != 1 )
+        {
+            ::close( t.fd );
+        }
+    }
+    auto finish = std::chrono::steady_clock::now();
+    struct rusage usage;
+    getrusage( RUSAGE_SELF, &usage );
+    if( pipeline )
+    {
+        engine.report( std::cerr );
+    }
+    std::cerr << "classes: " << ( pipeline ? engine.classes() : reader.classes() );
+    for( const auto& t : targets )
+    {
+        std::cerr << ", " << t.name << ": " << t.bytes << " bytes";
+    }
+    if( diff )
+    {
+        std::cerr << "\nfiles written: " << diff->written() << " (" << diff->bytesWritten() << " bytes)"
+                  << ", unchanged: " << diff->unchanged() << " (" << diff->bytesSkipped() << " bytes)";
+    }
+    if( archive && status == 0 )
+    {
+        std::cerr << "\narchive entries: " << archive->entries() << ", " << archive->bytesIn() << " bytes stored as "
+                  << archive->bytesStored() << " bytes";
+    }
+    std::cerr << "\nstartup: " << std::chrono::duration< double, std::milli >( ready - start ).count() << " ms"
+              << ", total: " << std::chrono::duration< double, std::milli >( finish - start ).count() << " ms"
+              << ", peak memory: " << usage.ru_maxrss << " KB" << std::endl;
+    return status;
+}
+
+//runArchive(...) - оглавление архива или одна запись из него (см. Archive.h)
+//code_creator --list ARCHIVE
+//code_creator --extract ARCHIVE NAME    - запись NAME пишется в стандартный вывод
+static int runArchive( int argc, char* argv[] )
+{
+    const bool extract = std::string( argv[ 1 ] ) == "--extract";
+    if( argc != ( extract ? 4 : 3 ) )
+    {
+        std::cerr << "Usage: " << argv[ 0 ] << " --list ARCHIVE | --extract ARCHIVE NAME" << std::endl;
+        return 2;
+    }
+    try
+    {
+        ArchiveReader reader( argv[ 2 ] );
+        if( extract )
+        {
+            FdSink out( 1 );
+            out << reader.extract( argv[ 3 ] );
+            return 0;
+        }
+        for( const auto& entry : reader.entries() )
+        {
+            std::cout << entry.name << ' ' << entry.header.size << ' ' << entry.header.storedSize << '\n';
+        }
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//runServer(...) - сервер генерации (см. Server.h), работает до запроса SHUTDOWN
+//code_creator --serve SOCKET [--threads N] [--cache-mb N] [--max-connections N]
+static int runServer( int argc, char* argv[] )
+{
+    size_t threads = 0, cacheBytes = GenerationServer::DEFAULT_CACHE_BYTES, maxConnections = GenerationServer::DEFAULT_MAX_CONNECTIONS;
+    for( int i = 3; i < argc; ++i )
+    {
+        std::string option = argv[ i ];
+        if( i + 1 >= argc )
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 2;
+        }
+        if( option == "--threads" ) threads = std::stoul( argv[ ++i ] );
+        else if( option == "--cache-mb" ) cacheBytes = std::stoul( argv[ ++i ] ) * 1024 * 1024;
+        else if( option == "--max-connections" ) maxConnections = std::stoul( argv[ ++i ] );
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 2;
+        }
+    }
+    try
+    {
+        GenerationServer server( argv[ 2 ], threads, cacheBytes, maxConnections );
+        std::cerr << "listening on " << argv[ 2 ] << std::endl;
+        server.run();
+        std::cerr << server.stats();
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//runClient(...) - проверочный клиент сервера генерации
+//code_creator --connect SOCKET --spec FILE|- [--lang cpp,csharp,java] [--repeat N]
+//code_creator --connect SOCKET --stats | --shutdown
+//Код пишется в стандартный вывод, задержка каждого запроса и попадания в кеш - в stderr;
+//с --repeat одно и то же описание отправляется N раз по одному соединению (код выводится только для первого)
+static int runClient( int argc, char* argv[] )
+{
+    std::string spec, languages = "cpp", command;
+    size_t repeat = 1;
+    for( int i = 3; i < argc; ++i )
+    {
+        std::string option = argv[ i ];
+        if( option == "--stats" || option == "--shutdown" ) command = option;
+        else if( i + 1 >= argc )
+        {
+            std::cerr << "Missing value for " << option << std::endl;
+            return 2;
+        }
+        else if( option == "--spec" ) spec = argv[ ++i ];
+        else if( option == "--lang" ) languages = argv[ ++i ];
+        else if( option == "--repeat" ) repeat = std::stoul( argv[ ++i ] );
+        else
+        {
+            std::cerr << "Unknown option " << option << std::endl;
+            return 2;
+        }
+    }
+    try
+    {
+        GenerationClient client( argv[ 2 ] );
+        if( command == "--stats" )
+        {
+            std::cout << client.stats();
+            return 0;
+        }
+        if( command == "--shutdown" )
+        {
+            client.shutdown();
+            return 0;
+        }
+        if( spec.empty() )
+        {
+            std::cerr << "--spec, --stats or --shutdown is required" << std::endl;
+            return 2;
+        }
+        std::ifstream file;
+        if( spec != "-" )
+        {
+            file.open( spec );
+            if( !file )
+            {
+                std::cerr << "Can not open " << spec << std::endl;
+                return 1;
+            }
+        }
+        std::istream& in = spec == "-" ? std::cin : file;
+        const std::string text( ( std::istreambuf_iterator< char >( in ) ), std::istreambuf_iterator< char >() );
+        FdSink out( 1 );
+        for( size_t i = 0; i < repeat; ++i )
+        {
+            auto begin = std::chrono::steady_clock::now();
+            auto result = client.generate( languages, text, [ & ]( const std::string&, const std::string&, const std::string& code )
+            {
+                if( i == 0 )
+                {
+                    out << code;
+                }
+            } );
+            out.flush();
+            std::cerr << "request " << i + 1 << ": " << result.classes << " classes, cache hits " << result.hits
+                      << ", server " << result.serverMicros << " us, round trip "
+                      << std::chrono::duration< double, std::micro >( std::chrono::steady_clock::now() - begin ).count() << " us" << std::endl;
+        }
+    }
+    catch( const std::exception& error )
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
 }
 
 int main(int argc, char *argv[])
 {
+    auto start = std::chrono::steady_clock::now();
+    //С аргументами программа работает в пакетном режиме или режиме сервера и завершается, не создавая QCoreApplication
+    if( argc > 2 && std::string( argv[ 1 ] ) == "--serve" )
+    {
+        return runServer( argc, argv );
+    }
+    if( argc > 2 && std::string( argv[ 1 ] ) == "--connect" )
+    {
+        return runClient( argc, argv );
+    }
+    if( argc > 2 && ( std::string( argv[ 1 ] ) == "--list" || std::string( argv[ 1 ] ) == "--extract" ) )
+    {
+        return runArchive( argc, argv );
+    }
+    if( argc > 1 )
+    {
+        return runBatch( argc, argv, start );
+    }
+
+    //Один обход модели генерирует код сразу на трёх языках, каждый в свой буфер
+    std::string plusses, csharp, java;
+    StringSink plussesSink(plusses), csharpSink(csharp), javaSink(java);
+    PlussesBackend plussesBackend;
+    CSharpBackend csharpBackend;
+    JavaBackend javaBackend;
+    ModelEmitter emitter;
+    emitter.addTarget(plussesBackend, plussesSink);
+    emitter.addTarget(csharpBackend, csharpSink);
+    emitter.addTarget(javaBackend, javaSink);
+    emitter.emit(*buildProgram());
+
     std::cout<<"C++_code:"<<"\n"<<endl;
-    std::cout<<generateProgram(std::make_shared<PlussesFactory>())<<std::endl;
+    std::cout<<plusses<<std::endl;
     std::cout<<"C#_code:"<<"\n"<<endl;
-    std::cout<<generateProgram(std::make_shared<CSharpFactory>())<<std::endl;
+    std::cout<<csharp<<std::endl;
     std::cout<<"Java_code:"<<"\n"<<endl;
-    std::cout<<generateProgram(std::make_shared<JavaFactory>())<<std::endl;
+    std::cout<<java<<std::endl;
     QCoreApplication a(argc,argv);
     return a.exec();
 }
-
@@ -0,0 +1,266 @@
+#ifndef BATCHTEST_H
+#define BATCHTEST_H
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include "Batch.h"
+#include "Check.h"
+#include "IterativeCompilerTest.h"
+
+//Проверки пакетной генерации (BatchGenerator) и ожидания групп задач (TaskGroup::wait())
+
+//finishesWithin(...) - выполняет job в отдельном потоке; если он не закончился за seconds секунд,
+//программа проверок завершается с ошибкой: зависший поток нельзя ни прервать, ни бросить
+inline void finishesWithin( int seconds, const std::function< void() >& job )
+{
+    std::mutex mutex;
+    std::condition_variable finished;
+    bool done = false;
+    std::exception_ptr error;
+    std::thread thread( [ & ]
+    {
+        try
+        {
+            job();
+        }
+        catch( ... )
+        {
+            error = std::current_exception();
+        }
+        std::lock_guard< std::mutex > lock( mutex );
+        done = true;
+        finished.notify_all();
+    } );
+    {
+        std::unique_lock< std::mutex > lock( mutex );
+        if( !finished.wait_for( lock, std::chrono::seconds( seconds ), [ & ]{ return done; } ) )
+        {
+            std::fprintf( stderr, "FAILED  job did not finish in %d s\n", seconds );
+            std::_Exit( 1 );
+        }
+    }
+    thread.join();
+    if( error )
+    {
+        std::rethrow_exception( error );
+    }
+}
+
+//Процессорное время вызывающего потока в миллисекундах
+inline double threadCpuMilliseconds()
+{
+    timespec now;
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &now );
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+//Готовые деревья: код каждого совпадает с compile(), порядок результатов - с порядком деревьев
+TEST_CASE( batchTreesMatchCompile )
+{
+    PlussesFactory plusses;
+    JavaFactory java;
+    std::mt19937 random( 99 );
+    std::vector< std::shared_ptr< Unit > > trees;
+    for( unsigned int i = 0; i < 64; ++i )
+    {
+        trees.push_back( i == 10 ? nullptr : randomClass( i % 2 ? static_cast< const AbstractFactory& >( java ) : plusses, random, 5 ) );
+    }
+    BatchGenerator batch( 4 );
+    CHECK( batch.threads() == 4 );
+    const std::vector< std::string > result = batch.compile( trees );
+    CHECK( result.size() == trees.size() );
+    for( size_t i = 0; i < trees.size(); ++i )
+    {
+        CHECK( result[ i ] == ( trees[ i ] != nullptr ? trees[ i ]->compile() : std::string() ) );
+    }
+}
+
+//Построение и компиляция в пуле: для каждого построителя и каждой фабрики - тот же код, что и последовательно
+TEST_CASE( batchBuildersMatchSequential )
+{
+    PlussesFactory plusses;
+    CSharpFactory csharp;
+    JavaFactory java;
+    InterningFactory interning( java );
+    const std::vector< const AbstractFactory* > factories = { &plusses, &csharp, &java, &interning };
+    std::vector< BatchGenerator::Builder > builders;
+    for( unsigned int i = 0; i < 32; ++i )
+    {
+        builders.push_back( [ i ]( const AbstractFactory& factory )
+        {
+            std::mt19937 random( i );
+            return randomClass( factory, random, 4 );
+        } );
+    }
+    BatchGenerator batch( 3 );
+    const std::vector< std::vector< std::string > > result = batch.compile( builders, factories );
+    CHECK( result.size() == builders.size() );
+    for( size_t i = 0; i < builders.size(); ++i )
+    {
+        CHECK( result[ i ].size() == factories.size() );
+        for( size_t f = 0; f < factories.size(); ++f )
+        {
+            CHECK( result[ i ][ f ] == builders[ i ]( *factories[ f ] )->compile() );
+        }
+        //Объединение одинаковых узлов не меняет код
+        CHECK( result[ i ][ 3 ] == result[ i ][ 2 ] );
+    }
+}
+
+//Фабрика с ареной отвергается до начала работы, в том числе спрятанная за InterningFactory
+TEST_CASE( batchRejectsArenaFactory )
+{
+    UnitArena arena;
+    PlussesFactory inArena( arena );
+    InterningFactory interning( inArena );
+    CHECK( interning.arena() == &arena );
+    PlussesFactory plain;
+    InterningFactory plainInterning( plain );
+    CHECK( plainInterning.arena() == nullptr );
+
+    size_t built = 0;
+    const std::vector< BatchGenerator::Builder > builders = { [ &built ]( const AbstractFactory& factory )
+    {
+        ++built;
+        return std::static_pointer_cast< Unit >( factory.ClassCreator( "A", 0, 0 ) );
+    } };
+    BatchGenerator batch( 2 );
+    CHECK_THROWS( batch.compile( builders, { &plain, &inArena } ) );
+    CHECK_THROWS( batch.compile( builders, { &interning } ) );
+    CHECK( built == 0 );
+    CHECK( batch.compile( builders, { &plainInterning } )[ 0 ][ 0 ] == plain.ClassCreator( "A", 0, 0 )->compile() );
+}
+
+//Модели: код для нескольких языков сразу совпадает с последовательным ModelEmitter
+TEST_CASE( batchModelsMatchEmitter )
+{
+    std::vector< ModelNode::Ptr > models;
+    for( unsigned int i = 0; i < 16; ++i )
+    {
+        auto method = std::make_shared< ModelMethod >( "run" + std::to_string( i ), "void", 0 );
+        method->add( std::make_shared< ModelPrint >( "line " + std::to_string( i ) ) );
+        auto nested = std::make_shared< ModelClass >( "Nested" );
+        nested->add( method, ClassUnit::PRIVATE );
+        auto root = std::make_shared< ModelClass >( "Model" + std::to_string( i ) );
+        root->add( method, ClassUnit::PUBLIC );
+        root->add( nested, ClassUnit::PUBLIC );
+        models.push_back( i == 3 ? nullptr : root );
+    }
+    PlussesBackend plusses;
+    CSharpBackend csharp;
+    JavaBackend java;
+    const std::vector< const Backend* > backends = { &plusses, &csharp, &java };
+    BatchGenerator batch( 4 );
+    const std::vector< std::vector< std::string > > result = batch.compile( models, backends );
+    for( size_t i = 0; i < models.size(); ++i )
+    {
+        for( size_t t = 0; t < backends.size(); ++t )
+        {
+            std::string expected;
+            if( models[ i ] != nullptr )
+            {
+                StringSink sink( expected );
+                ModelEmitter emitter;
+                emitter.addTarget( *backends[ t ], sink );
+                emitter.emit( *models[ i ] );
+            }
+            CHECK( result[ i ][ t ] == expected );
+        }
+    }
+}
+
+//Группы, которые ждут изнутри задач того же пула: ожидающий поток сам выполняет задачи,
+//поэтому даже пул из одного потока не блокируется. Первое исключение группы доходит до wait()
+TEST_CASE( taskGroupNestedWaitAndErrors )
+{
+    finishesWithin( 30, []
+    {
+        for( size_t threads : { 1, 2, 4 } )
+        {
+            ThreadPool pool( threads );
+            std::atomic< size_t > leaves( 0 );
+            TaskGroup outer( pool );
+            for( int i = 0; i < 16; ++i )
+            {
+                outer.run( [ &pool, &leaves ]
+                {
+                    TaskGroup inner( pool );
+                    for( int j = 0; j < 50; ++j )
+                    {
+                        inner.run( [ &leaves ]{ ++leaves; } );
+                    }
+                    inner.wait();
+                } );
+            }
+            outer.wait();
+            CHECK( leaves.load() == 16 * 50 );
+
+            TaskGroup failing( pool );
+            std::atomic< size_t > finished( 0 );
+            for( int i = 0; i < 20; ++i )
+            {
+                failing.run( [ i, &finished ]
+                {
+                    if( i % 5 == 0 )
+                    {
+                        throw std::runtime_error( "task failed" );
+                    }
+                    ++finished;
+                } );
+            }
+            CHECK_THROWS( failing.wait() );
+            CHECK( finished.load() == 16 );
+            //Ошибка уже отдана: повторное ожидание проходит без исключения
+            failing.wait();
+        }
+    } );
+}
+
+//Ожидающая группа просыпается, когда в пуле появляется задача, и когда кончается последняя задача группы;
+//пока ничего не происходит, она спит, а не опрашивает пул
+TEST_CASE( taskGroupWaitWakesWithoutPolling )
+{
+    finishesWithin( 30, []
+    {
+        //Единственный рабочий поток занят задачей, которая ждёт другую задачу пула.
+        //Выполнить её может только поток, спящий в wait(): он должен проснуться от submit(...)
+        ThreadPool pool( 1 );
+        std::mutex mutex;
+        std::condition_variable released;
+        bool release = false;
+        TaskGroup blocked( pool );
+        blocked.run( [ & ]
+        {
+            std::unique_lock< std::mutex > lock( mutex );
+            released.wait( lock, [ & ]{ return release; } );
+        } );
+        std::thread late( [ & ]
+        {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+            pool.submit( [ & ]
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                release = true;
+                released.notify_all();
+            } );
+        } );
+        blocked.wait();
+        late.join();
+
+        //Рабочий поток 300 мс занят задачей группы; ждущий поток за это время почти не тратит процессор
+        ThreadPool busy( 1 );
+        TaskGroup slow( busy );
+        slow.run( []{ std::this_thread::sleep_for( std::chrono::milliseconds( 300 ) ); } );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+        const double cpuBefore = threadCpuMilliseconds();
+        const auto before = std::chrono::steady_clock::now();
+        slow.wait();
+        const auto waited = std::chrono::steady_clock::now() - before;
+        CHECK( waited >= std::chrono::milliseconds( 200 ) );
+        CHECK( threadCpuMilliseconds() - cpuBefore < 50 );
+    } );
+}
+
+#endif // BATCHTEST_H
@@ -0,0 +1,62 @@
+#ifndef CHECK_H
+#define CHECK_H
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+//Простейший набор средств для проверок, без внешних библиотек
+//Проверка - функция, объявленная через TEST_CASE( имя ); она регистрируется сама при запуске программы
+//CHECK( условие ) при ложном условии прерывает проверку исключением с файлом и строкой
+
+struct TestCase
+{
+    const char* name;
+    void ( *run )();
+};
+
+inline std::vector< TestCase >& testCases()
+{
+    static std::vector< TestCase > cases;
+    return cases;
+}
+
+struct TestRegistrar
+{
+    TestRegistrar( const char* name, void ( *run )() )
+    {
+        testCases().push_back( TestCase{ name, run } );
+    }
+};
+
+inline void checkThat( bool condition, const char* text, const char* file, int line )
+{
+    if( !condition )
+    {
+        throw std::runtime_error( std::string( file ) + ":" + std::to_string( line ) + ": CHECK( " + text + " ) failed" );
+    }
+}
+
+#define TEST_CASE( name ) \
+    static void name(); \
+    static TestRegistrar name##Registrar( #name, name ); \
+    static void name()
+
+#define CHECK( condition ) checkThat( static_cast< bool >( condition ), #condition, __FILE__, __LINE__ )
+
+//CHECK_THROWS( выражение ) - выражение должно бросить std::exception
+#define CHECK_THROWS( expression ) \
+    do \
+    { \
+        bool thrown = false; \
+        try \
+        { \
+            expression; \
+        } \
+        catch( const std::exception& ) \
+        { \
+            thrown = true; \
+        } \
+        checkThat( thrown, #expression " throws", __FILE__, __LINE__ ); \
+    } while( false )
+
+#endif // CHECK_H
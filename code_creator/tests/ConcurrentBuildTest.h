@@ -0,0 +1,127 @@
+#ifndef CONCURRENTBUILDTEST_H
+#define CONCURRENTBUILDTEST_H
+#include <thread>
+#include "Check.h"
+#include "Pluses.h"
+
+//Проверки параллельного построения (ClassUnit::beginConcurrent / freeze)
+
+//Класс C++, группы доступа которого можно прочитать
+class InspectableClassUnit: public PlussesClassUnit
+{
+public:
+    using PlussesClassUnit::PlussesClassUnit;
+    const Fields& group( size_t access ) const
+    {
+        return m_fields[ access ];
+    }
+};
+
+//Несколько потоков добавляют методы в разные группы доступа одновременно
+//После freeze() в каждой группе все методы, и методы каждого потока идут в порядке добавления
+TEST_CASE( concurrentAddThenFreeze )
+{
+    const size_t THREADS = 8;
+    const size_t PER_THREAD = 5000;
+    InspectableClassUnit cls( "Shared" );
+    cls.beginConcurrent();
+    CHECK( cls.concurrent() );
+    std::vector< std::thread > threads;
+    for( size_t t = 0; t < THREADS; ++t )
+    {
+        threads.emplace_back( [ &cls, t ]
+        {
+            for( size_t i = 0; i < PER_THREAD; ++i )
+            {
+                const std::string name = std::to_string( t ) + "_" + std::to_string( i );
+                cls.add( std::make_shared< PlussesMethodUnit >( name, "void", 0 ), ( t + i ) % 3 );
+            }
+        } );
+    }
+    for( auto& thread : threads )
+    {
+        thread.join();
+    }
+    CHECK_THROWS( cls.compile() );
+    CHECK_THROWS( cls.measure() );
+    cls.freeze();
+    CHECK( !cls.concurrent() );
+
+    size_t total = 0;
+    for( size_t access = 0; access < 3; ++access )
+    {
+        //следующий ожидаемый номер метода каждого потока в этой группе
+        std::vector< size_t > next( THREADS );
+        for( size_t t = 0; t < THREADS; ++t )
+        {
+            next[ t ] = ( access + 3 - t % 3 ) % 3;
+        }
+        for( const auto& member : cls.group( access ) )
+        {
+            const std::string name = static_cast< const MethodUnit& >( *member ).name().str();
+            const size_t t = std::stoul( name.substr( 0, name.find( '_' ) ) );
+            const size_t i = std::stoul( name.substr( name.find( '_' ) + 1 ) );
+            CHECK( ( t + i ) % 3 == access );
+            CHECK( i == next[ t ] );
+            next[ t ] += 3;
+        }
+        for( size_t t = 0; t < THREADS; ++t )
+        {
+            CHECK( next[ t ] >= PER_THREAD && next[ t ] < PER_THREAD + 3 );
+        }
+        total += cls.group( access ).size();
+    }
+    CHECK( total == THREADS * PER_THREAD );
+
+    //После freeze() класс - обычное дерево: компилируется, а узлы знают своего родителя
+    const std::string text = cls.compile();
+    CHECK( text.size() == cls.measure() );
+    CHECK( text.find( "void 7_4999()" ) != std::string::npos );
+    cls.add( std::make_shared< PlussesMethodUnit >( "after", "int", 0 ), ClassUnit::PUBLIC );
+    CHECK( static_cast< const MethodUnit& >( *cls.group( ClassUnit::PUBLIC ).back() ).name().str() == "after" );
+    CHECK( cls.compile().find( "int after()" ) != std::string::npos );
+}
+
+//Тело метода строится так же: до freeze() компиляция запрещена
+TEST_CASE( concurrentMethodBody )
+{
+    const size_t THREADS = 4;
+    const size_t PER_THREAD = 1000;
+    PlussesMethodUnit method( "body", "void", 0 );
+    method.beginConcurrent();
+    std::vector< std::thread > threads;
+    for( size_t t = 0; t < THREADS; ++t )
+    {
+        threads.emplace_back( [ &method, t ]
+        {
+            for( size_t i = 0; i < PER_THREAD; ++i )
+            {
+                method.add( std::make_shared< PlussesPrintOperatorUnit >( std::to_string( t ) ) );
+            }
+        } );
+    }
+    for( auto& thread : threads )
+    {
+        thread.join();
+    }
+    CHECK_THROWS( method.compile() );
+    method.freeze();
+    CHECK( method.body().size() == THREADS * PER_THREAD );
+    const std::string text = method.compile( 1 );
+    CHECK( text.size() == method.measure( 1 ) );
+}
+
+//Класс в режиме параллельного построения нельзя компилировать и как часть другого дерева
+TEST_CASE( compileBeforeFreezeThrows )
+{
+    auto outer = std::make_shared< PlussesClassUnit >( "Outer" );
+    auto inner = std::make_shared< PlussesClassUnit >( "Inner" );
+    outer->add( inner, ClassUnit::PUBLIC );
+    inner->beginConcurrent();
+    inner->add( std::make_shared< PlussesMethodUnit >( "m", "void", 0 ), ClassUnit::PRIVATE );
+    CHECK_THROWS( outer->compile() );
+    inner->freeze();
+    CHECK( outer->compile().find( "void m()" ) != std::string::npos );
+}
+
+#endif // CONCURRENTBUILDTEST_H
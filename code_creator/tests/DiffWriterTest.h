@@ -0,0 +1,80 @@
+#ifndef DIFFWRITERTEST_H
+#define DIFFWRITERTEST_H
+#include <cstdlib>
+#include <fstream>
+#include "Check.h"
+#include "DiffWriter.h"
+
+//Проверки записи только изменившихся файлов (DiffWriter)
+
+//Временный каталог, который удаляется вместе с содержимым
+struct TemporaryDirectory
+{
+    TemporaryDirectory()
+    {
+        char pattern[] = "/tmp/code_creator_diffXXXXXX";
+        if( ::mkdtemp( pattern ) == nullptr )
+        {
+            throw std::runtime_error( "Can not create a temporary directory" );
+        }
+        path = pattern;
+    }
+    ~TemporaryDirectory()
+    {
+        std::system( ( "rm -rf '" + path + "'" ).c_str() );
+    }
+    bool exists( const std::string& name ) const
+    {
+        return std::ifstream( path + "/" + name ).good();
+    }
+    std::string path;
+};
+
+//Запуски с разными языками в один каталог: каждый удаляет только свои устаревшие файлы
+TEST_CASE( diffWriterRemovesOnlyOwnStaleFiles )
+{
+    TemporaryDirectory directory;
+    {
+        DiffWriter cpp( directory.path );
+        cpp.claim( "cpp" );
+        cpp.write( "A.cpp", "class A {};\n", "cpp" );
+        cpp.write( "B.cpp", "class B {};\n", "cpp" );
+        cpp.commit( true );
+    }
+    {
+        DiffWriter java( directory.path );
+        java.claim( "java" );
+        java.write( "A.java", "class A {}\n", "java" );
+        CHECK( java.stale().empty() );
+        java.commit( true );
+    }
+    CHECK( directory.exists( "A.cpp" ) && directory.exists( "B.cpp" ) && directory.exists( "A.java" ) );
+    {
+        //Класс B исчез из описания: удаляется только B.cpp, файлы Java остаются
+        DiffWriter cpp( directory.path );
+        cpp.claim( "cpp" );
+        CHECK( cpp.write( "A.cpp", "class A {};\n", "cpp" ) == DiffWriter::UNCHANGED );
+        CHECK( cpp.stale() == std::vector< std::string >{ "B.cpp" } );
+        cpp.commit( true );
+    }
+    CHECK( directory.exists( "A.cpp" ) && !directory.exists( "B.cpp" ) && directory.exists( "A.java" ) );
+    {
+        //Запуск, объявивший язык, но не записавший ни одного файла, удаляет все файлы этого языка
+        DiffWriter java( directory.path );
+        java.claim( "java" );
+        CHECK( java.stale() == std::vector< std::string >{ "A.java" } );
+        java.commit( true );
+    }
+    CHECK( directory.exists( "A.cpp" ) && !directory.exists( "A.java" ) );
+    {
+        //Записи о файлах C++ пережили запуски Java: файл сравнивается по манифесту и не переписывается
+        DiffWriter cpp( directory.path );
+        CHECK( cpp.write( "A.cpp", "class A {};\n", "cpp" ) == DiffWriter::UNCHANGED );
+        CHECK( cpp.stale().empty() );
+    }
+    DiffWriter writer( directory.path );
+    CHECK_THROWS( writer.claim( "two words" ) );
+    CHECK_THROWS( writer.write( "C.cpp", "", "-" ) );
+}
+
+#endif // DIFFWRITERTEST_H
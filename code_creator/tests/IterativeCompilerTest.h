@@ -0,0 +1,149 @@
+#ifndef ITERATIVECOMPILERTEST_H
+#define ITERATIVECOMPILERTEST_H
+#include <functional>
+#include <random>
+#include <pthread.h>
+#include "Check.h"
+#include "Factories.h"
+#include "Interning.h"
+#include "IterativeCompiler.h"
+
+//Проверки нерекурсивной генерации: IterativeCompiler пишет ровно то же, что compileTo(...)
+
+//runOnStack(...) - выполняет job в отдельном потоке со стеком stackSize байт
+//Исключение из job пробрасывается в вызывающий поток
+inline void runOnStack( size_t stackSize, const std::function< void() >& job )
+{
+    struct Context
+    {
+        const std::function< void() >* job;
+        std::exception_ptr error;
+    };
+    Context context{ &job, nullptr };
+    pthread_attr_t attributes;
+    pthread_attr_init( &attributes );
+    pthread_attr_setstacksize( &attributes, stackSize );
+    pthread_t thread;
+    const int created = pthread_create( &thread, &attributes, []( void* data ) -> void*
+    {
+        Context* context = static_cast< Context* >( data );
+        try
+        {
+            ( *context->job )();
+        }
+        catch( ... )
+        {
+            context->error = std::current_exception();
+        }
+        return nullptr;
+    }, &context );
+    pthread_attr_destroy( &attributes );
+    if( created != 0 )
+    {
+        throw std::runtime_error( "Can not create a thread" );
+    }
+    pthread_join( thread, nullptr );
+    if( context.error )
+    {
+        std::rethrow_exception( context.error );
+    }
+}
+
+//randomClass(...) - случайное дерево: классы, методы, вложенные классы и операторы вывода
+//Типы доступа и модификаторы - только те, что допустимы во всех трёх языках
+inline std::shared_ptr< Unit > randomClass( const AbstractFactory& factory, std::mt19937& random, unsigned int depth )
+{
+    auto pick = [ &random ]( unsigned int count )
+    {
+        return static_cast< unsigned int >( random() % count );
+    };
+    std::shared_ptr< ClassUnit > result = factory.ClassCreator( "C" + std::to_string( pick( 1000 ) ), ClassUnit::PUBLIC, 0 );
+    const unsigned int members = pick( 5 );
+    for( unsigned int i = 0; i < members; ++i )
+    {
+        const Unit::Flags access = pick( 3 );
+        const unsigned int kind = pick( 4 );
+        if( kind == 0 && depth > 0 )
+        {
+            result->add( randomClass( factory, random, depth - 1 ), access );
+            continue;
+        }
+        std::shared_ptr< MethodUnit > method = factory.MethodCreator( "m" + std::to_string( i ), pick( 2 ) ? "void" : "int",
+                                                                      pick( 2 ) ? MethodUnit::STATIC : 0 );
+        const unsigned int statements = pick( 4 );
+        for( unsigned int j = 0; j < statements; ++j )
+        {
+            if( pick( 3 ) == 0 && depth > 0 )
+            {
+                method->add( randomClass( factory, random, depth - 1 ) );
+            }
+            else
+            {
+                method->add( factory.PrintOperatorCreator( "line \"" + std::to_string( pick( 10 ) ) + "\"\n" ) );
+            }
+        }
+        result->add( method, access );
+    }
+    return result;
+}
+
+//Случайные деревья всех трёх языков на разных уровнях; тот же объект IterativeCompiler используется повторно
+TEST_CASE( iterativeMatchesRecursiveOnRandomTrees )
+{
+    PlussesFactory plusses;
+    CSharpFactory csharp;
+    JavaFactory java;
+    InterningFactory interning( csharp );
+    const AbstractFactory* factories[] = { &plusses, &csharp, &java, &interning };
+    IterativeCompiler compiler;
+    for( const AbstractFactory* factory : factories )
+    {
+        std::mt19937 random( 12345 );
+        for( unsigned int tree = 0; tree < 50; ++tree )
+        {
+            std::shared_ptr< Unit > root = randomClass( *factory, random, 6 );
+            const unsigned int level = tree % 3;
+            const std::string expected = root->compile( level );
+            CHECK( compiler.compile( *root, level ) == expected );
+            //Второй раз - уже с запомненным текстом общих узлов
+            CHECK( compiler.compile( *root, level ) == expected );
+        }
+    }
+}
+
+//Цепочка вложенных классов и методов, для которой рекурсивному compileTo(...) не хватает маленького стека:
+//образец генерируется рекурсивно в потоке с большим стеком, а IterativeCompiler работает в потоке со стеком 256 КБ
+TEST_CASE( iterativeHandlesDepthBeyondRecursiveStack )
+{
+    const size_t DEPTH = 3000;
+    const size_t SMALL_STACK = 256 * 1024;
+    UnitArena arena;
+    JavaFactory factory( arena );
+    std::shared_ptr< ClassUnit > root = factory.ClassCreator( "Root", ClassUnit::PUBLIC, 0 );
+    ClassUnit* last = root.get();
+    for( size_t i = 0; i < DEPTH; ++i )
+    {
+        MethodUnit& method = last->emplaceMethod( ClassUnit::PUBLIC, "m", "void" );
+        method.emplacePrint( "before" );
+        last = &method.emplaceClass( "Nested" );
+    }
+    last->emplaceMethod( ClassUnit::PRIVATE, "leaf", "int" ).emplacePrint( "leaf" );
+
+    std::string expected;
+    runOnStack( size_t( 1 ) << 30, [ & ]
+    {
+        expected = root->compile();
+    } );
+    std::string actual;
+    size_t depth = 0;
+    runOnStack( SMALL_STACK, [ & ]
+    {
+        IterativeCompiler compiler;
+        actual = compiler.compile( *root );
+        depth = compiler.depth();
+    } );
+    CHECK( actual == expected );
+    CHECK( depth == DEPTH * 2 + 2 );
+}
+
+#endif // ITERATIVECOMPILERTEST_H
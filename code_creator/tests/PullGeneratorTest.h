@@ -0,0 +1,88 @@
+#ifndef PULLGENERATORTEST_H
+#define PULLGENERATORTEST_H
+#include "Check.h"
+#include "IterativeCompilerTest.h"
+#include "PullGenerator.h"
+
+//Проверки генерации по запросу: склеенные куски и строки побайтно совпадают с compile()
+
+//Куски любой длины, в том числе короче одной строки и длиннее всего текста
+TEST_CASE( pullChunksMatchCompile )
+{
+    JavaFactory java;
+    InterningFactory interning( java );
+    std::mt19937 random( 2024 );
+    const size_t CHUNK_SIZES[] = { 1, 2, 3, 7, 16, 100, 4096, 1 << 20 };
+    for( unsigned int tree = 0; tree < 20; ++tree )
+    {
+        std::shared_ptr< Unit > root = randomClass( tree % 2 ? static_cast< const AbstractFactory& >( java ) : interning, random, 5 );
+        const unsigned int level = tree % 2;
+        const std::string expected = root->compile( level );
+        for( size_t chunkSize : CHUNK_SIZES )
+        {
+            PullGenerator generator( *root, chunkSize, level );
+            std::string actual;
+            std::string_view chunk;
+            size_t chunks = 0;
+            while( generator.next( chunk ) )
+            {
+                ++chunks;
+                //Все куски, кроме последнего, ровно chunkSize байт
+                CHECK( chunk.size() == chunkSize || actual.size() + chunk.size() == expected.size() );
+                actual.append( chunk.data(), chunk.size() );
+            }
+            CHECK( actual == expected );
+            CHECK( chunks == ( expected.size() + chunkSize - 1 ) / chunkSize );
+            CHECK( generator.done() );
+            CHECK( generator.produced() == expected.size() );
+            CHECK( !generator.next( chunk ) );
+        }
+    }
+}
+
+//Построчная выдача: каждая строка заканчивается '\n', вместе они дают compile()
+TEST_CASE( pullLinesMatchCompile )
+{
+    PlussesFactory plusses;
+    std::mt19937 random( 77 );
+    for( unsigned int tree = 0; tree < 20; ++tree )
+    {
+        std::shared_ptr< Unit > root = randomClass( plusses, random, 5 );
+        const std::string expected = root->compile();
+        PullGenerator generator( *root, 4 );
+        std::string actual;
+        std::string_view line;
+        while( generator.nextLine( line ) )
+        {
+            CHECK( !line.empty() && line.back() == '\n' );
+            CHECK( line.find( '\n' ) == line.size() - 1 );
+            actual.append( line.data(), line.size() );
+        }
+        CHECK( actual == expected );
+        CHECK( generator.done() );
+    }
+}
+
+//Куски и строки вперемешку из одного генератора
+TEST_CASE( pullMixedChunksAndLines )
+{
+    CSharpFactory csharp;
+    std::mt19937 random( 5 );
+    std::shared_ptr< Unit > root = randomClass( csharp, random, 6 );
+    const std::string expected = root->compile();
+    PullGenerator generator( *root, 5 );
+    std::string actual;
+    std::string_view piece;
+    bool more = true;
+    for( size_t i = 0; more; ++i )
+    {
+        more = i % 2 ? generator.nextLine( piece ) : generator.next( piece );
+        if( more )
+        {
+            actual.append( piece.data(), piece.size() );
+        }
+    }
+    CHECK( actual == expected );
+}
+
+#endif // PULLGENERATORTEST_H
@@ -0,0 +1,242 @@
+#ifndef RENDERCACHETEST_H
+#define RENDERCACHETEST_H
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <type_traits>
+#include <unistd.h>
+#include "Check.h"
+#include "Interning.h"
+#include "Spec.h"
+#include "UnitArena.h"
+
+//Проверки запоминания сгенерированного текста (Unit::compileCached)
+
+//Включает Unit::setOutputCaching(...) на время проверки
+struct OutputCachingScope
+{
+    OutputCachingScope()
+    {
+        Unit::setOutputCaching( true );
+    }
+    ~OutputCachingScope()
+    {
+        Unit::setOutputCaching( false );
+    }
+};
+
+//Правила C++, которые считают, сколько раз оператор вывода действительно генерировался в приёмник
+//и сколько раз считался его размер (SizeCounter)
+struct CountingPrintSyntax: PlussesSyntax
+{
+    static size_t& renders()
+    {
+        static size_t count = 0;
+        return count;
+    }
+    static size_t& measures()
+    {
+        static size_t count = 0;
+        return count;
+    }
+    template< class Out >
+    static void print( Out& sink, unsigned int level, std::string_view text )
+    {
+        ++( std::is_base_of< Sink, Out >::value ? renders() : measures() );
+        PlussesSyntax::print( sink, level, text );
+    }
+};
+
+class CountingPrintUnit: public PrintOperatorUnit
+{
+public:
+    explicit CountingPrintUnit( std::string text ): PrintOperatorUnit( std::move( text ) ) {}
+    void compileTo( Sink& sink, unsigned int level = 0 ) const override
+    {
+        compilePrint< CountingPrintSyntax >( sink, level );
+    }
+    size_t measure( unsigned int level = 0 ) const override
+    {
+        return measurePrint< CountingPrintSyntax >( level );
+    }
+};
+
+//Общий неизменяемый оператор вывода в двух методах: второй раз его текст берётся из памяти
+TEST_CASE( sealedPrintIsRenderedOnce )
+{
+    auto print = std::make_shared< CountingPrintUnit >( "shared \"text\"" );
+    print->seal();
+    auto first = std::make_shared< PlussesMethodUnit >( "first", "void", 0 );
+    auto second = std::make_shared< PlussesMethodUnit >( "second", "void", 0 );
+    first->add( print );
+    second->add( print );
+    CountingPrintSyntax::renders() = 0;
+
+    const std::string firstText = first->compile();
+    CHECK( CountingPrintSyntax::renders() == 1 );
+    CHECK( !print->dirty() );
+    const std::string secondText = second->compile();
+    CHECK( CountingPrintSyntax::renders() == 1 );
+    CHECK( firstText.substr( firstText.find( '\n' ) ) == secondText.substr( secondText.find( '\n' ) ) );
+    CHECK( first->measure() == firstText.size() );
+
+    //На другом уровне вложенности текст другой и генерируется отдельно
+    print->compile( 3 );
+    CHECK( CountingPrintSyntax::renders() == 2 );
+    print->compile( 3 );
+    CHECK( CountingPrintSyntax::renders() == 2 );
+}
+
+//Без seal() и без setOutputCaching(...) оператор генерируется при каждой компиляции
+TEST_CASE( plainPrintIsNotCached )
+{
+    CountingPrintUnit print( "plain" );
+    CountingPrintSyntax::renders() = 0;
+    const std::string text = print.compile( 1 );
+    CHECK( print.compile( 1 ) == text );
+    CHECK( CountingPrintSyntax::renders() == 2 );
+    CHECK( print.dirty() );
+}
+
+//Операторы вывода из InterningFactory - один общий неизменяемый узел, который запоминает свой текст
+TEST_CASE( internedPrintKeepsRenderedText )
+{
+    PlussesFactory plusses;
+    InterningFactory factory( plusses );
+    std::shared_ptr< PrintOperatorUnit > print = factory.PrintOperatorCreator( "hello" );
+    CHECK( factory.PrintOperatorCreator( "hello" ) == print );
+    CHECK( print->sealed() );
+    CHECK( print->dirty() );
+    const std::string text = print->compile( 2 );
+    CHECK( !print->dirty() );
+    CHECK( print->compile( 2 ) == text );
+    CHECK( print->measure( 2 ) == text.size() );
+}
+
+//SpecReader отдаёт собранные методы фабрике: InterningFactory объединяет одинаковые методы разных классов,
+//и код не отличается от кода, построенного обычной фабрикой
+TEST_CASE( specReaderInternsRepeatedMethods )
+{
+    const std::string spec =
+        "class First\n"
+        "public method run void\n"
+        "print same\n"
+        "end\n"
+        "private method own int const\n"
+        "print first\n"
+        "end\n"
+        "end\n"
+        "class Second\n"
+        "public method run void\n"
+        "print same\n"
+        "end\n"
+        "end\n";
+    PlussesFactory plusses;
+    InterningFactory interning( plusses );
+    std::string plain, shared;
+    std::vector< std::shared_ptr< Unit > > trees;
+    SpecReader reader( { &plusses, &interning }, [ & ]( const std::vector< std::shared_ptr< Unit > >& units )
+    {
+        plain += units[ 0 ]->compile();
+        shared += units[ 1 ]->compile();
+        trees.push_back( units[ 1 ] );
+    } );
+    std::istringstream in( spec );
+    reader.read( in );
+    CHECK( trees.size() == 2 );
+    CHECK( shared == plain );
+    const InterningFactory::Stats stats = interning.stats();
+    CHECK( stats.methodRequests == 3 );
+    CHECK( stats.uniqueMethods == 2 );
+    CHECK( stats.uniquePrints == 2 );
+    //Второй класс собран из общего метода, текст которого уже запомнен при компиляции первого
+    PlussesMethodUnit probe( "run", "void", 0 );
+    probe.add( interning.PrintOperatorCreator( "same" ) );
+    std::shared_ptr< MethodUnit > run = interning.internMethod( std::shared_ptr< MethodUnit >( &probe, []( MethodUnit* ) {} ) );
+    CHECK( run.get() != &probe );
+    CHECK( run->sealed() && !run->dirty() );
+}
+
+//С запоминанием текста compile(...) и compileToFile(...) обходят дерево для подсчёта размера один раз, а не два
+TEST_CASE( cachedCompileMeasuresOnce )
+{
+    OutputCachingScope caching;
+    const size_t PRINTS = 10;
+    auto method = std::make_shared< PlussesMethodUnit >( "run", "void", 0 );
+    for( size_t i = 0; i < PRINTS; ++i )
+    {
+        method->add( std::make_shared< CountingPrintUnit >( std::to_string( i ) ) );
+    }
+    CountingPrintSyntax::renders() = 0;
+    CountingPrintSyntax::measures() = 0;
+    const std::string text = method->compile( 1 );
+    CHECK( CountingPrintSyntax::renders() == PRINTS );
+    CHECK( CountingPrintSyntax::measures() == PRINTS );
+    CHECK( text.size() == method->measure( 1 ) );
+    //Готовый текст только копируется
+    CountingPrintSyntax::measures() = 0;
+    CHECK( method->compile( 1 ) == text );
+    CHECK( CountingPrintSyntax::renders() == PRINTS );
+    CHECK( CountingPrintSyntax::measures() == 0 );
+
+    //Файл: размер нужен до генерации, и compileCached(...) берёт уже посчитанный
+    auto other = std::make_shared< PlussesMethodUnit >( "other", "void", 0 );
+    for( size_t i = 0; i < PRINTS; ++i )
+    {
+        other->add( std::make_shared< CountingPrintUnit >( std::to_string( i ) ) );
+    }
+    CountingPrintSyntax::measures() = 0;
+    char path[] = "/tmp/code_creator_testXXXXXX";
+    const int fd = mkstemp( path );
+    CHECK( fd >= 0 );
+    close( fd );
+    other->compileToFile( path, 2 );
+    CHECK( CountingPrintSyntax::measures() == PRINTS );
+    std::ifstream file( path, std::ios::binary );
+    const std::string written( ( std::istreambuf_iterator< char >( file ) ), std::istreambuf_iterator< char >() );
+    std::remove( path );
+    CHECK( written == other->compile( 2 ) );
+    CHECK( CountingPrintSyntax::measures() == PRINTS );
+}
+
+//add(...) сбрасывает запомненный текст всех предков, в том числе через второго родителя
+TEST_CASE( addInvalidatesEveryCachedAncestor )
+{
+    OutputCachingScope caching;
+    auto shared = std::make_shared< PlussesMethodUnit >( "shared", "void", 0 );
+    shared->add( std::make_shared< PlussesPrintOperatorUnit >( "a" ) );
+    auto outer = std::make_shared< PlussesClassUnit >( "Outer" );
+    auto inner = std::make_shared< PlussesClassUnit >( "Inner" );
+    auto other = std::make_shared< PlussesClassUnit >( "Other" );
+    inner->add( shared, ClassUnit::PUBLIC );
+    other->add( shared, ClassUnit::PRIVATE );
+    outer->add( inner, ClassUnit::PUBLIC );
+    outer->compile();
+    other->compile();
+    CHECK( !outer->dirty() && !inner->dirty() && !other->dirty() && !shared->dirty() );
+
+    shared->add( std::make_shared< PlussesPrintOperatorUnit >( "b" ) );
+    CHECK( shared->dirty() && inner->dirty() && outer->dirty() && other->dirty() );
+    const std::string text = outer->compile();
+    CHECK( text.find( "\"b\"" ) != std::string::npos );
+    CHECK( !outer->dirty() && outer->compile() == text );
+}
+
+//Построение очень глубокой цепочки сверху вниз: add(...) не поднимается по предкам без запомненного текста,
+//поэтому цепочка строится за линейное время и без рекурсии
+TEST_CASE( deepChainAddStopsAtCleanAncestor )
+{
+    const size_t DEPTH = 200000;
+    UnitArena arena;
+    PlussesFactory factory( arena );
+    std::shared_ptr< ClassUnit > root = factory.ClassCreator( "Root", 0, 0 );
+    ClassUnit* last = root.get();
+    for( size_t i = 0; i < DEPTH; ++i )
+    {
+        last = &last->emplaceClass( ClassUnit::PUBLIC, "Nested" );
+    }
+    last->emplaceMethod( ClassUnit::PUBLIC, "leaf", "void" ).emplacePrint( "leaf" );
+    CHECK( root->dirty() && last->dirty() );
+}
+
+#endif // RENDERCACHETEST_H
@@ -0,0 +1,42 @@
+#include <cstring>
+#include <iostream>
+#include "BatchTest.h"
+#include "Check.h"
+#include "ConcurrentBuildTest.h"
+#include "DiffWriterTest.h"
+#include "IterativeCompilerTest.h"
+#include "PullGeneratorTest.h"
+#include "RenderCacheTest.h"
+
+//Все проверки собраны в одну программу: заголовки генератора определяют статические поля,
+//поэтому каждый из них включается ровно в одну единицу трансляции
+int main( int argc, char* argv[] )
+{
+    size_t failed = 0;
+    size_t run = 0;
+    for( const TestCase& test : testCases() )
+    {
+        bool selected = argc == 1;
+        for( int i = 1; i < argc; ++i )
+        {
+            selected = selected || std::strcmp( argv[ i ], test.name ) == 0;
+        }
+        if( !selected )
+        {
+            continue;
+        }
+        ++run;
+        try
+        {
+            test.run();
+            std::cout << "ok      " << test.name << std::endl;
+        }
+        catch( const std::exception& e )
+        {
+            ++failed;
+            std::cout << "FAILED  " << test.name << ": " << e.what() << std::endl;
+        }
+    }
+    std::cout << run - failed << " of " << run << " checks passed" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
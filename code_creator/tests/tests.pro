@@ -0,0 +1,22 @@
+QT -= core gui
+
+CONFIG += c++17 console thread
+CONFIG -= app_bundle qt
+
+#Проверки генератора; собираются отдельно от основной программы
+#Запуск без параметров выполняет все проверки, с параметрами - только проверки с такими именами
+#Код возврата 0 - все проверки прошли
+#Заголовки генератора берутся из родительского каталога
+INCLUDEPATH += ..
+
+SOURCES += \
+        main.cpp
+
+HEADERS += \
+    BatchTest.h \
+    Check.h \
+    ConcurrentBuildTest.h \
+    DiffWriterTest.h \
+    IterativeCompilerTest.h \
+    PullGeneratorTest.h \
+    RenderCacheTest.h